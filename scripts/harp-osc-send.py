@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Send Harp OSC messages over UDP, the way the TouchOSC control surface
+(src/OSCHarp-v3.tosc) does, to try out the Harp's OSC receiver without an iPad.
+
+Enable "OSC control surface > Receive OSC" in the Harp's context menu, then e.g.
+
+    scripts/harp-osc-send.py                   # strum fader 1 up and down
+    scripts/harp-osc-send.py --strings 4       # four faders at once
+    scripts/harp-osc-send.py --host 192.168.1.20 --port 9000
+
+Uses only the Python standard library.
+"""
+
+import argparse
+import math
+import socket
+import struct
+import time
+
+
+def osc_string(s):
+    b = s.encode("ascii") + b"\0"
+    return b + b"\0" * (-len(b) % 4)
+
+
+def osc_message(address, value):
+    return osc_string(address) + osc_string(",f") + struct.pack(">f", value)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--strings", type=int, default=1, help="number of faders to strum (1-16)")
+    parser.add_argument("--rate", type=float, default=100.0, help="messages per second, per fader")
+    parser.add_argument("--seconds", type=float, default=10.0, help="how long to strum")
+    parser.add_argument("--period", type=float, default=2.0, help="seconds per strum up and down")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    target = (args.host, args.port)
+    strings = max(1, min(16, args.strings))
+
+    for n in range(1, strings + 1):
+        sock.sendto(osc_message("/1/fader%dz" % n, 1.0), target)
+    start = time.monotonic()
+    sent = 0
+    try:
+        while time.monotonic() - start < args.seconds:
+            t = time.monotonic() - start
+            for n in range(1, strings + 1):
+                # each fader a little out of phase with the last; the surface sends 0 .. 10
+                phase = 2 * math.pi * (t / args.period + (n - 1) / strings)
+                sock.sendto(osc_message("/1/fader%d" % n, 5.0 - 5.0 * math.cos(phase)), target)
+                sent += 1
+            time.sleep(1.0 / args.rate)
+    finally:
+        for n in range(1, strings + 1):
+            sock.sendto(osc_message("/1/fader%dz" % n, 0.0), target)
+    print("sent %d fader messages to %s:%d" % (sent, args.host, args.port))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,197 @@
+#pragma once
+#include "plugin.hpp"
+
+namespace Chinenual {
+namespace MIDIRecorder {
+
+    // Adaptive sampling of the recorded controller lanes (PW, MW and the expander CC's).  Rather
+    // than sampling every lane at a fixed rate, each lane is sampled when its value has moved far
+    // enough from the last value sent (so a fast sweep is sampled up to maxRate), or - if it has
+    // changed at all - at least every 1/minRate seconds (so a slow drift still lands on its exact
+    // value).  A lane that doesn't move sends nothing.  All lanes of the recorder and its chain of
+    // expanders share one event budget, so a patch full of fast moving CV can't flood the recording.
+
+    // choices presented in the context menu:
+    static const int SAMPLING_MIN_RATES[] = { 1, 5, 10, 20, 50 };
+    static const std::vector<std::string> SAMPLING_MIN_RATE_NAMES = {
+        "1 Hz", "5 Hz", "10 Hz", "20 Hz", "50 Hz"
+    };
+    static const int SAMPLING_MAX_RATES[] = { 200, 500, 1000, 2000 };
+    static const std::vector<std::string> SAMPLING_MAX_RATE_NAMES = {
+        "200 Hz", "500 Hz", "1000 Hz", "2000 Hz"
+    };
+    static const int SAMPLING_BUDGETS[] = { 500, 1000, 2000, 5000 };
+    static const std::vector<std::string> SAMPLING_BUDGET_NAMES = {
+        "500 events/s", "1000 events/s", "2000 events/s", "5000 events/s"
+    };
+
+    struct SamplingConfig {
+        bool adaptive = false;
+        int minRate = 10;
+        int maxRate = 1000;
+        // events per second, across all the lanes of the recorder and its expanders (the expanders'
+        // own setting is not used)
+        int budget = 2000;
+
+        void toJson(json_t* rootJ)
+        {
+            json_object_set_new(rootJ, "adaptiveSampling", json_boolean(adaptive));
+            json_object_set_new(rootJ, "samplingMinRate", json_integer(minRate));
+            json_object_set_new(rootJ, "samplingMaxRate", json_integer(maxRate));
+            json_object_set_new(rootJ, "samplingBudget", json_integer(budget));
+        }
+
+        // values are kept within the range the menu offers: the rates are turned into intervals
+        void fromJson(json_t* rootJ)
+        {
+            json_t* adaptiveJ = json_object_get(rootJ, "adaptiveSampling");
+            if (adaptiveJ)
+                adaptive = json_boolean_value(adaptiveJ);
+
+            json_t* minRateJ = json_object_get(rootJ, "samplingMinRate");
+            if (minRateJ)
+                minRate = clamp((int)json_integer_value(minRateJ), SAMPLING_MIN_RATES[0], SAMPLING_MIN_RATES[SAMPLING_MIN_RATE_NAMES.size() - 1]);
+
+            json_t* maxRateJ = json_object_get(rootJ, "samplingMaxRate");
+            if (maxRateJ)
+                maxRate = clamp((int)json_integer_value(maxRateJ), SAMPLING_MAX_RATES[0], SAMPLING_MAX_RATES[SAMPLING_MAX_RATE_NAMES.size() - 1]);
+
+            json_t* budgetJ = json_object_get(rootJ, "samplingBudget");
+            if (budgetJ)
+                budget = clamp((int)json_integer_value(budgetJ), SAMPLING_BUDGETS[0], SAMPLING_BUDGETS[SAMPLING_BUDGET_NAMES.size() - 1]);
+        }
+    };
+
+    // A token bucket shared by the lanes of the recorder.  The recorder passes whole tokens down the
+    // expander chain with grantAll(), and the chain returns what it didn't use with refund().  Each
+    // expander spends the tokens granted to it from an EventBudget of its own, with take().
+    struct EventBudget {
+        // allow short bursts of up to this many seconds' worth of events
+        static constexpr float BURST_SECS = 0.05f;
+        float tokens = 0.f;
+
+        void process(const float sampleTime, const int eventsPerSec)
+        {
+            tokens = std::min(tokens + sampleTime * eventsPerSec, std::max(1.f, eventsPerSec * BURST_SECS));
+        }
+
+        bool take()
+        {
+            if (tokens >= 1.f) {
+                tokens -= 1.f;
+                return true;
+            }
+            return false;
+        }
+
+        // hand out every whole token
+        int grantAll()
+        {
+            const int n = (int)tokens;
+            tokens -= n;
+            return n;
+        }
+
+        // take back tokens handed out by grantAll() but not used; call before process(), which
+        // caps the total
+        void refund(const int n)
+        {
+            tokens += n;
+        }
+    };
+
+    // The sampling schedule for one lane.
+    struct AdaptiveSampler {
+        float lastSent = -1.f; // the scaled value last sent; < 0 == nothing sent yet
+        float timeSinceSent = 0.f;
+
+        void reset()
+        {
+            lastSent = -1.f;
+            timeSinceSent = 0.f;
+        }
+
+        // scaled is the lane's value in steps (0..127 or 0..16383); errorSteps is how far it must
+        // move before it's sampled faster than minRate.  Returns true if the lane should be sampled
+        // now; if the caller does so, it must call sent().
+        bool process(const float sampleTime, const float scaled, const SamplingConfig& config, const float errorSteps)
+        {
+            timeSinceSent += sampleTime;
+            if (lastSent < 0.f) {
+                return true;
+            }
+            // allow for being up to a sample early:
+            if (timeSinceSent + sampleTime < 1.f / config.maxRate) {
+                return false;
+            }
+            if (std::fabs(scaled - lastSent) >= errorSteps) {
+                return true;
+            }
+            if (timeSinceSent >= 1.f / config.minRate && std::round(scaled) != std::round(lastSent)) {
+                return true;
+            }
+            return false;
+        }
+
+        void sent(const float scaled)
+        {
+            lastSent = scaled;
+            timeSinceSent = 0.f;
+        }
+    };
+
+    // the error allowed before a lane is sampled faster than minRate: one 7bit step, whatever the
+    // resolution of the lane
+    static const float SAMPLING_ERROR_7BIT = 1.f;
+    static const float SAMPLING_ERROR_14BIT = 128.f;
+
+    // the budget is only offered by the recorder: the expanders share it
+    inline void appendSamplingMenu(Menu* menu, SamplingConfig* config, const bool showBudget = true)
+    {
+        menu->addChild(createSubmenuItem("Controller sampling", "",
+            [=](Menu* menu) {
+                menu->addChild(createBoolPtrMenuItem("Adaptive", "", &config->adaptive));
+                menu->addChild(createIndexSubmenuItem(
+                    "Min rate", SAMPLING_MIN_RATE_NAMES,
+                    [=]() {
+                        for (size_t i = 0; i < SAMPLING_MIN_RATE_NAMES.size(); i++) {
+                            if (SAMPLING_MIN_RATES[i] == config->minRate)
+                                return i;
+                        }
+                        return (size_t)0;
+                    },
+                    [=](int val) {
+                        config->minRate = SAMPLING_MIN_RATES[val];
+                    }));
+                menu->addChild(createIndexSubmenuItem(
+                    "Max rate", SAMPLING_MAX_RATE_NAMES,
+                    [=]() {
+                        for (size_t i = 0; i < SAMPLING_MAX_RATE_NAMES.size(); i++) {
+                            if (SAMPLING_MAX_RATES[i] == config->maxRate)
+                                return i;
+                        }
+                        return (size_t)0;
+                    },
+                    [=](int val) {
+                        config->maxRate = SAMPLING_MAX_RATES[val];
+                    }));
+                if (!showBudget) {
+                    return;
+                }
+                menu->addChild(createIndexSubmenuItem(
+                    "Event budget", SAMPLING_BUDGET_NAMES,
+                    [=]() {
+                        for (size_t i = 0; i < SAMPLING_BUDGET_NAMES.size(); i++) {
+                            if (SAMPLING_BUDGETS[i] == config->budget)
+                                return i;
+                        }
+                        return (size_t)0;
+                    },
+                    [=](int val) {
+                        config->budget = SAMPLING_BUDGETS[val];
+                    }));
+            }));
+    }
+
+} // namespace MIDIRecorder
+} // namespace Chinenual
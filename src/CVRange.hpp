@@ -14,14 +14,26 @@ namespace MIDIRecorder {
         {
         }
 
+        // the voltage scaled to 0..127, before rounding
+        float scale7bit(float voltage)
+        {
+            return clamp(((voltage - low) / high) * 127, 0.f, 127.f);
+        }
+
+        // the voltage scaled to 0..16383, before rounding
+        float scale14bit(float voltage)
+        {
+            return clamp(((voltage - low) / high) * 16383, 0.f, 16383.f);
+        }
+
         int to7bit(float voltage)
         {
-            return clamp((int)std::round(((voltage - low) / high) * 127), 0, 127);
+            return (int)std::round(scale7bit(voltage));
         }
 
         int to14bit(float voltage)
         {
-            return clamp((int)std::round(((voltage - low) / high) * 16383), 0, 16383);
+            return (int)std::round(scale14bit(voltage));
         }
 
         void split14bit(const int val, int& msb, int& lsb)
@@ -31,6 +43,37 @@ namespace MIDIRecorder {
         }
     };
 
+    // Reports a quantized value only when it changes.  With a deadband, the scaled (unrounded) input
+    // must move more than `deadband` steps past the rounding boundary of the last reported value
+    // before a new value is reported - so a noisy input sitting near a boundary doesn't flap
+    // between adjacent values.  The ends of the range are always reported: the input is clamped
+    // there, so it could never get far enough past the boundary.
+    struct ChangeFilter {
+        int last = -1; // -1 == nothing reported yet
+        float deadband = 0.f; // in steps of the quantized value
+        int max = 127; // the largest quantized value (16383 when 14bit)
+
+        void reset()
+        {
+            last = -1;
+        }
+
+        // returns true (and sets value) if the caller should emit a new value
+        bool process(const float scaled, int& value)
+        {
+            const int v = (int)std::round(scaled);
+            if (v == last) {
+                return false;
+            }
+            if (last >= 0 && v != 0 && v != max && std::fabs(scaled - last) < 0.5f + deadband) {
+                return false;
+            }
+            last = v;
+            value = v;
+            return true;
+        }
+    };
+
     static CVRange CVRanges[] = {
         CVRange(-10.f, 10.f),
         CVRange(0.f, 10.f),
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <rack.hpp>
+
+namespace Chinenual {
+
+// Per-channel memo of a pure function of one input voltage: the last input seen on each channel
+// and the result computed for it.  Melody inputs usually hold steady for thousands of samples, so
+// an unchanged channel costs a compare and a copy rather than a recompute.
+//
+// Inputs are compared by bit pattern (not ==), so the cached result is always bit-exact with what
+// the function would have returned - e.g. -0.f and 0.f are distinct keys, and a NaN input simply
+// misses.  The owner calls invalidate() whenever anything else the function depends on changes
+// (chord, mode, octave, pivot ...): that bumps the generation, and every entry from an older
+// generation misses.
+struct ChannelCache {
+    uint32_t in[rack::PORT_MAX_CHANNELS];
+    float out[rack::PORT_MAX_CHANNELS];
+    uint32_t entryGeneration[rack::PORT_MAX_CHANNELS];
+    uint32_t generation;
+
+    ChannelCache()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        generation = 1;
+        for (int c = 0; c < rack::PORT_MAX_CHANNELS; c++) {
+            in[c] = 0;
+            out[c] = 0.f;
+            entryGeneration[c] = 0;
+        }
+    }
+
+    void invalidate()
+    {
+        generation++;
+        if (generation == 0) {
+            // wrapped: make sure no stale entry can match
+            reset();
+        }
+    }
+
+    /* invalidate just channel c */
+    void invalidate(int c)
+    {
+        entryGeneration[c] = 0;
+    }
+
+    static uint32_t bits(float v)
+    {
+        uint32_t b;
+        std::memcpy(&b, &v, sizeof(b));
+        return b;
+    }
+
+    /* true (and the cached result in result) if channel c last saw exactly this input in the current generation */
+    bool lookup(int c, float v, float& result) const
+    {
+        if (entryGeneration[c] == generation && in[c] == bits(v)) {
+            result = out[c];
+            return true;
+        }
+        return false;
+    }
+
+    void store(int c, float v, float result)
+    {
+        in[c] = bits(v);
+        out[c] = result;
+        entryGeneration[c] = generation;
+    }
+};
+
+} // namespace Chinenual
@@ -0,0 +1,152 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#include "PitchNote.hpp"
+
+namespace Chinenual {
+
+// Chord names from pitch class sets.
+//
+// Every set of pitch classes is a 12 bit mask (bit 0 == C), so all 4096 of them are named ahead of
+// time: naming a chord is a single table lookup, however many notes it has.
+
+struct ChordQuality {
+    // appended to the root's name, e.g. "m7"
+    const char* suffix;
+    // semitones above the root, -1 terminated
+    int8_t intervals[8];
+};
+
+// In order of preference: a set that can be read more than one way (e.g. C6 == Am7/C) gets the
+// first quality/root that fits.
+static const ChordQuality CHORD_QUALITIES[] = {
+    { "", { 0, 4, 7, -1 } },
+    { "m", { 0, 3, 7, -1 } },
+    { "7", { 0, 4, 7, 10, -1 } },
+    { "maj7", { 0, 4, 7, 11, -1 } },
+    { "m7", { 0, 3, 7, 10, -1 } },
+    { "dim", { 0, 3, 6, -1 } },
+    { "aug", { 0, 4, 8, -1 } },
+    { "sus4", { 0, 5, 7, -1 } },
+    { "sus2", { 0, 2, 7, -1 } },
+    { "m7b5", { 0, 3, 6, 10, -1 } },
+    { "dim7", { 0, 3, 6, 9, -1 } },
+    { "6", { 0, 4, 7, 9, -1 } },
+    { "m6", { 0, 3, 7, 9, -1 } },
+    { "m(maj7)", { 0, 3, 7, 11, -1 } },
+    { "7sus4", { 0, 5, 7, 10, -1 } },
+    { "7#5", { 0, 4, 8, 10, -1 } },
+    { "maj7#5", { 0, 4, 8, 11, -1 } },
+    { "add9", { 0, 2, 4, 7, -1 } },
+    { "madd9", { 0, 2, 3, 7, -1 } },
+    { "9", { 0, 2, 4, 7, 10, -1 } },
+    { "maj9", { 0, 2, 4, 7, 11, -1 } },
+    { "m9", { 0, 2, 3, 7, 10, -1 } },
+    { "7b9", { 0, 1, 4, 7, 10, -1 } },
+    { "7#9", { 0, 3, 4, 7, 10, -1 } },
+    { "6/9", { 0, 2, 4, 7, 9, -1 } },
+    { "11", { 0, 2, 4, 5, 7, 10, -1 } },
+    { "m11", { 0, 2, 3, 5, 7, 10, -1 } },
+    { "13", { 0, 2, 4, 7, 9, 10, -1 } },
+    { "maj13", { 0, 2, 4, 7, 9, 11, -1 } },
+    // without the fifth:
+    { "7", { 0, 4, 10, -1 } },
+    { "maj7", { 0, 4, 11, -1 } },
+    { "m7", { 0, 3, 10, -1 } },
+    { "9", { 0, 2, 4, 10, -1 } },
+    { "5", { 0, 7, -1 } },
+    // a single note
+    { "", { 0, -1 } },
+};
+static const int NUM_CHORD_QUALITIES = sizeof(CHORD_QUALITIES) / sizeof(CHORD_QUALITIES[0]);
+
+// big enough for any chordToText() result, e.g. "C#m(maj7)/G#"
+static const int CHORD_TEXT_SIZE = 16;
+
+struct Chord {
+    // pitch class of the root, or -1 if the set isn't a chord we have a name for
+    int8_t root;
+    // index into CHORD_QUALITIES
+    int8_t quality;
+};
+
+struct ChordTable {
+    Chord chord[4096];
+
+    ChordTable()
+    {
+        uint16_t qualityMask[NUM_CHORD_QUALITIES];
+        for (int q = 0; q < NUM_CHORD_QUALITIES; q++) {
+            qualityMask[q] = 0;
+            for (const int8_t* i = CHORD_QUALITIES[q].intervals; *i >= 0; i++) {
+                qualityMask[q] |= 1 << *i;
+            }
+        }
+        for (int mask = 0; mask < 4096; mask++) {
+            chord[mask].root = -1;
+            chord[mask].quality = -1;
+            for (int q = 0; q < NUM_CHORD_QUALITIES && chord[mask].root < 0; q++) {
+                for (int root = 0; root < 12; root++) {
+                    // the set transposed so that root is C:
+                    const int relative = ((mask >> root) | (mask << (12 - root))) & 0xfff;
+                    if (relative == qualityMask[q]) {
+                        chord[mask].root = root;
+                        chord[mask].quality = q;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+};
+
+/* the table is built the first time it's used */
+inline const ChordTable& chordTable()
+{
+    static const ChordTable table;
+    return table;
+}
+
+inline Chord chordOf(int pitchClassMask)
+{
+    return chordTable().chord[pitchClassMask & 0xfff];
+}
+
+/* Writes the name of the chord (e.g. "Cmaj7", or "Cmaj7/E" when the bass isn't the root) into text,
+   truncated to size; returns its length.  "?" if the pitch classes don't form a chord we have a name
+   for; empty if there are none.  Doesn't allocate. */
+inline int chordToText(char* text, size_t size, int pitchClassMask, int bass, NoteAccidental accidentalMode = SHARP)
+{
+    if (size == 0) {
+        return 0;
+    }
+    char buff[CHORD_TEXT_SIZE + 16];
+    char* p = buff;
+    if (pitchClassMask != 0) {
+        const Chord chord = chordOf(pitchClassMask);
+        if (chord.root < 0) {
+            *p++ = '?';
+        } else {
+            const char* const* names = NOTE_NAMES[accidentalMode == FLAT ? 1 : 0];
+            for (const char* s = names[chord.root]; *s; s++) {
+                *p++ = *s;
+            }
+            for (const char* s = CHORD_QUALITIES[chord.quality].suffix; *s; s++) {
+                *p++ = *s;
+            }
+            if (bass != chord.root) {
+                *p++ = '/';
+                for (const char* s = names[bass]; *s; s++) {
+                    *p++ = *s;
+                }
+            }
+        }
+    }
+    int len = std::min((int)(p - buff), (int)size - 1);
+    std::memcpy(text, buff, len);
+    text[len] = 0;
+    return len;
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+
+namespace Chinenual {
+
+// Hands the latest values to display from the engine thread to the UI thread without locks or
+// allocation (a "triple buffer").  The engine thread fills write() and calls publish(); the UI
+// thread calls update() (e.g. in a widget's step()) and then reads read() - which always holds a
+// complete snapshot, never one half written.  Snapshots published faster than the UI takes them
+// are simply skipped.  One producer and one consumer only.
+
+template <typename T>
+struct DisplaySnapshot {
+    static const int INDEX_MASK = 3;
+    // set in `middle` when it holds a snapshot the consumer hasn't taken yet
+    static const int FRESH = 4;
+
+    T buffers[3];
+    // owned by the producer:
+    int writeIndex = 0;
+    // the buffer being handed over, plus FRESH:
+    std::atomic<int> middle;
+    // owned by the consumer:
+    int readIndex = 2;
+
+    DisplaySnapshot()
+        : buffers()
+        , middle(1)
+    {
+    }
+
+    /* engine thread: the buffer to fill */
+    T& write()
+    {
+        return buffers[writeIndex];
+    }
+
+    /* engine thread: make the filled buffer the latest snapshot */
+    void publish()
+    {
+        writeIndex = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    /* UI thread: take the latest snapshot, if there's a new one.  Returns true if read() changed */
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    /* UI thread: the snapshot taken by the last update() */
+    const T& read() const
+    {
+        return buffers[readIndex];
+    }
+};
+
+} // namespace Chinenual
@@ -1,6 +1,7 @@
 #include <osdialog.h>
 
 #include "PitchNote.hpp"
+#include "TextDisplay.hpp"
 #include "plugin.hpp"
 
 #define NUM_INPUT_ROWS 6
@@ -226,17 +227,16 @@ namespace DrumMap {
     // yellow - the logo color:
     static const NVGcolor textColor_yellow = nvgRGB(0xff, 0xd4, 0x56);
 
-    struct LabelDisplayWidget : Widget {
-        std::shared_ptr<Font> font;
-        std::string fontPath;
+    struct LabelDisplayWidget : TextDisplay {
         char displayStr[16];
         int* generalMidiIndexPtr;
 
         LabelDisplayWidget(int* generalMidiIndex)
+            : TextDisplay(asset::plugin(pluginInstance, "res/fonts/opensans/OpenSans-Bold.ttf"), 15.0, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE, 0.0)
         {
             generalMidiIndexPtr = generalMidiIndex;
-            fontPath = std::string(
-                asset::plugin(pluginInstance, "res/fonts/opensans/OpenSans-Bold.ttf"));
+            displayStr[0] = 0;
+            setColor(textColor_yellow);
         }
 
         void onButton(const ButtonEvent& e) override
@@ -279,34 +279,16 @@ namespace DrumMap {
             snprintf(displayStr, 16, "%s", txt);
         }
 
-        void drawLayer(const DrawArgs& args, int layer) override
+        void step() override
         {
-            if (layer == 1) {
-                if (!(font = APP->window->loadFont(fontPath))) {
-                    return;
-                }
-                nvgFontSize(args.vg, 15.0);
-                nvgFontFaceId(args.vg, font->handle);
-                nvgShapeAntiAlias(args.vg, false);
-
-                Vec textPos = Vec(box.getWidth() / 2.f,
-                    (box.getHeight() / 2.f) + 4.f); // bias down a bit
-
-#if 0
-                nvgFillColor(args.vg, nvgRGB(0xff, 0x00, 0x00));
-                nvgBeginPath(args.vg);
-                nvgRect(args.vg, 0.f, 0.f, box.getWidth(), box.getHeight());
-                nvgFill(args.vg);
-#endif
-                nvgFillColor(args.vg, textColor_yellow);
-
-                if (generalMidiIndexPtr) {
-                    snprintf(displayStr, 16, "%s", generalMidiDefinitions[*generalMidiIndexPtr].label);
-                }
-                nvgTextAlign(args.vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
-
-                nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
+            if (generalMidiIndexPtr) {
+                snprintf(displayStr, 16, "%s", generalMidiDefinitions[*generalMidiIndexPtr].label);
             }
+            textPos = Vec(box.getWidth() / 2.f,
+                (box.getHeight() / 2.f) + 4.f); // bias down a bit
+            maxWidth = box.getWidth();
+            setText(displayStr);
+            TextDisplay::step();
         }
     };
 
@@ -1,13 +1,27 @@
 #include <osdialog.h>
 
 #include "CVRange.hpp"
+#include "DisplaySnapshot.hpp"
+#include "HarpOSC.hpp"
+#include "HarpVoices.hpp"
 #include "PitchNote.hpp"
 #include "Style.hpp"
+#include "TextDisplay.hpp"
 #include "plugin.hpp"
 
 namespace Chinenual {
 namespace Harp {
 
+    // what the engine thread publishes for the displays; formatted as text on the UI thread
+    struct HarpDisplay {
+        float rootVoltage;
+        // true if any string is playing; noteVoltage is the note of the lowest one
+        bool notePlaying;
+        float noteVoltage;
+        // bit d set if a string is playing degree (strip) d
+        uint64_t degrees;
+    };
+
     struct Harp : Module {
         enum ParamId {
             NOTE_RANGE_PARAM,
@@ -36,15 +50,22 @@ namespace Harp {
 
         const int numOutputChannels = 16;
 
-        std::string rootNote_text;
-        std::string playingNote_text;
-        std::string debug_text;
+        DisplaySnapshot<HarpDisplay> display;
 
-        // transient properties:
-        bool notePlaying;
-        float currNote;
-        int currDegree;
-        int currChan;
+        HarpScale harpScale;
+        HarpVoices voices;
+
+        // the TouchOSC control surface, received directly rather than through an OSC-to-CV module.
+        // When enabled, its faders are the strings in place of the Pitch and Gate inputs.  Set from
+        // the context menu (UI thread) and read by process().
+        std::atomic<bool> oscEnabled;
+        std::atomic<int> oscPort;
+        std::atomic<float> oscJitter;
+        HarpOSC osc;
+        float oscPitch[OSC_MAX_STRINGS];
+        float oscGate[OSC_MAX_STRINGS];
+        // one past the highest fader heard from
+        int oscStrings;
 
         Harp()
         {
@@ -52,8 +73,8 @@ namespace Harp {
             config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 
             configInput(SCALE_INPUT, "Scale");
-            configInput(PITCH_INPUT, "Unquantized pitch");
-            configInput(GATE_INPUT, "Gate");
+            configInput(PITCH_INPUT, "Unquantized pitch (polyphonic)");
+            configInput(GATE_INPUT, "Gate (polyphonic)");
 
             configOutput(PITCH_OUTPUT, "Pitch V/Oct");
             configOutput(GATE_OUTPUT, "Gate");
@@ -73,129 +94,134 @@ namespace Harp {
 
         void onReset() override
         {
-            notePlaying = false;
-            currNote = -1.0f; // out of range so first use will detect note "change"
-            currDegree = 0;
-            rootNote_text = "";
-            playingNote_text = "";
-            debug_text = "";
-            currChan = 0;
+            voices.reset();
+            harpScale.hysteresis = 0.f;
+            harpScale.release();
+            oscJitter = OSC_JITTER_AMOUNTS[2];
+            for (int s = 0; s < OSC_MAX_STRINGS; s++) {
+                oscPitch[s] = 0.f;
+                oscGate[s] = 0.f;
+            }
+            oscStrings = 0;
+            setOSC(false, OSC_DEFAULT_PORT);
         }
 
-        void process(const ProcessArgs& args) override
+        /* UI thread: start or stop the OSC receiver */
+        void setOSC(bool enabled, int port)
         {
-            float prevNote = currNote;
-
-            if (inputs[GATE_INPUT].isConnected()) {
-                notePlaying = inputs[GATE_INPUT].getVoltage() >= 1.f;
+            oscEnabled = enabled;
+            oscPort = port;
+            if (enabled) {
+                osc.start(port);
             } else {
-                notePlaying = true;
+                osc.stop();
             }
+        }
+
+        json_t* dataToJson() override
+        {
+            json_t* rootJ = json_object();
+            json_object_set_new(rootJ, "hysteresis", json_real(harpScale.hysteresis));
+            json_object_set_new(rootJ, "oscEnabled", json_boolean(oscEnabled));
+            json_object_set_new(rootJ, "oscPort", json_integer(oscPort));
+            json_object_set_new(rootJ, "oscJitter", json_real(oscJitter));
+            return rootJ;
+        }
+
+        void dataFromJson(json_t* rootJ) override
+        {
+            if (rootJ == 0)
+                return;
+
+            json_t* hysteresisJ = json_object_get(rootJ, "hysteresis");
+            if (hysteresisJ) {
+                harpScale.hysteresis = clamp((float)json_number_value(hysteresisJ), HYSTERESIS_AMOUNTS[0], HYSTERESIS_AMOUNTS[HYSTERESIS_NAMES.size() - 1]);
+            }
+            json_t* oscJitterJ = json_object_get(rootJ, "oscJitter");
+            if (oscJitterJ) {
+                oscJitter = clamp((float)json_number_value(oscJitterJ), OSC_JITTER_AMOUNTS[0], OSC_JITTER_AMOUNTS[OSC_JITTER_NAMES.size() - 1]);
+            }
+            json_t* oscEnabledJ = json_object_get(rootJ, "oscEnabled");
+            json_t* oscPortJ = json_object_get(rootJ, "oscPort");
+            setOSC(oscEnabledJ ? json_boolean_value(oscEnabledJ) : false,
+                oscPortJ ? clamp((int)json_integer_value(oscPortJ), 1, 65535) : OSC_DEFAULT_PORT);
+        }
 
-            if (notePlaying) {
-                auto v = inputs[PITCH_INPUT].getVoltage();
+        void process(const ProcessArgs& args) override
+        {
+            {
                 int cvConfigPitch = (int)params[PITCH_CV_RANGE_PARAM].getValue();
                 // number of voltage "buckets":
                 int noteRange = (int)params[NOTE_RANGE_PARAM].getValue();
-
-                auto inputCvMin = MIDIRecorder::CVRanges[cvConfigPitch].low;
-                auto inputCvMax = MIDIRecorder::CVRanges[cvConfigPitch].high;
-                int s = std::round(((v - inputCvMin) / (inputCvMax - inputCvMin)) * (noteRange - 1));
-                float scaledPitch;
-                int scaleSize = 11; // default to chromatic
-                if (inputs[SCALE_INPUT].isConnected()) {
-                    scaleSize = inputs[SCALE_INPUT].getChannels();
-                }
-                int degree = s % scaleSize;
-                int octave = s / scaleSize;
-                if (inputs[SCALE_INPUT].isConnected()) {
-                    scaledPitch = inputs[SCALE_INPUT].getPolyVoltage(degree);
-                } else {
-                    // default is chromatic with root at C4
-                    const float C4 = 0.0f;
-                    const float SEMITONE = 1.0f / 12.f;
-                    scaledPitch = C4 + (degree * SEMITONE);
-                }
-                // INFO("note: r:%d pi:%d s:%d d:%d o:%d cn:%f cd:%d",noteRange, cvConfigPitch,s,degree,octave,currNote,currDegree);
-                currNote = scaledPitch + (octave * 1.f);
-                currDegree = degree + (octave * scaleSize);
+                // a table lookup per sample; rebuilt only when the scale or the ranges change:
+                harpScale.update(inputs[SCALE_INPUT].isConnected() ? inputs[SCALE_INPUT].getVoltages() : NULL,
+                    inputs[SCALE_INPUT].getChannels(), noteRange,
+                    MIDIRecorder::CVRanges[cvConfigPitch].low, MIDIRecorder::CVRanges[cvConfigPitch].high);
             }
 
-            if (notePlaying) {
-                bool noteChanged = prevNote != currNote;
-                if (noteChanged) {
-                    outputs[GATE_OUTPUT].setVoltage(0.f, currChan);
-                    currChan = (currChan + 1) % numOutputChannels;
+            // always drained, so nothing stale is left over when OSC is enabled again
+            osc.process(args.frame, args.sampleRate, oscJitter.load(std::memory_order_relaxed), [this](const OSCEvent& e) {
+                if (e.gate) {
+                    oscGate[e.string] = e.value >= 0.5f ? 10.f : 0.f;
+                } else {
+                    oscPitch[e.string] = e.value;
                 }
-                outputs[GATE_OUTPUT].setVoltage(10.f, currChan);
-                outputs[PITCH_OUTPUT].setVoltage(currNote, currChan);
+                oscStrings = std::max(oscStrings, e.string + 1);
+            });
 
+            if (oscEnabled.load(std::memory_order_relaxed)) {
+                // one string per fader; a fader is gated only while it's touched
+                const int strings = std::max(oscStrings, 1);
+                voices.process(harpScale, oscPitch, strings, oscGate, strings);
             } else {
-                outputs[GATE_OUTPUT].setVoltage(0.f, currChan);
+                // one string per pitch channel; an unconnected gate plays every string
+                voices.process(harpScale,
+                    inputs[PITCH_INPUT].getVoltages(), std::max(inputs[PITCH_INPUT].getChannels(), 1),
+                    inputs[GATE_INPUT].getVoltages(), inputs[GATE_INPUT].getChannels());
+            }
+
+            for (int v = 0; v < numOutputChannels; v++) {
+                outputs[PITCH_OUTPUT].setVoltage(voices.pitch[v], v);
+                outputs[GATE_OUTPUT].setVoltage(voices.gate[v], v);
             }
             outputs[GATE_OUTPUT].setChannels(numOutputChannels);
+            outputs[PITCH_OUTPUT].setChannels(numOutputChannels);
 
             if ((args.frame % 100) == 0) { // throttle
-                float root_v;
-                float play_v = currNote;
-                {
-                    if (inputs[SCALE_INPUT].isConnected()) {
-                        root_v = inputs[SCALE_INPUT].getPolyVoltage(0);
-                    } else {
-                        root_v = 0.0f;
+                HarpDisplay& d = display.write();
+                d.rootVoltage = inputs[SCALE_INPUT].isConnected() ? inputs[SCALE_INPUT].getPolyVoltage(0) : 0.f;
+                d.notePlaying = false;
+                d.degrees = 0;
+                for (int s = voices.strings - 1; s >= 0; s--) {
+                    if (voices.voice[s] >= 0) {
+                        d.notePlaying = true;
+                        d.noteVoltage = voices.note[s];
+                        d.degrees |= (uint64_t)1 << (int)harpScale.bucket[s];
                     }
-                    auto n = voltageToPitch(root_v);
-                    auto fn = voltageToMicroPitch(root_v);
-                    pitchToText(rootNote_text, n, fn - ((float)n), (Chinenual::NoteAccidental)(params[NOTE_ACCIDENTAL_PARAM].getValue()));
-                }
-                if (notePlaying) {
-                    auto n = voltageToPitch(play_v);
-                    auto fn = voltageToMicroPitch(play_v);
-                    pitchToText(playingNote_text, n, fn - ((float)n), (Chinenual::NoteAccidental)(params[NOTE_ACCIDENTAL_PARAM].getValue()));
-                    // debug_text=rack::string::f("%d", currDegree);
-                } else {
-                    playingNote_text = "";
                 }
+                display.publish();
             }
-            outputs[PITCH_OUTPUT].setChannels(numOutputChannels);
         }
     };
 
-    struct NoteDisplayWidget : TransparentWidget {
-        std::shared_ptr<Font> font;
-        std::string fontPath;
-        char displayStr[16];
-        std::string* text;
+    struct NoteDisplayWidget : TextDisplay {
+        const char* text;
         std::string fakeData;
         Harp* module;
 
-        NoteDisplayWidget(Harp* m, std::string* t, std::string fakeData)
+        NoteDisplayWidget(Harp* m, const char* t, std::string fakeData)
+            : TextDisplay(asset::plugin(pluginInstance, "res/fonts/opensans/OpenSans-Regular.ttf"), 18.0, NVG_ALIGN_LEFT | NVG_ALIGN_BOTTOM, 90.0)
         {
             text = t;
             module = m;
             this->fakeData = fakeData;
-            fontPath = std::string(
-                asset::plugin(pluginInstance, "res/fonts/opensans/OpenSans-Regular.ttf"));
         }
 
-        void drawLayer(const DrawArgs& args, int layer) override
+        void step() override
         {
-            if (layer == 1) {
-                NVGcolor ledTextColor = Style::getNVGColor(module ? (Style::Color)module->params[Harp::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR);
-
-                if (!(font = APP->window->loadFont(fontPath))) {
-                    return;
-                }
-                nvgFontSize(args.vg, 18.0);
-                nvgFontFaceId(args.vg, font->handle);
-
-                Vec textPos = Vec(6, 24);
-
-                nvgFillColor(args.vg, ledTextColor);
-
-                nvgTextAlign(args.vg, NVG_ALIGN_LEFT | NVG_ALIGN_BOTTOM);
-                nvgText(args.vg, textPos.x, textPos.y, text ? text->c_str() : fakeData.c_str(), NULL);
-            }
+            setColor(Style::getNVGColor(module ? (Style::Color)module->params[Harp::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR));
+            setText(text ? text : fakeData.c_str());
+            TextDisplay::step();
         }
     };
 
@@ -236,39 +262,66 @@ namespace Harp {
                 return;
             NVGcolor ledTextColor = Style::getNVGColor(module ? (Style::Color)module->params[Harp::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR);
 
-            if ((!module) || module->notePlaying) {
+            if ((!module) || module->display.read().notePlaying) {
 
                 int noteRange;
-                int currDegree;
+                uint64_t degrees;
                 if (module) {
                     noteRange = (int)module->params[Harp::NOTE_RANGE_PARAM].getValue();
-                    currDegree = module->currDegree;
+                    degrees = module->display.read().degrees;
                 } else {
                     // fake data for the module browser:
                     noteRange = 24;
-                    currDegree = 6;
-                }
-
-                if (currDegree < 0 || currDegree >= noteRange) {
-                    // don't draw outside the box if something goes haywire
-                    return;
+                    degrees = (1 << 6) | (1 << 13);
                 }
 
 #define STRIP_LED_Y_OFFSET 5.0
                 float height = (box.getHeight() - (2.f * STRIP_LED_Y_OFFSET)) / noteRange;
                 float x = STRIP_LED_X_OFFSET;
-                float y = STRIP_LED_X_OFFSET + (height * ((noteRange - 1) - currDegree));
                 nvgBeginPath(args.vg);
                 nvgFillColor(args.vg, ledTextColor);
-                // INFO("rect %f %f %f %f %f",x, y, STRIP_LED_WIDTH, height, ratio);
-                nvgRect(args.vg, x, y, STRIP_LED_WIDTH, height);
+                // only the degrees inside the box, in case something goes haywire:
+                for (int degree = 0; degree < noteRange; degree++) {
+                    if (degrees & ((uint64_t)1 << degree)) {
+                        float y = STRIP_LED_X_OFFSET + (height * ((noteRange - 1) - degree));
+                        nvgRect(args.vg, x, y, STRIP_LED_WIDTH, height);
+                    }
+                }
                 nvgClosePath(args.vg);
                 nvgFill(args.vg);
             }
         }
     };
 
+    struct OSCPortField : TextField {
+        Harp* module;
+
+        OSCPortField()
+        {
+            this->box.pos.x = 90; // position of the left side of the text field
+            this->box.size.x = 60; // width of the text field
+            this->multiline = false;
+        }
+
+        void onAction(const ActionEvent& e) override
+        {
+            // apply on Enter, not on each keystroke, so we don't open every port on the way to the
+            // one being typed
+            int port = text != "" ? std::atoi(text.c_str()) : 0;
+            if (port < 1 || port > 65535) {
+                port = module->oscPort;
+            }
+            text = std::to_string(port);
+            selection = cursor = text.size();
+            module->setOSC(module->oscEnabled, port);
+            TextField::onAction(e);
+        }
+    };
+
     struct HarpWidget : ModuleWidget {
+        char rootNote_text[PITCH_TEXT_SIZE] = "";
+        char playingNote_text[PITCH_TEXT_SIZE] = "";
+
         HarpWidget(Harp* module)
         {
             setModule(module);
@@ -294,27 +347,45 @@ namespace Harp {
             addOutput(createOutputCentered<PJ301MPort>(
                 mm2px(Vec(FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, FIRST_Y + SPACING_Y * 7)), module, Harp::GATE_OUTPUT));
 
-            auto rootNoteDisplay = new NoteDisplayWidget(module, module ? &module->rootNote_text : NULL, "C4");
+            auto rootNoteDisplay = new NoteDisplayWidget(module, module ? rootNote_text : NULL, "C4");
             rootNoteDisplay->box.size = Vec(30, 10);
             rootNoteDisplay->box.pos = mm2px(Vec(LED_OFFSET_X + FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, LED_OFFSET_Y + FIRST_Y + SPACING_Y * 1));
             addChild(rootNoteDisplay);
 
-            auto playingNoteDisplay = new NoteDisplayWidget(module, module ? &module->playingNote_text : NULL, "E4");
+            auto playingNoteDisplay = new NoteDisplayWidget(module, module ? playingNote_text : NULL, "E4");
             playingNoteDisplay->box.size = Vec(30, 10);
             playingNoteDisplay->box.pos = mm2px(Vec(LED_OFFSET_X + FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, LED_OFFSET_Y + FIRST_Y + SPACING_Y * 5));
             addChild(playingNoteDisplay);
 
-            auto debugDisplay = new NoteDisplayWidget(module, module ? &module->debug_text : NULL, "");
-            debugDisplay->box.size = Vec(30, 10);
-            debugDisplay->box.pos = mm2px(Vec(LED_OFFSET_X + FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, LED_OFFSET_Y + FIRST_Y + SPACING_Y * 4.5));
-            addChild(debugDisplay);
-
             StripDisplay* display = createWidget<StripDisplay>(mm2px(Vec(STRIP_X_MIN, STRIP_Y_MIN)));
             display->box.size = mm2px(Vec(STRIP_WIDTH, STRIP_HEIGHT));
             display->module = module;
             addChild(display);
         }
 
+        void step() override
+        {
+            Harp* module = dynamic_cast<Harp*>(this->module);
+            // format the text here on the UI thread, only when the engine has published new values:
+            if (module && module->display.update()) {
+                const HarpDisplay& d = module->display.read();
+                auto accidental = (Chinenual::NoteAccidental)(module->params[Harp::NOTE_ACCIDENTAL_PARAM].getValue());
+                {
+                    auto n = voltageToPitch(d.rootVoltage);
+                    auto fn = voltageToMicroPitch(d.rootVoltage);
+                    pitchToText(rootNote_text, sizeof(rootNote_text), n, fn - ((float)n), accidental);
+                }
+                if (d.notePlaying) {
+                    auto n = voltageToPitch(d.noteVoltage);
+                    auto fn = voltageToMicroPitch(d.noteVoltage);
+                    pitchToText(playingNote_text, sizeof(playingNote_text), n, fn - ((float)n), accidental);
+                } else {
+                    playingNote_text[0] = 0;
+                }
+            }
+            ModuleWidget::step();
+        }
+
         void appendContextMenu(Menu* menu) override
         {
             Harp* module = dynamic_cast<Harp*>(this->module);
@@ -340,6 +411,65 @@ namespace Harp {
                 [=](int val) {
                     module->params[Harp::PITCH_CV_RANGE_PARAM].setValue((MIDIRecorder::CVRangeIndex)val);
                 }));
+            menu->addChild(createIndexSubmenuItem(
+                "Hysteresis", HYSTERESIS_NAMES,
+                [=]() {
+                    for (size_t i = 0; i < HYSTERESIS_NAMES.size(); i++) {
+                        if (HYSTERESIS_AMOUNTS[i] == module->harpScale.hysteresis)
+                            return i;
+                    }
+                    return (size_t)0;
+                },
+                [=](int val) {
+                    module->harpScale.hysteresis = HYSTERESIS_AMOUNTS[val];
+                }));
+            menu->addChild(createSubmenuItem("OSC control surface", "",
+                [=](Menu* menu) {
+                    menu->addChild(createBoolMenuItem(
+                        "Receive OSC", "",
+                        [=]() { return module->oscEnabled.load(); },
+                        [=](bool val) { module->setOSC(val, module->oscPort); }));
+                    {
+                        auto holder = new rack::Widget;
+                        holder->box.size.x = 170; // width of the menu
+                        holder->box.size.y = 20;
+
+                        auto lab = new rack::Label;
+                        lab->text = "UDP port: ";
+                        lab->box.size.y = 50;
+                        lab->box.size.x = 100;
+                        holder->addChild(lab);
+
+                        auto textfield = new OSCPortField();
+                        textfield->module = module;
+                        textfield->text = std::to_string(module->oscPort);
+                        holder->addChild(textfield);
+
+                        menu->addChild(holder);
+                    }
+                    switch (module->osc.status) {
+                    case HarpOSC::LISTENING:
+                        menu->addChild(createMenuLabel(string::f("Listening on port %d", module->osc.port)));
+                        break;
+                    case HarpOSC::PORT_ERROR:
+                        menu->addChild(createMenuLabel(string::f("Can't open port %d", module->osc.port)));
+                        break;
+                    default:
+                        break;
+                    }
+                    menu->addChild(createIndexSubmenuItem(
+                        "Timing jitter buffer", OSC_JITTER_NAMES,
+                        [=]() {
+                            for (size_t i = 0; i < OSC_JITTER_NAMES.size(); i++) {
+                                if (OSC_JITTER_AMOUNTS[i] == module->oscJitter)
+                                    return i;
+                            }
+                            return (size_t)0;
+                        },
+                        [=](int val) {
+                            module->oscJitter = OSC_JITTER_AMOUNTS[val];
+                        }));
+                }));
             menu->addChild(createIndexSubmenuItem(
                 "Sharps or Flats", Chinenual::NoteAccidentalNames,
                 [=]() { return module->params[Harp::NOTE_ACCIDENTAL_PARAM].getValue(); },
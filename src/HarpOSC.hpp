@@ -0,0 +1,314 @@
+#pragma once
+#ifdef ARCH_WIN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SPSCQueue.hpp"
+#include <rack.hpp>
+
+namespace Chinenual {
+namespace Harp {
+
+    // Receives the TouchOSC Harp control surface (src/OSCHarp-v3.tosc) directly over UDP, so the
+    // Harp doesn't need an OSC-to-CV module in between.  Each fader is a string:
+    //
+    //   /<page>/fader<N>    the fader position (the surface sends 0 .. 10) - string N's pitch CV
+    //   /<page>/fader<N>z   1 while the fader is touched, 0 when released - string N's gate
+    //
+    // A receiver thread parses each datagram and queues the fader values, stamped with their arrival
+    // time, for the engine thread.  The engine thread applies each one at the sample frame matching
+    // its arrival time plus a small fixed delay ("jitter buffer"), so the timing between messages
+    // survives the engine processing samples in bursts of a block at a time.
+
+    static const int OSC_MAX_STRINGS = rack::PORT_MAX_CHANNELS;
+    static const int OSC_DEFAULT_PORT = 8000;
+
+    // jitter buffer choices presented in the context menu, in seconds:
+    static const float OSC_JITTER_AMOUNTS[] = { 0.f, 0.002f, 0.005f, 0.010f };
+    static const std::vector<std::string> OSC_JITTER_NAMES = {
+        "Off (apply on arrival)", "2 ms", "5 ms", "10 ms"
+    };
+
+    struct OSCEvent {
+        // arrival time, seconds
+        double time;
+        int string;
+        // true: the touch (gate) message, false: the position (pitch) message
+        bool gate;
+        float value;
+    };
+
+    static uint32_t oscReadInt(const char* p)
+    {
+        const uint8_t* b = (const uint8_t*)p;
+        return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | (uint32_t)b[3];
+    }
+
+    /* size of the OSC string at p (including its NUL and padding to 4 bytes), or -1 if it runs past end */
+    static int oscStringSize(const char* p, const char* end)
+    {
+        const char* nul = (const char*)std::memchr(p, 0, end - p);
+        if (!nul) {
+            return -1;
+        }
+        const int size = ((nul - p) / 4 + 1) * 4;
+        return p + size <= end ? size : -1;
+    }
+
+    /* string (0 based) and gate flag of a fader address, or -1 if it isn't one */
+    static int oscFaderString(const char* address, bool& gate)
+    {
+        // skip the page: "/<page>/"
+        if (address[0] != '/') {
+            return -1;
+        }
+        const char* p = std::strchr(address + 1, '/');
+        if (!p || std::strncmp(p + 1, "fader", 5) != 0) {
+            return -1;
+        }
+        p += 6;
+        int n = 0;
+        int digits = 0;
+        while (*p >= '0' && *p <= '9' && digits < 3) {
+            n = n * 10 + (*p++ - '0');
+            digits++;
+        }
+        gate = *p == 'z';
+        if (gate) {
+            p++;
+        }
+        if (digits == 0 || *p != 0 || n < 1 || n > OSC_MAX_STRINGS) {
+            return -1;
+        }
+        return n - 1;
+    }
+
+    /* Parse one OSC packet (a message, or a bundle of them); calls emit(string, gate, value) for
+       each fader message.  Anything else is ignored.  Returns false if the packet is malformed. */
+    template <typename F>
+    bool parseOSCPacket(const char* data, int size, F emit, int depth = 0)
+    {
+        const char* end = data + size;
+        if (size >= 16 && std::memcmp(data, "#bundle", 8) == 0) {
+            if (depth > 4) {
+                return false;
+            }
+            // the bundle's time tag is ignored: every message is timed by its arrival
+            const char* p = data + 16;
+            while (p + 4 <= end) {
+                const int elementSize = (int)oscReadInt(p);
+                p += 4;
+                if (elementSize < 0 || elementSize > end - p || !parseOSCPacket(p, elementSize, emit, depth + 1)) {
+                    return false;
+                }
+                p += elementSize;
+            }
+            return true;
+        }
+
+        const int addressSize = oscStringSize(data, end);
+        if (addressSize < 0) {
+            return false;
+        }
+        const char* tags = data + addressSize;
+        const int tagsSize = tags < end ? oscStringSize(tags, end) : -1;
+        if (tagsSize < 0 || tags[0] != ',') {
+            return false;
+        }
+        bool gate;
+        const int string = oscFaderString(data, gate);
+        if (string < 0) {
+            return true;
+        }
+        // only the first argument matters
+        const char* arg = tags + tagsSize;
+        float value;
+        switch (tags[1]) {
+        case 'f':
+        case 'i': {
+            if (arg + 4 > end) {
+                return false;
+            }
+            const uint32_t bits = oscReadInt(arg);
+            if (tags[1] == 'i') {
+                value = (float)(int32_t)bits;
+            } else {
+                std::memcpy(&value, &bits, sizeof(value));
+            }
+            break;
+        }
+        case 'd': {
+            if (arg + 8 > end) {
+                return false;
+            }
+            const uint64_t bits = ((uint64_t)oscReadInt(arg) << 32) | oscReadInt(arg + 4);
+            double d;
+            std::memcpy(&d, &bits, sizeof(d));
+            value = (float)d;
+            break;
+        }
+        case 'T':
+            value = 1.f;
+            break;
+        case 'F':
+            value = 0.f;
+            break;
+        default:
+            return true;
+        }
+        if (std::isfinite(value)) {
+            emit(string, gate, value);
+        }
+        return true;
+    }
+
+    struct HarpOSC {
+        enum Status {
+            STOPPED,
+            LISTENING,
+            // the port couldn't be opened (e.g. in use by another program)
+            PORT_ERROR
+        };
+        static const int MAX_PACKET = 1536;
+
+        SPSCQueue<OSCEvent, 1024> queue;
+
+        // receiver thread:
+        std::thread thread;
+        std::atomic<bool> running { false };
+        std::atomic<int> status { STOPPED };
+        int port = 0;
+
+        // engine thread: sample frame = arrival time * sample rate + frameOffset
+        double frameOffset = 0.0;
+        bool synced = false;
+
+        ~HarpOSC()
+        {
+            stop();
+        }
+
+        static double now()
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /* UI thread: (re)start listening on the given UDP port */
+        void start(int newPort)
+        {
+            stop();
+            port = newPort;
+#ifdef ARCH_WIN
+            WSADATA wsaData;
+            if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+                status = PORT_ERROR;
+                return;
+            }
+#endif
+            int sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+            sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            addr.sin_port = htons((uint16_t)port);
+            if (sock < 0 || bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+                closeSocket(sock);
+                status = PORT_ERROR;
+                return;
+            }
+            // wake up regularly to notice stop()
+#ifdef ARCH_WIN
+            DWORD timeout = 100;
+#else
+            timeval timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_usec = 100000;
+#endif
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+            running = true;
+            status = LISTENING;
+            thread = std::thread([this, sock]() { receive(sock); });
+        }
+
+        /* UI thread */
+        void stop()
+        {
+            if (thread.joinable()) {
+                running = false;
+                thread.join();
+            }
+            status = STOPPED;
+        }
+
+        static void closeSocket(int sock)
+        {
+#ifdef ARCH_WIN
+            if (sock >= 0) {
+                closesocket(sock);
+            }
+            WSACleanup();
+#else
+            if (sock >= 0) {
+                close(sock);
+            }
+#endif
+        }
+
+        /* receiver thread */
+        void receive(int sock)
+        {
+            char packet[MAX_PACKET];
+            while (running) {
+                const int n = (int)recv(sock, packet, sizeof(packet), 0);
+                if (n <= 0) {
+                    continue;
+                }
+                const double time = now();
+                parseOSCPacket(packet, n, [&](int string, bool gate, float value) {
+                    queue.push(OSCEvent { time, string, gate, value });
+                });
+            }
+            closeSocket(sock);
+        }
+
+        /* engine thread: calls apply(event) for each queued event due at or before the given
+           frame.  Events are due jitter seconds after they arrived. */
+        template <typename F>
+        void process(int64_t frame, float sampleRate, float jitter, F apply)
+        {
+            const double jitterFrames = jitter * sampleRate;
+            const OSCEvent* e;
+            while ((e = queue.front())) {
+                double due = e->time * sampleRate + frameOffset;
+                if (!synced || due < frame - jitterFrames || due > frame + 2 * jitterFrames) {
+                    // the first event, or the engine and the system clock have drifted apart (or the
+                    // engine stalled): line this event up a jitter buffer from now
+                    frameOffset = frame + jitterFrames - e->time * sampleRate;
+                    due = frame + jitterFrames;
+                    synced = true;
+                }
+                if (due > frame) {
+                    return;
+                }
+                apply(*e);
+                queue.pop();
+            }
+        }
+    };
+
+} // namespace Harp
+} // namespace Chinenual
@@ -0,0 +1,122 @@
+#pragma once
+#include <rack.hpp>
+
+namespace Chinenual {
+namespace Harp {
+
+    using rack::simd::float_4;
+
+    // hysteresis choices presented in the context menu, as a fraction of a bucket:
+    static const float HYSTERESIS_AMOUNTS[] = { 0.f, 0.1f, 0.25f, 0.4f };
+    static const std::vector<std::string> HYSTERESIS_NAMES = {
+        "Off", "10%", "25%", "40%"
+    };
+
+    // Maps the pitch CV to the Harp's "strings": the CV range is divided into noteRange equal
+    // voltage buckets, and bucket i plays the i'th note of the scale (wrapping into the next octave
+    // past the end of the scale).  The note voltage of every bucket is precomputed by build() -
+    // called only when the scale, note range or CV range changes - so mapping a sample is a
+    // multiply and a table lookup.  Each polyphonic channel (string) maps independently, four at a
+    // time.
+    struct HarpScale {
+        static const int MAX_NOTES = 48;
+
+        // inputs to the table, to detect when it needs rebuilding
+        float scale[rack::PORT_MAX_CHANNELS];
+        int scaleSize = -1;
+        int noteRange = 0;
+        float cvMin = 0.f;
+        float cvMax = 0.f;
+
+        float noteVoltage[MAX_NOTES];
+        // buckets per volt
+        float bucketsPerVolt = 0.f;
+
+        // fraction of a bucket the CV has to move past a boundary before the bucket changes
+        float hysteresis = 0.f;
+        // the current bucket of each channel; -1 == none (the next sample maps without hysteresis).
+        // Kept as floats so process() can compare and select them four channels at a time.
+        float bucket[rack::PORT_MAX_CHANNELS];
+
+        HarpScale()
+        {
+            release();
+        }
+
+        /* true if the table was built from these settings.  scale == NULL (or scaleSize == 0) is the chromatic scale from C4 */
+        bool matches(const float* newScale, int newScaleSize, int newNoteRange, float newCvMin, float newCvMax) const
+        {
+            if (newScaleSize != scaleSize || newNoteRange != noteRange || newCvMin != cvMin || newCvMax != cvMax) {
+                return false;
+            }
+            for (int i = 0; i < scaleSize; i++) {
+                if (newScale[i] != scale[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void build(const float* newScale, int newScaleSize, int newNoteRange, float newCvMin, float newCvMax)
+        {
+            scaleSize = newScale ? newScaleSize : 0;
+            noteRange = rack::clamp(newNoteRange, 1, MAX_NOTES);
+            cvMin = newCvMin;
+            cvMax = newCvMax;
+            for (int i = 0; i < scaleSize; i++) {
+                scale[i] = newScale[i];
+            }
+            bucketsPerVolt = noteRange > 1 ? (noteRange - 1) / (cvMax - cvMin) : 0.f;
+            for (int s = 0; s < noteRange; s++) {
+                if (scaleSize > 0) {
+                    noteVoltage[s] = scale[s % scaleSize] + (s / scaleSize);
+                } else {
+                    // default is chromatic with root at C4 (0V)
+                    noteVoltage[s] = (s % 12) / 12.f + (s / 12);
+                }
+            }
+            release();
+        }
+
+        /* rebuild the table only if something has changed */
+        void update(const float* newScale, int newScaleSize, int newNoteRange, float newCvMin, float newCvMax)
+        {
+            if (!matches(newScale, newScale ? newScaleSize : 0, newNoteRange, newCvMin, newCvMax)) {
+                build(newScale, newScaleSize, newNoteRange, newCvMin, newCvMax);
+            }
+        }
+
+        /* forget channel c's current bucket, e.g. when its gate closes, so its next note isn't held back by hysteresis */
+        void release(int c)
+        {
+            bucket[c] = -1.f;
+        }
+
+        void release()
+        {
+            for (int c = 0; c < rack::PORT_MAX_CHANNELS; c++) {
+                release(c);
+            }
+        }
+
+        /* the buckets for pitch CVs v of channels c .. c+3 (c a multiple of 4); the note voltage of bucket b is noteVoltage[b] */
+        float_4 process(int c, float_4 v)
+        {
+            const float_4 x = (v - cvMin) * bucketsPerVolt;
+            const float_4 b = float_4::load(&bucket[c]);
+            const float_4 hold = (b >= 0.f) & (x > b - 0.5f - hysteresis) & (x < b + 0.5f + hysteresis);
+            const float_4 nearest = rack::simd::clamp(rack::simd::round(x), 0.f, (float)(noteRange - 1));
+            const float_4 result = rack::simd::ifelse(hold, b, nearest);
+            result.store(&bucket[c]);
+            return result;
+        }
+
+        /* the bucket (string) for pitch CV v on channel 0 */
+        int process(float v)
+        {
+            return (int)process(0, float_4(v))[0];
+        }
+    };
+
+} // namespace Harp
+} // namespace Chinenual
@@ -0,0 +1,147 @@
+#pragma once
+#include "HarpScale.hpp"
+
+namespace Chinenual {
+namespace Harp {
+
+    // The Harp's strings and output voices.  Each pitch/gate input channel is a string (e.g. one
+    // finger on a multi-touch surface); every time a string plucks a new note it gets a fresh
+    // output voice, and the voice it was sounding is released so its envelope can ring out.
+    //
+    // Free voices wait in a ring, oldest-released first, so allocating and releasing are O(1) and a
+    // released voice is reused as late as possible.  There are as many voices as strings and a
+    // string releases its old voice before taking a new one, so the ring is never empty when a
+    // string needs a voice.  With every string sounding, the voice a string takes may be the one it
+    // (or another string) released in the same sample: its gate is then held low for that sample, so
+    // the new note still retriggers.
+    struct HarpVoices {
+        static const int NUM_VOICES = rack::PORT_MAX_CHANNELS;
+
+        // per output voice:
+        float pitch[NUM_VOICES];
+        float gate[NUM_VOICES];
+        // released this sample (its gate was open last sample)
+        bool released[NUM_VOICES];
+        // allocated this sample while released: its gate opens on the next sample
+        bool retrigger[NUM_VOICES];
+
+        // per string: the voice it's sounding (-1 == none) and that voice's note
+        int voice[NUM_VOICES];
+        float note[NUM_VOICES];
+        // strings processed last time, so strings dropped from the inputs get released
+        int strings;
+
+        // free voices: freeVoices[freeHead] is the next to allocate
+        int freeVoices[NUM_VOICES];
+        int freeHead;
+        int freeCount;
+
+        HarpVoices()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            for (int v = 0; v < NUM_VOICES; v++) {
+                pitch[v] = 0.f;
+                gate[v] = 0.f;
+                released[v] = false;
+                retrigger[v] = false;
+                voice[v] = -1;
+                note[v] = 0.f;
+                freeVoices[v] = v;
+            }
+            strings = 0;
+            freeHead = 0;
+            freeCount = NUM_VOICES;
+        }
+
+        int allocate()
+        {
+            const int v = freeVoices[freeHead];
+            freeHead = (freeHead + 1) % NUM_VOICES;
+            freeCount--;
+            return v;
+        }
+
+        void free(int v)
+        {
+            freeVoices[(freeHead + freeCount) % NUM_VOICES] = v;
+            freeCount++;
+        }
+
+        /* string s is playing noteVoltage: retrigger on a new voice if the note has changed */
+        void noteOn(int s, float noteVoltage)
+        {
+            if (voice[s] >= 0) {
+                if (note[s] == noteVoltage) {
+                    return;
+                }
+                noteOff(s);
+            }
+            const int v = allocate();
+            voice[s] = v;
+            note[s] = noteVoltage;
+            pitch[v] = noteVoltage;
+            if (released[v]) {
+                gate[v] = 0.f;
+                retrigger[v] = true;
+            } else {
+                gate[v] = 10.f;
+            }
+        }
+
+        void noteOff(int s)
+        {
+            if (voice[s] < 0) {
+                return;
+            }
+            const int v = voice[s];
+            released[v] = gate[v] > 0.f;
+            gate[v] = 0.f;
+            retrigger[v] = false;
+            free(v);
+            voice[s] = -1;
+        }
+
+        /* Map the pitch CV of each string to a note of the scale and update the voices.  pitch_v
+           and gate_v are full PORT_MAX_CHANNELS arrays (as from Port::getVoltages()).  A single
+           gate channel gates every string; gateChannels == 0 (no gate) plays every string. */
+        void process(HarpScale& scale, const float* pitch_v, int channels, const float* gate_v, int gateChannels)
+        {
+            for (int v = 0; v < NUM_VOICES; v++) {
+                if (retrigger[v]) {
+                    gate[v] = 10.f;
+                    retrigger[v] = false;
+                }
+                released[v] = false;
+            }
+            for (int c = 0; c < channels; c += 4) {
+                const float_4 buckets = scale.process(c, float_4::load(&pitch_v[c]));
+                int playing = 0xf;
+                if (gateChannels == 1) {
+                    playing = gate_v[0] >= 1.f ? 0xf : 0;
+                } else if (gateChannels > 1) {
+                    playing = rack::simd::movemask(float_4::load(&gate_v[c]) >= 1.f);
+                }
+                const int lanes = std::min(4, channels - c);
+                for (int i = 0; i < lanes; i++) {
+                    if (playing & (1 << i)) {
+                        noteOn(c + i, scale.noteVoltage[(int)buckets[i]]);
+                    } else {
+                        noteOff(c + i);
+                        scale.release(c + i);
+                    }
+                }
+            }
+            for (int s = channels; s < strings; s++) {
+                noteOff(s);
+                scale.release(s);
+            }
+            strings = channels;
+        }
+    };
+
+} // namespace Harp
+} // namespace Chinenual
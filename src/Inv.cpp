@@ -1,5 +1,7 @@
 #include <osdialog.h>
 
+#include "ChannelCache.hpp"
+#include "MixMap.hpp"
 #include "PitchInverter.hpp"
 #include "PitchNote.hpp"
 #include "plugin.hpp"
@@ -14,6 +16,7 @@ namespace Inv {
         enum InputId {
             PIVOT_PITCH_INPUT,
             PITCH_INPUT,
+            SCALE_INPUT,
             INPUTS_LEN
         };
         enum OutputId {
@@ -26,13 +29,20 @@ namespace Inv {
         };
 
         PitchInverter inv;
+        PitchInverter::Mode mode;
+        // last inversion computed for each melody channel, and the pivot it was computed for
+        ChannelCache cache;
+        float lastPivot[PORT_MAX_CHANNELS];
+        MixMode mixMode;
+        MixMap mixMap;
 
         Inv()
         {
             onReset();
             config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
-            configInput(PIVOT_PITCH_INPUT, "Inversion pivot pitch");
+            configInput(PIVOT_PITCH_INPUT, "Inversion pivot pitch(es)");
             configInput(PITCH_INPUT, "Melody pitch(es)");
+            configInput(SCALE_INPUT, "Scale for diatonic inversion");
             configOutput(INV_OUTPUT, "Inverted pitches");
             configOutput(MIX_OUTPUT, "Original plus harmonized pitches");
         }
@@ -40,11 +50,19 @@ namespace Inv {
         void onReset() override
         {
             inv.reset();
+            mode = inv.mode;
+            mixMode = MIX_INTERLEAVED;
+            cache.reset();
+            for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+                lastPivot[c] = 0.f;
+            }
         }
 
         json_t* dataToJson() override
         {
             json_t* rootJ = json_object();
+            json_object_set_new(rootJ, "mode", json_integer(mode));
+            json_object_set_new(rootJ, "mixMode", json_integer(mixMode));
             return rootJ;
         }
 
@@ -52,25 +70,76 @@ namespace Inv {
         {
             if (rootJ == 0)
                 return;
+
+            json_t* modeJ = json_object_get(rootJ, "mode");
+            if (modeJ) {
+                mode = (PitchInverter::Mode)clamp((int)json_integer_value(modeJ), (int)PitchInverter::MODE_CHROMATIC, (int)PitchInverter::MODE_DIATONIC);
+            }
+            json_t* mixModeJ = json_object_get(rootJ, "mixMode");
+            if (mixModeJ) {
+                mixMode = (MixMode)clamp((int)json_integer_value(mixModeJ), 0, (int)MixModeNames.size() - 1);
+            }
+        }
+
+        /* pitch classes (bit 0 == C) of the notes on the scale input */
+        int scaleMask()
+        {
+            int mask = 0;
+            for (int c = 0; c < inputs[SCALE_INPUT].getChannels(); c++) {
+                const int note = (int)std::round(clamp(inputs[SCALE_INPUT].getVoltage(c), PITCH_VOCT_MIN, PITCH_VOCT_MAX) * 12.f);
+                mask |= 1 << (((note % 12) + 12) % 12);
+            }
+            return mask;
         }
 
         void process(const ProcessArgs& args) override
         {
-            float pivot_v = clamp(inputs[PIVOT_PITCH_INPUT].getVoltage(), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
-            int inv_c = 0;
-            int mix_c = 0;
-            for (int c = 0; c < inputs[PITCH_INPUT].getChannels(); c++) {
-                // we assume inputs are in +/-10V
-                float in_v = clamp(inputs[PITCH_INPUT].getPolyVoltage(c), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
-                float inv_v = clamp(inv.invert(pivot_v, in_v), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
-                outputs[INV_OUTPUT].setVoltage(inv_v, inv_c);
-                outputs[MIX_OUTPUT].setVoltage(in_v, mix_c);
-                outputs[MIX_OUTPUT].setVoltage(inv_v, mix_c + 1);
-                inv_c += 1;
-                mix_c += 2;
+            if (mode != inv.mode) {
+                inv.mode = mode;
+                cache.invalidate();
+            }
+            const int mask = scaleMask();
+            if (mask != inv.scaleMask) {
+                // rebuilds the reflection table - only when the scale changes
+                inv.setScale(mask);
+                if (inv.mode == PitchInverter::MODE_DIATONIC) {
+                    cache.invalidate();
+                }
             }
-            outputs[INV_OUTPUT].setChannels(inv_c);
-            outputs[MIX_OUTPUT].setChannels(mix_c);
+
+            const int channels = inputs[PITCH_INPUT].getChannels();
+            float pivot_v[PORT_MAX_CHANNELS] = {};
+            float in_v[PORT_MAX_CHANNELS] = {};
+            float inv_v[PORT_MAX_CHANNELS];
+            for (int c = 0; c < channels; c++) {
+                // we assume inputs are in +/-10V.  A monophonic pivot applies to every channel
+                pivot_v[c] = clamp(inputs[PIVOT_PITCH_INPUT].getPolyVoltage(c), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
+                if (ChannelCache::bits(pivot_v[c]) != ChannelCache::bits(lastPivot[c])) {
+                    lastPivot[c] = pivot_v[c];
+                    cache.invalidate(c);
+                }
+                in_v[c] = clamp(inputs[PITCH_INPUT].getPolyVoltage(c), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
+            }
+            for (int c = 0; c < channels; c += 4) {
+                bool hit = true;
+                for (int i = c; i < c + 4 && i < channels; i++) {
+                    hit = cache.lookup(i, in_v[i], inv_v[i]) && hit;
+                }
+                if (!hit) {
+                    float_4 v = inv.invert(float_4::load(&pivot_v[c]), float_4::load(&in_v[c]));
+                    simd::clamp(v, PITCH_VOCT_MIN, PITCH_VOCT_MAX).store(&inv_v[c]);
+                    for (int i = c; i < c + 4 && i < channels; i++) {
+                        cache.store(i, in_v[i], inv_v[i]);
+                    }
+                }
+            }
+
+            for (int c = 0; c < channels; c++) {
+                outputs[INV_OUTPUT].setVoltage(inv_v[c], c);
+            }
+            outputs[INV_OUTPUT].setChannels(channels);
+            mixMap.update(channels, mixMode);
+            mixMap.process(outputs[MIX_OUTPUT], in_v, inv_v);
         }
     };
 
@@ -107,12 +176,39 @@ namespace Inv {
                 mm2px(Vec(FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, FIRST_Y + SPACING_Y * 3)), module, Inv::PIVOT_PITCH_INPUT));
             addInput(createInputCentered<PJ301MPort>(
                 mm2px(Vec(FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, FIRST_Y + SPACING_Y * 4)), module, Inv::PITCH_INPUT));
+            addInput(createInputCentered<PJ301MPort>(
+                mm2px(Vec(FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, FIRST_Y + SPACING_Y * 5)), module, Inv::SCALE_INPUT));
 
             addOutput(createOutputCentered<PJ301MPort>(
                 mm2px(Vec(FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, FIRST_Y + SPACING_Y * 6)), module, Inv::INV_OUTPUT));
             addOutput(createOutputCentered<PJ301MPort>(
                 mm2px(Vec(FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, FIRST_Y + SPACING_Y * 7)), module, Inv::MIX_OUTPUT));
         }
+
+        void appendContextMenu(Menu* menu) override
+        {
+            Inv* module = dynamic_cast<Inv*>(this->module);
+
+            menu->addChild(new MenuSeparator);
+
+            menu->addChild(createIndexSubmenuItem(
+                "Inversion", { "Chromatic", "Diatonic (Scale input)" },
+                [=]() {
+                    return module->mode;
+                },
+                [=](int val) {
+                    module->mode = (PitchInverter::Mode)val;
+                }));
+
+            menu->addChild(createIndexSubmenuItem(
+                "Mix output", MixModeNames,
+                [=]() {
+                    return module->mixMode;
+                },
+                [=](int val) {
+                    module->mixMode = (MixMode)val;
+                }));
+        }
     };
 
 } // namespace Inv
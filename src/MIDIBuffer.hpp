@@ -1,9 +1,12 @@
 #pragma once
 
+#include "MIDIEventRing.hpp"
+#include "MIDIFileWriter.hpp"
 #include "MIDIRecorderBase.hpp"
 #include "MidiFile.h"
 #include "MidiMessage.h"
 #include "plugin.hpp"
+#include <atomic>
 #include <condition_variable>
 #include <thread>
 
@@ -20,11 +23,16 @@ namespace MIDIRecorder {
         // large that the worker is way out of sync with lastest events.
         static const int BUFFER_LEN = 1024;
         static const int NUM_BUFFERS = 3;
+        // rough size of an event in the written file (a short delta time plus a 3 byte channel
+        // message) - used to estimate the size of the current segment without asking the worker.
+        static const int BYTES_PER_EVENT = 4;
 
         // buffer indexes increment monotonically - we use modulo arithmetic to select one of the three
-        // buffers.  This lets us easily determine if the worker is "behind" via simple subtraction
-        int64_t bufferIndex = 0;
-        int64_t workerBufferIndex = 0;
+        // buffers.  This lets us easily determine if the worker is "behind" via simple subtraction.
+        // The audio thread fills a set of buffers and then publishes it by advancing bufferIndex
+        // (release); the worker hands it back by advancing workerBufferIndex (release).
+        std::atomic<int64_t> bufferIndex { 0 };
+        std::atomic<int64_t> workerBufferIndex { 0 };
 
         bool running = false;
         std::thread workerThread;
@@ -34,10 +42,31 @@ namespace MIDIRecorder {
         std::condition_variable mainCv;
 
         std::vector<smf::MidiEvent> buffers[NUM_BUFFERS][NUM_TRACKS];
+        // set by the audio thread when the given set of buffers is the last one of a segment (published
+        // along with the buffers by bufferIndex), cleared by the worker
+        std::atomic<bool> segmentEnds[NUM_BUFFERS];
+        // number of events appended to the current segment (audio thread only)
+        int64_t segmentEventCount = 0;
+        // where finished segments are written
+        std::string segmentDirectory;
+        std::string segmentBasename;
+
+        // recent events for the live view.  Published here on the audio thread rather than by the
+        // worker, since the worker only sees events once a whole buffer has filled.
+        MIDIEventRing ring;
+        // ticks restart at 0 for each segment; the ring sees them as one continuous timeline
+        int64_t ringTickOffset = 0;
+        int segmentLastTick = 0;
+
         smf::MidiFile& midiFile;
+        MIDIFileWriter& writer;
+        // scheduling for the worker thread (and handed on to the writer with each segment)
+        ThreadPriority priority;
+        bool compactEncoding = false;
 
-        MIDIBuffer(smf::MidiFile& midiFile)
+        MIDIBuffer(smf::MidiFile& midiFile, MIDIFileWriter& writer)
             : midiFile(midiFile)
+            , writer(writer)
         {
             // preallocate the buffers so the audio thread never triggers an allocation as it pushes
             // items to the buffer
@@ -46,6 +75,7 @@ namespace MIDIRecorder {
                 for (int t = 0; t < NUM_TRACKS; t++) {
                     buffers[i][t].reserve(BUFFER_LEN);
                 }
+                segmentEnds[i].store(false, std::memory_order_relaxed);
             }
         }
 
@@ -54,35 +84,97 @@ namespace MIDIRecorder {
             stop();
         }
 
-        // Called from the audio thread to record an event
-        void appendEvent(const int track, smf::MidiEvent& event)
+        void waitForWorker()
         {
             // wait for the worker to catch up if it has fallen behind:
-            if (bufferIndex - workerBufferIndex >= NUM_BUFFERS) {
+            if (bufferIndex.load(std::memory_order_relaxed) - workerBufferIndex.load(std::memory_order_acquire) >= NUM_BUFFERS) {
                 std::unique_lock<std::mutex> lock(mainMutex);
                 mainCv.wait(lock);
             }
-            auto buffer = buffers[bufferIndex % NUM_BUFFERS];
+        }
+
+        // Called from the audio thread to record an event
+        void appendEvent(const int track, smf::MidiEvent& event)
+        {
+            waitForWorker();
+            auto buffer = buffers[bufferIndex.load(std::memory_order_relaxed) % NUM_BUFFERS];
 
             buffer[track].push_back(event);
+            segmentEventCount++;
+
+            if (event.tick > segmentLastTick) {
+                segmentLastTick = event.tick;
+            }
+            // only channel messages are interesting to the live view (not tempo and other meta events)
+            if (event.size() >= 2 && event[0] >= 0x80 && event[0] < 0xf0) {
+                ring.push(ringTickOffset + event.tick, track, event[0], event[1], event.size() > 2 ? event[2] : 0);
+            }
 
             if (buffer[track].size() >= BUFFER_LEN) {
                 // we advance to the next set of buffers when any track overflows its buffer
 
                 // next buffer:
-                bufferIndex++;
+                bufferIndex.fetch_add(1, std::memory_order_release);
                 // wake up the worker:
                 workerCv.notify_one();
             }
         }
 
+        // Called from the audio thread to close the current segment.  Everything appended so far
+        // belongs to the finished segment; everything appended afterwards starts the next one.  The
+        // audio thread just flips to the next set of buffers - the worker hands the finished
+        // midiFile off to the writer when it gets there.
+        void endSegment()
+        {
+            waitForWorker();
+            segmentEnds[bufferIndex.load(std::memory_order_relaxed) % NUM_BUFFERS].store(true, std::memory_order_relaxed);
+            segmentEventCount = 0;
+            ringTickOffset += segmentLastTick;
+            segmentLastTick = 0;
+            bufferIndex.fetch_add(1, std::memory_order_release);
+            workerCv.notify_one();
+        }
+
+        // Called from the audio thread with the current tick of the current segment and the tempo
+        void publishTick(const int tick, const double bpm)
+        {
+            ring.nowTick.store(ringTickOffset + tick, std::memory_order_relaxed);
+            ring.bpm.store(bpm, std::memory_order_relaxed);
+        }
+
+        int64_t segmentSizeEstimate()
+        {
+            return segmentEventCount * BYTES_PER_EVENT;
+        }
+
+        // worker thread: pass the completed segment to the writer and start a fresh one with the same
+        // layout that MIDIRecorder::startRecording() creates
+        void finishSegment()
+        {
+            int tpq = midiFile.getTPQ();
+            writer.enqueue(std::move(midiFile), segmentDirectory, segmentBasename, true, compactEncoding, priority);
+            midiFile.addTracks(NUM_TRACKS);
+            midiFile.setTPQ(tpq);
+            midiFile.makeAbsoluteTicks();
+        }
+
+        void processBuffer(const int64_t index)
+        {
+            auto buffer = buffers[index % NUM_BUFFERS];
+            processEvents(buffer);
+            if (segmentEnds[index % NUM_BUFFERS].load(std::memory_order_relaxed)) {
+                segmentEnds[index % NUM_BUFFERS].store(false, std::memory_order_relaxed);
+                finishSegment();
+            }
+        }
+
         void processEvents(std::vector<smf::MidiEvent> buffer[NUM_TRACKS])
         {
             for (int t = 0; t < NUM_TRACKS; t++) {
                 // copy events out of the buffer into the midiFile eventLists:
 #ifdef SDTDEBUG
                 if (buffer[t].size() > 0) {
-                    INFO("WORKER CONSUMING %lu events on track %d (buf %lld)", buffer[t].size(), t, workerBufferIndex);
+                    INFO("WORKER CONSUMING %lu events on track %d (buf %lld)", buffer[t].size(), t, (long long)workerBufferIndex.load());
                 }
 #endif
                 for (size_t i = 0; i < buffer[t].size(); i++) {
@@ -98,27 +190,43 @@ namespace MIDIRecorder {
 
         void run()
         {
+            if (!priority.isDefault() && !priority.apply()) {
+                WARN("Could not fully apply the requested scheduling to the MIDI buffer worker thread");
+            }
             std::unique_lock<std::mutex> lock(workerMutex);
             while (running) {
                 // wait until the master thread tells us there's something to process:
                 workerCv.wait(lock);
-                for (; workerBufferIndex < bufferIndex; workerBufferIndex++) {
-                    auto buffer = buffers[workerBufferIndex % NUM_BUFFERS];
-                    processEvents(buffer);
+                const int64_t end = bufferIndex.load(std::memory_order_acquire);
+                for (int64_t index = workerBufferIndex.load(std::memory_order_relaxed); index < end; index++) {
+                    processBuffer(index);
+                    workerBufferIndex.store(index + 1, std::memory_order_release);
                 }
             }
-            // we're not running any more, but there may be some pent up events we need to handle:
-            for (int i = 0; i < NUM_BUFFERS; i++) {
-                auto buffer = buffers[i];
-                processEvents(buffer);
+            // we're not running any more, but there may be some pent up events we need to handle
+            // (including the partially filled current buffer).  Drain them in order so that
+            // segment boundaries land in the right place:
+            const int64_t end = bufferIndex.load(std::memory_order_acquire);
+            for (int64_t index = workerBufferIndex.load(std::memory_order_relaxed); index <= end; index++) {
+                processBuffer(index);
+                workerBufferIndex.store(index + 1, std::memory_order_release);
             }
             /// now we fall off the end of the thread
         }
 
-        void start()
+        void start(const std::string& directory, const std::string& basename, const bool compact, const ThreadPriority& threadPriority)
         {
-            workerBufferIndex = 0;
-            bufferIndex = 0;
+            compactEncoding = compact;
+            priority = threadPriority;
+            workerBufferIndex.store(0, std::memory_order_relaxed);
+            bufferIndex.store(0, std::memory_order_relaxed);
+            segmentEventCount = 0;
+            ringTickOffset = 0;
+            segmentLastTick = 0;
+            ring.reset();
+            ring.recording.store(true, std::memory_order_relaxed);
+            segmentDirectory = directory;
+            segmentBasename = basename;
 
             if (workerThread.joinable()) {
                 return;
@@ -132,6 +240,7 @@ namespace MIDIRecorder {
 
         void stop()
         {
+            ring.recording.store(false, std::memory_order_relaxed);
             if (!workerThread.joinable()) {
                 return;
             }
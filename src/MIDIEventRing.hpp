@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Chinenual {
+namespace MIDIRecorder {
+
+    // A lock-free single producer / single consumer ring of the most recently recorded channel
+    // messages, used by the live view of the take in progress.  The producer never waits: when the
+    // consumer falls more than SIZE entries behind, the oldest entries are simply overwritten and the
+    // consumer skips ahead.  The consumer never touches the MidiFile being recorded.
+
+    struct MIDIEventRing {
+        static const int64_t SIZE = 4096; // must be a power of 2
+
+        struct Entry {
+            int64_t tick; // continuous across segments (see MIDIBuffer::endSegment)
+            uint8_t track;
+            uint8_t status;
+            uint8_t data1;
+            uint8_t data2;
+        };
+
+        Entry entries[SIZE];
+        // total number of entries ever published
+        std::atomic<int64_t> head { 0 };
+        // the recorder's current position, so the view scrolls even when nothing is played
+        std::atomic<int64_t> nowTick { 0 };
+        // the recorder's tempo (which sets the view's time scale), and whether a take is in progress
+        std::atomic<double> bpm { 120.0 };
+        std::atomic<bool> recording { false };
+        // incremented for each new recording so the consumer knows to start over at firstEntry
+        std::atomic<int64_t> generation { 0 };
+        std::atomic<int64_t> firstEntry { 0 };
+
+        // producer only
+        void push(const int64_t tick, const int track, const uint8_t status, const uint8_t data1, const uint8_t data2)
+        {
+            int64_t h = head.load(std::memory_order_relaxed);
+            Entry& e = entries[h & (SIZE - 1)];
+            e.tick = tick;
+            e.track = track;
+            e.status = status;
+            e.data1 = data1;
+            e.data2 = data2;
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        // producer only
+        void reset()
+        {
+            nowTick.store(0, std::memory_order_relaxed);
+            firstEntry.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+        }
+
+        // consumer only: call f(entry) for each entry published since `from`, and return the index to
+        // pass next time.
+        template <typename F>
+        int64_t read(int64_t from, F f)
+        {
+            int64_t h = head.load(std::memory_order_acquire);
+            if (h - from > SIZE) {
+                // fell behind - the oldest entries are gone
+                from = h - SIZE;
+            }
+            for (; from < h; from++) {
+                Entry e = entries[from & (SIZE - 1)];
+                // if the producer reached this slot again while we were copying, the entry may be
+                // torn - drop it.  The fence keeps the copy from being reordered after the re-check.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (head.load(std::memory_order_relaxed) - from >= SIZE) {
+                    continue;
+                }
+                f(e);
+            }
+            return h;
+        }
+    };
+
+} // namespace MIDIRecorder
+} // namespace Chinenual
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "MidiFile.h"
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace Chinenual {
+namespace MIDIRecorder {
+
+    // A compact alternative to smf::MidiFile::write() for recordings.  Produces the same Standard
+    // MIDI File, except that:
+    //
+    //  * consecutive channel messages with the same status byte (e.g. a stream of controller
+    //    changes on one channel) use running status - the status byte is only written once;
+    //  * a controller re-sent with an identical value on the same tick (e.g. the unchanged MSB of a
+    //    14bit pair, or the same CC recorded by more than one column) is dropped.
+    //
+    // Events are written in the order they appear in each track, as MidiFile::write() does.
+
+    struct MIDIFileEncoder {
+        // number of redundant controller events left out of the last file written
+        int droppedEvents = 0;
+
+        static void writeVLValue(long value, std::vector<smf::uchar>& out)
+        {
+            smf::uchar bytes[5];
+            int n = 0;
+            bytes[n++] = value & 0x7f;
+            value >>= 7;
+            while (value > 0) {
+                bytes[n++] = (value & 0x7f) | 0x80;
+                value >>= 7;
+            }
+            while (n > 0) {
+                out.push_back(bytes[--n]);
+            }
+        }
+
+        void encodeTrack(const smf::MidiEventList& events, std::vector<smf::uchar>& trackdata)
+        {
+            // last value written for each channel's controllers, and the tick it was written at
+            int lastValue[16][128];
+            int lastTick[16][128];
+            memset(lastValue, -1, sizeof(lastValue));
+
+            smf::uchar runningStatus = 0;
+            int prevTick = 0;
+            for (int j = 0; j < events.size(); j++) {
+                const smf::MidiEvent& event = events[j];
+                if (event.empty() || event.isEndOfTrack()) {
+                    // same as MidiFile::write(): a single end of track is added below
+                    continue;
+                }
+                const smf::uchar status = event[0];
+                if ((status & 0xf0) == 0xb0 && event.size() >= 3) {
+                    const int channel = status & 0x0f;
+                    const int cc = event[1];
+                    if (lastValue[channel][cc] == event[2] && lastTick[channel][cc] == event.tick) {
+                        droppedEvents++;
+                        continue;
+                    }
+                    lastValue[channel][cc] = event[2];
+                    lastTick[channel][cc] = event.tick;
+                    if (cc < 32) {
+                        // a new MSB resets the LSB on the receiver, so the LSB must be sent again
+                        lastValue[channel][cc + 32] = -1;
+                    }
+                }
+
+                writeVLValue(event.tick - prevTick, trackdata);
+                prevTick = event.tick;
+
+                if (status == 0xf0 || status == 0xf7) {
+                    // sysex: length prefixed, as in MidiFile::write()
+                    trackdata.push_back(status);
+                    writeVLValue((int)event.size() - 1, trackdata);
+                    trackdata.insert(trackdata.end(), event.begin() + 1, event.end());
+                    runningStatus = 0;
+                } else if (status >= 0xf0) {
+                    // meta events cancel running status
+                    trackdata.insert(trackdata.end(), event.begin(), event.end());
+                    runningStatus = 0;
+                } else {
+                    if (status != runningStatus) {
+                        trackdata.push_back(status);
+                        runningStatus = status;
+                    }
+                    trackdata.insert(trackdata.end(), event.begin() + 1, event.end());
+                }
+            }
+            // end of track
+            writeVLValue(0, trackdata);
+            trackdata.push_back(0xff);
+            trackdata.push_back(0x2f);
+            trackdata.push_back(0x00);
+        }
+
+        bool write(smf::MidiFile& midiFile, std::ostream& out)
+        {
+            midiFile.makeAbsoluteTicks();
+            droppedEvents = 0;
+
+            out.write("MThd", 4);
+            smf::MidiFile::writeBigEndianULong(out, 6);
+            smf::MidiFile::writeBigEndianUShort(out, midiFile.getNumTracks() == 1 ? 0 : 1);
+            smf::MidiFile::writeBigEndianUShort(out, midiFile.getNumTracks());
+            smf::MidiFile::writeBigEndianUShort(out, midiFile.getTicksPerQuarterNote());
+
+            std::vector<smf::uchar> trackdata;
+            for (int t = 0; t < midiFile.getNumTracks(); t++) {
+                trackdata.clear();
+                encodeTrack(midiFile[t], trackdata);
+                out.write("MTrk", 4);
+                smf::MidiFile::writeBigEndianULong(out, trackdata.size());
+                out.write((const char*)trackdata.data(), trackdata.size());
+            }
+            return out.good();
+        }
+
+        bool write(smf::MidiFile& midiFile, const std::string& filename)
+        {
+            std::fstream out(filename.c_str(), std::ios::binary | std::ios::out);
+            if (!out.is_open()) {
+                return false;
+            }
+            return write(midiFile, out);
+        }
+    };
+
+} // namespace MIDIRecorder
+} // namespace Chinenual
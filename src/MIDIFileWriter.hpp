@@ -0,0 +1,158 @@
+#pragma once
+
+#include "MIDIFileEncoder.hpp"
+#include "MidiFile.h"
+#include "ThreadPriority.hpp"
+#include "plugin.hpp"
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace Chinenual {
+namespace MIDIRecorder {
+
+    // Writes finished MIDI files to disk on a background thread so that neither the audio thread nor
+    // the MIDIBuffer worker has to wait on file I/O.  Files are written one at a time in the order they
+    // were handed off, so the segments of a split recording land on disk in sequence (and the
+    // "-001, -002" numbering sees the previous segment's file before picking the next name).
+
+    struct MIDIFileWriter {
+        struct Job {
+            smf::MidiFile midiFile;
+            std::string directory;
+            std::string basename;
+            bool incrementPath;
+            bool compactEncoding;
+            ThreadPriority priority;
+        };
+
+        bool running = false;
+        std::thread writerThread;
+        std::mutex writerMutex;
+        std::condition_variable writerCv;
+        std::deque<Job> jobs;
+        // the scheduling currently applied to the writer thread
+        ThreadPriority appliedPriority;
+        // a refusal is reported once per thread: without CAP_SYS_NICE a raised nice value can't be
+        // lowered again, so every later job would be refused too
+        bool priorityRefused = false;
+
+        ~MIDIFileWriter()
+        {
+            stop();
+        }
+
+        static std::string nextPath(const std::string& directory, const std::string& basename, const bool incrementPath)
+        {
+            const std::string extension = "mid";
+            std::string newPath = directory + "/" + basename + "." + extension;
+            if (incrementPath) {
+                for (int i = 0; i <= 999; i++) {
+                    newPath = directory + "/" + basename;
+                    if (i > 0)
+                        newPath += string::f("-%03d", i);
+                    newPath += "." + extension;
+                    // Skip if file exists
+                    if (!system::isFile(newPath))
+                        break;
+                }
+            }
+            return newPath;
+        }
+
+        static void write(Job& job)
+        {
+            int numEvents = 0;
+            for (int t = 0; t < job.midiFile.getNumTracks(); t++) {
+                if (job.midiFile[t].size() <= 2) {
+                    // unused track - just the tempo info
+                    job.midiFile[t].clear();
+                } else {
+                    numEvents += job.midiFile[t].size();
+                }
+            }
+            std::string newPath = nextPath(job.directory, job.basename, job.incrementPath);
+
+            INFO("Writing %d events to %s", numEvents, newPath.c_str());
+            if (job.compactEncoding) {
+                MIDIFileEncoder encoder;
+                encoder.write(job.midiFile, newPath);
+                INFO("Dropped %d redundant controller events", encoder.droppedEvents);
+            } else {
+                job.midiFile.write(newPath);
+            }
+
+#ifdef SDTDEBUG
+            auto dbgPath = newPath + ".txt";
+            job.midiFile.writeBinascWithComments(dbgPath);
+#endif
+        }
+
+        // Hand off a finished recording.  The midiFile is moved into the queue; the caller's object
+        // is left empty and ready for reuse.  The writer thread adopts the given scheduling before
+        // writing it.  compactEncoding selects MIDIFileEncoder rather than MidiFile::write().
+        void enqueue(smf::MidiFile&& midiFile, const std::string& directory, const std::string& basename, const bool incrementPath, const bool compactEncoding, const ThreadPriority& priority)
+        {
+            {
+                std::lock_guard<std::mutex> lock(writerMutex);
+                jobs.push_back(Job { std::move(midiFile), directory, basename, incrementPath, compactEncoding, priority });
+            }
+            start();
+            writerCv.notify_one();
+        }
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(writerMutex);
+            while (true) {
+                writerCv.wait(lock, [this] { return (!jobs.empty()) || (!running); });
+                if (jobs.empty()) {
+                    // stopped and nothing left to write
+                    break;
+                }
+                Job job = std::move(jobs.front());
+                jobs.pop_front();
+                // don't hold the lock while writing - the next segment may be handed off meanwhile
+                lock.unlock();
+                if (job.priority != appliedPriority) {
+                    if (!job.priority.apply() && !priorityRefused) {
+                        WARN("Could not fully apply the requested scheduling to the MIDI file writer thread");
+                        priorityRefused = true;
+                    }
+                    appliedPriority = job.priority;
+                }
+                write(job);
+                lock.lock();
+            }
+        }
+
+        void start()
+        {
+            if (writerThread.joinable()) {
+                return;
+            }
+            running = true;
+            appliedPriority = ThreadPriority();
+            priorityRefused = false;
+            writerThread = std::thread([this] {
+                run();
+            });
+        }
+
+        // waits for any pending files to be written
+        void stop()
+        {
+            if (!writerThread.joinable()) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(writerMutex);
+                running = false;
+            }
+            writerCv.notify_all();
+            writerThread.join();
+        }
+    };
+
+} // namespace MIDIRecorder
+} // namespace Chinenual
@@ -2,9 +2,13 @@
 
 #include "CVRange.hpp"
 #include "MIDIBuffer.hpp"
+#include "MIDIEventRing.hpp"
+#include "ThreadPriority.hpp"
+#include "MIDIFileWriter.hpp"
 #include "MIDIRecorderBase.hpp"
 #include "MidiFile.h"
 #include "Style.hpp"
+#include "TextDisplay.hpp"
 #include "plugin.hpp"
 
 namespace Chinenual {
@@ -35,6 +39,39 @@ namespace MIDIRecorder {
         }
 
         void reset() { MidiGenerator::reset(); }
+
+        // Close any notes that are still sounding so that the segment being finished is
+        // self-contained.  The generator now thinks the gates are low, so the next setNoteGate()
+        // re-opens each still-held note in the new segment.  Forget the last controller values
+        // too, so the new segment starts with a full snapshot of the controllers.
+        void endSegment()
+        {
+            for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+                if (gates[c]) {
+                    setNoteGate(notes[c], false, c);
+                }
+                keyPressures[c] = -1;
+            }
+            for (int cc = 0; cc < 128; cc++) {
+                ccs[cc] = -1;
+            }
+            pw = -1;
+        }
+    };
+
+    // take rollover choices presented in the context menu:
+    static const int ROLLOVER_MINUTES[] = { 0, 1, 5, 10, 15, 30, 60 };
+    static const std::vector<std::string> ROLLOVER_MINUTES_NAMES = {
+        "Never", "1 minute", "5 minutes", "10 minutes", "15 minutes", "30 minutes", "60 minutes"
+    };
+    // live view length choices presented in the context menu:
+    static const int LIVE_VIEW_SECONDS[] = { 5, 10, 30, 60 };
+    static const std::vector<std::string> LIVE_VIEW_SECONDS_NAMES = {
+        "5 seconds", "10 seconds", "30 seconds", "60 seconds"
+    };
+    static const int ROLLOVER_MB[] = { 0, 1, 2, 5, 10, 50 };
+    static const std::vector<std::string> ROLLOVER_MB_NAMES = {
+        "Never", "1 MB", "2 MB", "5 MB", "10 MB", "50 MB"
     };
 
     static void selectPath(Module* module);
@@ -85,6 +122,20 @@ namespace MIDIRecorder {
     struct MIDIRecorder : MIDIRecorderBase<6> {
         MasterToExpanderMessage master_to_expander_message_a;
         MasterToExpanderMessage master_to_expander_message_b;
+        // the merged messages of the whole chain of expanders, as delivered by the first one; null
+        // if there are none (updated once per frame)
+        const ExpanderToMasterMessage* expanderMessage = 0;
+        // passed to the expanders; see MasterToExpanderMessage
+        int take = 0;
+        // expander messages that didn't fit in the chain's message blocks this segment
+        int64_t droppedExpanderMsgs = 0;
+        AdaptiveSampler pwSamplers[NUM_TRACKS];
+        AdaptiveSampler mwSamplers[NUM_TRACKS];
+        // the one sampling budget of the recorder and its expanders
+        EventBudget samplingBudget;
+        // alternates, so that the expanders and the recorder's own lanes take turns at picking first
+        // from the budget
+        bool chainPicksFirst = false;
 
         enum ParamId {
             RUN_PARAM,
@@ -183,13 +234,21 @@ namespace MIDIRecorder {
         std::string path;
         bool incrementPath;
         bool alignToFirstNote;
+        bool compactEncoding;
         CVRangeIndex cvConfigVel;
         CVRangeIndex cvConfigAft;
         CVRangeIndex cvConfigPw;
         CVRangeIndex cvConfigMw;
         bool mwIs14bit;
+        int rolloverMinutes; // 0 == never
+        int rolloverMB; // 0 == never
+        int liveViewSeconds;
+        // scheduling of the background worker and file writer threads
+        ThreadPriority threadPriority;
 
         smf::MidiFile midiFile;
+        // the writer must outlive the midiBuffer, since the buffer's worker hands segments to it
+        MIDIFileWriter midiFileWriter;
         MIDIBuffer midiBuffer;
         MidiCollector midiCollectors[NUM_TRACKS] = {
             MidiCollector(midiBuffer, 0, clock.tick),
@@ -206,10 +265,10 @@ namespace MIDIRecorder {
 
         MIDIRecorder()
             : MIDIRecorderBase(T1_PITCH_INPUT)
-            , midiBuffer(midiFile)
+            , midiBuffer(midiFile, midiFileWriter)
         {
             rightExpander.consumerMessage = &master_to_expander_message_a;
-            rightExpander.producerMessage = &master_to_expander_message_a;
+            rightExpander.producerMessage = &master_to_expander_message_b;
 
             onReset();
 
@@ -281,6 +340,12 @@ namespace MIDIRecorder {
             cvConfigPw = CV_RANGE_n5_5;
             cvConfigMw = CV_RANGE_0_10;
             mwIs14bit = false;
+            rolloverMinutes = 0;
+            rolloverMB = 0;
+            liveViewSeconds = 10;
+            compactEncoding = false;
+            threadPriority = ThreadPriority();
+            sampling = SamplingConfig();
 
             clearRecording();
         }
@@ -292,6 +357,14 @@ namespace MIDIRecorder {
             json_object_set_new(rootJ, "incrementPath", json_boolean(incrementPath));
             json_object_set_new(rootJ, "alignToFirstNote",
                 json_boolean(alignToFirstNote));
+            json_object_set_new(rootJ, "rolloverMinutes", json_integer(rolloverMinutes));
+            json_object_set_new(rootJ, "rolloverMB", json_integer(rolloverMB));
+            json_object_set_new(rootJ, "liveViewSeconds", json_integer(liveViewSeconds));
+            json_object_set_new(rootJ, "compactEncoding", json_boolean(compactEncoding));
+            sampling.toJson(rootJ);
+            json_object_set_new(rootJ, "threadPolicy", json_integer(threadPriority.policy));
+            json_object_set_new(rootJ, "threadNice", json_integer(threadPriority.nice));
+            json_object_set_new(rootJ, "threadPinToLastCPU", json_boolean(threadPriority.pinToLastCPU));
             return rootJ;
         }
 
@@ -308,6 +381,36 @@ namespace MIDIRecorder {
             json_t* alignToFirstNoteJ = json_object_get(rootJ, "alignToFirstNote");
             if (alignToFirstNoteJ)
                 alignToFirstNote = json_boolean_value(alignToFirstNoteJ);
+
+            json_t* rolloverMinutesJ = json_object_get(rootJ, "rolloverMinutes");
+            if (rolloverMinutesJ)
+                rolloverMinutes = json_integer_value(rolloverMinutesJ);
+
+            json_t* rolloverMBJ = json_object_get(rootJ, "rolloverMB");
+            if (rolloverMBJ)
+                rolloverMB = json_integer_value(rolloverMBJ);
+
+            json_t* liveViewSecondsJ = json_object_get(rootJ, "liveViewSeconds");
+            if (liveViewSecondsJ)
+                liveViewSeconds = json_integer_value(liveViewSecondsJ);
+
+            json_t* compactEncodingJ = json_object_get(rootJ, "compactEncoding");
+            if (compactEncodingJ)
+                compactEncoding = json_boolean_value(compactEncodingJ);
+
+            sampling.fromJson(rootJ);
+
+            json_t* threadPolicyJ = json_object_get(rootJ, "threadPolicy");
+            if (threadPolicyJ)
+                threadPriority.policy = clamp((int)json_integer_value(threadPolicyJ), 0, NUM_THREAD_POLICIES - 1);
+
+            json_t* threadNiceJ = json_object_get(rootJ, "threadNice");
+            if (threadNiceJ)
+                threadPriority.nice = clamp((int)json_integer_value(threadNiceJ), THREAD_NICE_MIN, THREAD_NICE_MAX);
+
+            json_t* threadPinToLastCPUJ = json_object_get(rootJ, "threadPinToLastCPU");
+            if (threadPinToLastCPUJ)
+                threadPriority.pinToLastCPU = json_boolean_value(threadPinToLastCPUJ);
         }
 
         bool trackIsActive(const int track) override
@@ -316,19 +419,7 @@ namespace MIDIRecorder {
                 return true;
             }
             // check expanders:
-            Module* m = rightExpander.module;
-            while (m) {
-                if (m->model == modelMIDIRecorderCC) {
-                    auto consumerMessage = (ExpanderToMasterMessage*)m->leftExpander.consumerMessage;
-                    if (consumerMessage->active[track]) {
-                        return true;
-                    }
-                } else {
-                    break;
-                }
-                m = m->rightExpander.module;
-            }
-            return false;
+            return expanderMessage && expanderMessage->active[track];
         }
 
         bool isActivelyRecording()
@@ -377,26 +468,48 @@ namespace MIDIRecorder {
 
             {
                 // check expanders - they have indepentent rate limiters, so check every frame
-                Module* m = rightExpander.module;
-                while (m) {
-                    if (m->model == modelMIDIRecorderCC) {
-                        auto consumerMessage = (ExpanderToMasterMessage*)m->leftExpander.consumerMessage;
-                        for (auto&& msg : consumerMessage->msgs[track]) {
+                if (expanderMessage) {
+                    droppedExpanderMsgs += expanderMessage->droppedMsgs[track];
+                    for (int i = 0; i < expanderMessage->numMsgs[track]; i++) {
+                        const ControllerRecord& msg = expanderMessage->msgs[track][i];
 #if 0
-                            INFO("data from expander: %d %2x", track, msg.getCommandByte());
+                        INFO("data from expander: %d %2x", track, msg.status);
 #endif
-                            /// midiCollectors[track].setCc(msg.getControllerValue(), msg.getControllerNumber());
-                            smf::MidiEvent event(clock.tick, track, msg);
-                            midiBuffer.appendEvent(track, event);
-                        }
-                    } else {
-                        break;
+                        smf::MidiEvent event(msg.status, msg.cc, msg.value);
+                        event.tick = clock.tick;
+                        event.track = track;
+                        midiBuffer.appendEvent(track, event);
                     }
-                    m = m->rightExpander.module;
                 }
             }
 
-            if (rateLimiterTriggered) {
+            if (sampling.adaptive) {
+                if (inputs[PW_INPUT].isConnected()) {
+                    float pw = CVRanges[cvConfigPw].scale14bit(inputs[PW_INPUT].getVoltage());
+                    if (pwSamplers[track].process(args.sampleTime, pw, sampling, SAMPLING_ERROR_14BIT) && samplingBudget.take()) {
+                        pwSamplers[track].sent(pw);
+                        midiCollectors[track].setPitchWheel((int)std::round(pw));
+                    }
+                }
+                if (inputs[MW_INPUT].isConnected()) {
+                    if (mwIs14bit) {
+                        float mw = CVRanges[cvConfigMw].scale14bit(inputs[MW_INPUT].getVoltage());
+                        if (mwSamplers[track].process(args.sampleTime, mw, sampling, SAMPLING_ERROR_14BIT) && samplingBudget.take()) {
+                            mwSamplers[track].sent(mw);
+                            int lsb, msb;
+                            CVRanges[cvConfigMw].split14bit((int)std::round(mw), msb, lsb);
+                            midiCollectors[track].setCc(1, msb);
+                            midiCollectors[track].setCc(33, lsb);
+                        }
+                    } else {
+                        float mw = CVRanges[cvConfigMw].scale7bit(inputs[MW_INPUT].getVoltage());
+                        if (mwSamplers[track].process(args.sampleTime, mw, sampling, SAMPLING_ERROR_7BIT) && samplingBudget.take()) {
+                            mwSamplers[track].sent(mw);
+                            midiCollectors[track].setModWheel((int)std::round(mw));
+                        }
+                    }
+                }
+            } else if (rateLimiterTriggered) {
                 // The RACK CV-MIDI code doesn't guard each input with isConnected(),
                 // but I've noticed noise on test recordings (e.g. a stray "polyphonic
                 // aftertouch" even if nothing connected to those inputs).  So play it
@@ -462,18 +575,80 @@ namespace MIDIRecorder {
             }
         }
 
+        // so that every lane is sampled again at the start of a file
+        void resetSamplers()
+        {
+            for (int t = 0; t < NUM_TRACKS; t++) {
+                pwSamplers[t].reset();
+                mwSamplers[t].reset();
+            }
+        }
+
+        bool isSegmented()
+        {
+            return rolloverMinutes > 0 || rolloverMB > 0;
+        }
+
+        bool rolloverDue()
+        {
+            if (!isActivelyRecording()) {
+                return false;
+            }
+            if (rolloverMinutes > 0 && clock.totalTimeSecs >= rolloverMinutes * SEC_PER_MINUTE) {
+                return true;
+            }
+            if (rolloverMB > 0 && midiBuffer.segmentSizeEstimate() >= (int64_t)rolloverMB * 1024 * 1024) {
+                return true;
+            }
+            return false;
+        }
+
+        void reportDroppedExpanderMsgs()
+        {
+            if (droppedExpanderMsgs > 0) {
+                WARN("Dropped %lld controller messages from a chain of more than %d expanders", (long long)droppedExpanderMsgs, MAX_CHAINED_EXPANDERS);
+                droppedExpanderMsgs = 0;
+            }
+        }
+
+        // Finish the current segment and start a new one at this sample.  Held notes are closed at
+        // the last tick of the old segment (the clock has not advanced for this sample yet) and are
+        // re-opened at tick 0 of the new one.
+        void rollover()
+        {
+            for (int t = 0; t < NUM_TRACKS; t++) {
+                if (trackIsActive(t)) {
+                    midiCollectors[t].endSegment();
+                }
+            }
+            midiBuffer.endSegment();
+            reportDroppedExpanderMsgs();
+            take++;
+            resetSamplers();
+            INFO("Rollover.  segment totalTimeSecs=%f ticks=%d", clock.totalTimeSecs, clock.tick);
+            clock.reset(clock.bpm);
+        }
+
         void processMidi(const ProcessArgs& args)
         {
             double newBpm = getBPM();
             bool tempoChanged = newBpm != clock.bpm;
             clock.bpm = newBpm;
 
+            if (rolloverDue()) {
+                rollover();
+                // each segment starts with its own tempo event
+                tempoChanged = true;
+            }
+
             clock.incrementTick(args.sampleTime, tempoChanged);
+            midiBuffer.publishTick(clock.tick, clock.bpm);
 
 #if 0
             INFO("ACTIVE: %d %d %d %d %d %d %d %d %d %d", trackIsActive(0), trackIsActive(1), trackIsActive(2), trackIsActive(3), trackIsActive(4), trackIsActive(5), trackIsActive(6), trackIsActive(7), trackIsActive(8), trackIsActive(9));
 #endif
-            for (int t = 0; t < NUM_TRACKS; t++) {
+            for (int i = 0; i < NUM_TRACKS; i++) {
+                const int t = (firstTrack + i) % NUM_TRACKS;
                 if (trackIsActive(t)) {
                     processMidiTrack(args, t, tempoChanged);
                 }
@@ -483,6 +658,8 @@ namespace MIDIRecorder {
         void startRecording(const ProcessArgs& args)
         {
             midiBuffer.stop();
+            take++;
+            resetSamplers();
 
             if (path == "") {
                 INFO("ERROR: No Path in startRecording");
@@ -504,7 +681,7 @@ namespace MIDIRecorder {
                     midiFile.addTempo(t, 0, clock.bpm);
                 }
             }
-            midiBuffer.start();
+            midiBuffer.start(pathDirectory, pathBasename, compactEncoding, threadPriority);
 
             clock.reset(clock.bpm);
             INFO("Start Recording... BPM: %f num_tracks: %d", clock.bpm, num_tracks);
@@ -514,39 +691,16 @@ namespace MIDIRecorder {
         void stopRecording(const ProcessArgs& args)
         {
             midiBuffer.stop();
+            reportDroppedExpanderMsgs();
 
             running = false;
-            int numEvents = 0;
-            for (int t = 0; t < midiFile.getNumTracks(); t++) {
-                if (midiFile[t].size() <= 2) {
-                    // unused track - just the tempo info
-                    midiFile[t].clear();
-                } else {
-                    numEvents += midiFile[t].size();
-                }
-            }
-            std::string newPath = path;
-            if (incrementPath) {
-                std::string extension = "mid";
-                for (int i = 0; i <= 999; i++) {
-                    newPath = pathDirectory + "/" + pathBasename;
-                    if (i > 0)
-                        newPath += string::f("-%03d", i);
-                    newPath += "." + extension;
-                    // Skip if file exists
-                    if (!system::isFile(newPath))
-                        break;
-                }
-            }
 
-            INFO("Stop Recording.  totalTimeSecs=%f ticks=%d events=%d.  Writing to %s",
-                clock.totalTimeSecs, clock.tick, numEvents, newPath.c_str());
-            midiFile.write(newPath);
+            INFO("Stop Recording.  totalTimeSecs=%f ticks=%d", clock.totalTimeSecs, clock.tick);
+            // the file is written in the background.  Segmented recordings are always numbered so that
+            // the last segment doesn't overwrite the first.
+            midiFileWriter.enqueue(std::move(midiFile), midiBuffer.segmentDirectory, midiBuffer.segmentBasename,
+                incrementPath || isSegmented(), compactEncoding, threadPriority);
 
-#ifdef SDTDEBUG
-            auto dbgPath = newPath + ".txt";
-            midiFile.writeBinascWithComments(dbgPath);
-#endif
             // free memory:
             clearRecording();
         }
@@ -567,6 +721,23 @@ namespace MIDIRecorder {
         {
             MIDIRecorderBase::process(args);
 
+            expanderMessage = 0;
+            const bool hasExpander = rightExpander.module && rightExpander.module->model == modelMIDIRecorderCC;
+            if (hasExpander) {
+                auto consumerMessage = (ExpanderToMasterMessage*)rightExpander.module->leftExpander.consumerMessage;
+                if (consumerMessage->isFresh(args.frame)) {
+                    expanderMessage = consumerMessage;
+                    samplingBudget.refund(consumerMessage->returnedGrant);
+                }
+            }
+            samplingBudget.process(args.sampleTime, sampling.budget);
+            firstTrack = (firstTrack + 1) % NUM_TRACKS;
+            chainPicksFirst = !chainPicksFirst;
+            int samplingGrant = 0;
+            if (hasExpander && running && chainPicksFirst) {
+                samplingGrant = samplingBudget.grantAll();
+            }
+
             auto wasRunning = running;
             int runRequested;
             // Run button:
@@ -597,7 +768,15 @@ namespace MIDIRecorder {
             {
                 // tell any expanders that we're expecting them to send us data
                 auto producerMessage = (MasterToExpanderMessage*)rightExpander.producerMessage;
+                if (hasExpander && running && !chainPicksFirst) {
+                    samplingGrant = samplingBudget.grantAll();
+                }
+                producerMessage->frame = args.frame;
+                producerMessage->connected = true;
                 producerMessage->isRecording = running;
+                producerMessage->take = take;
+                producerMessage->samplingGrant = samplingGrant;
+                producerMessage->firstTrack = firstTrack;
                 rightExpander.requestMessageFlip();
             }
             lights[REC_LIGHT].setBrightness(running ? 1.0f : 0.0f);
@@ -665,43 +844,210 @@ namespace MIDIRecorder {
         }
     };
 
-    struct BPMDisplayWidget : TransparentWidget {
-        std::shared_ptr<Font> font;
-        std::string fontPath;
+    struct BPMDisplayWidget : TextDisplay {
         char displayStr[16];
         double* bpmPtr;
         MIDIRecorder* module;
 
         BPMDisplayWidget(MIDIRecorder* m, double* bpm)
+            : TextDisplay(asset::plugin(pluginInstance, "res/fonts/DSEG14Modern-BoldItalic.ttf"), 17, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, 60.0)
         {
             module = m;
             bpmPtr = bpm;
-            fontPath = std::string(
-                asset::plugin(pluginInstance, "res/fonts/DSEG14Modern-BoldItalic.ttf"));
         }
 
-        void drawLayer(const DrawArgs& args, int layer) override
+        void step() override
         {
-            if (layer == 1) {
+            setColor(Style::getNVGColor(module ? (Style::Color)module->params[MIDIRecorder::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR));
+            unsigned int bpm = bpmPtr ? std::round(*bpmPtr) : 120;
+            snprintf(displayStr, 16, "%3u", bpm);
+            setText(displayStr);
+            TextDisplay::step();
+        }
+    };
 
-                NVGcolor ledTextColor = Style::getNVGColor(module ? (Style::Color)module->params[MIDIRecorder::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR);
+    // A scrolling piano roll (plus a controller lane) of the last few seconds of the take in progress.
+    // Events are read from the MIDIBuffer's lock-free ring - never from the midiFile being recorded -
+    // and rasterized, as they arrive, into a fixed number of time columns.  So drawing costs the
+    // same no matter how long the take is, and the framebuffer is only redrawn when a column changes.
+    struct LiveViewGrid : Widget {
+        static const int COLUMNS = 64;
+        static const int NOTE_LOW = 36; // C2
+        static const int NOTE_HIGH = 96; // C7
+
+        struct Column {
+            uint64_t notes[2]; // one bit per MIDI note sounding during this column
+            int cc; // last controller or pitchbend value seen in this column; -1 if none
+        };
 
-                if (!(font = APP->window->loadFont(fontPath))) {
-                    return;
+        MIDIRecorder* module;
+        Column columns[COLUMNS];
+        int64_t columnIndex; // absolute number of the newest column
+        double columnStartTick;
+        uint64_t held[2]; // notes currently sounding
+        int64_t readIndex = 0;
+        int64_t generation = -1;
+
+        LiveViewGrid(MIDIRecorder* m)
+        {
+            module = m;
+            clear();
+        }
+
+        void clear()
+        {
+            held[0] = held[1] = 0;
+            columnIndex = 0;
+            columnStartTick = 0.0;
+            for (int i = 0; i < COLUMNS; i++) {
+                columns[i].notes[0] = columns[i].notes[1] = 0;
+                columns[i].cc = -1;
+            }
+        }
+
+        void newColumn()
+        {
+            columnIndex++;
+            Column& col = columns[columnIndex % COLUMNS];
+            col.notes[0] = held[0];
+            col.notes[1] = held[1];
+            col.cc = -1;
+        }
+
+        bool advanceTo(const int64_t tick, const double ticksPerColumn)
+        {
+            if (tick - columnStartTick > COLUMNS * ticksPerColumn) {
+                // a long gap - nothing currently visible survives it
+                for (int i = 0; i < COLUMNS; i++) {
+                    newColumn();
+                }
+                columnStartTick = tick;
+                return true;
+            }
+            bool changed = false;
+            while (tick >= columnStartTick + ticksPerColumn) {
+                columnStartTick += ticksPerColumn;
+                newColumn();
+                changed = true;
+            }
+            return changed;
+        }
+
+        void apply(const MIDIEventRing::Entry& e)
+        {
+            Column& col = columns[columnIndex % COLUMNS];
+            const int word = (e.data1 >> 6) & 1;
+            const uint64_t bit = 1ULL << (e.data1 & 63);
+            switch (e.status & 0xf0) {
+            case 0x90:
+                if (e.data2 > 0) {
+                    held[word] |= bit;
+                    col.notes[word] |= bit;
+                    break;
                 }
-                nvgFontSize(args.vg, 17);
-                nvgFontFaceId(args.vg, font->handle);
+                // velocity 0 is a note off
+                held[word] &= ~bit;
+                break;
+            case 0x80:
+                held[word] &= ~bit;
+                break;
+            case 0xb0:
+                col.cc = e.data2;
+                break;
+            case 0xe0:
+                col.cc = e.data2; // pitchbend MSB
+                break;
+            }
+        }
 
-                Vec textPos = Vec(6, 24);
+        // drain newly arrived events; returns true if anything visible changed
+        bool update()
+        {
+            if (!module) {
+                return false;
+            }
+            MIDIEventRing& ring = module->midiBuffer.ring;
+            bool changed = false;
+            int64_t g = ring.generation.load(std::memory_order_acquire);
+            if (g != generation) {
+                // a new recording
+                generation = g;
+                readIndex = std::max(readIndex, ring.firstEntry.load(std::memory_order_relaxed));
+                clear();
+                changed = true;
+            }
+            if (!ring.recording.load(std::memory_order_relaxed)) {
+                return changed;
+            }
+            const double ticksPerColumn = module->liveViewSeconds * ring.bpm.load(std::memory_order_relaxed) / SEC_PER_MINUTE * MIDI_FILE_PPQ / COLUMNS;
+            readIndex = ring.read(readIndex, [&](const MIDIEventRing::Entry& e) {
+                advanceTo(e.tick, ticksPerColumn);
+                apply(e);
+                changed = true;
+            });
+            if (advanceTo(ring.nowTick.load(std::memory_order_relaxed), ticksPerColumn)) {
+                changed = true;
+            }
+            return changed;
+        }
 
-                nvgFillColor(args.vg, ledTextColor);
+        void draw(const DrawArgs& args) override
+        {
+            NVGcolor ledTextColor = Style::getNVGColor(module ? (Style::Color)module->params[MIDIRecorder::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR);
+
+            nvgBeginPath(args.vg);
+            nvgRect(args.vg, 0, 0, box.size.x, box.size.y);
+            nvgFillColor(args.vg, nvgRGB(0x00, 0x00, 0x00));
+            nvgFill(args.vg);
+
+            const float laneHeight = box.size.y * 0.2f;
+            const float rollHeight = box.size.y - laneHeight;
+            const float noteHeight = rollHeight / (NOTE_HIGH - NOTE_LOW + 1);
+            const float columnWidth = box.size.x / COLUMNS;
+
+            nvgBeginPath(args.vg);
+            for (int i = 0; i < COLUMNS; i++) {
+                // oldest column on the left:
+                const Column& col = columns[(columnIndex + 1 + i) % COLUMNS];
+                const float x = i * columnWidth;
+                for (int word = 0; word < 2; word++) {
+                    uint64_t bits = col.notes[word];
+                    while (bits) {
+                        const int note = word * 64 + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        if (note < NOTE_LOW || note > NOTE_HIGH) {
+                            continue;
+                        }
+                        nvgRect(args.vg, x, rollHeight - (note - NOTE_LOW + 1) * noteHeight, columnWidth, noteHeight);
+                    }
+                }
+                if (col.cc >= 0) {
+                    const float h = laneHeight * col.cc / 127.f;
+                    nvgRect(args.vg, x, box.size.y - h, columnWidth, h);
+                }
+            }
+            nvgFillColor(args.vg, ledTextColor);
+            nvgFill(args.vg);
+        }
+    };
 
-                unsigned int bpm = bpmPtr ? std::round(*bpmPtr) : 120;
-                snprintf(displayStr, 16, "%3u", bpm);
+    struct LiveViewDisplay : FramebufferWidget {
+        LiveViewGrid* grid;
 
-                nvgTextAlign(args.vg, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM);
-                nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
+        LiveViewDisplay(MIDIRecorder* module, Vec size)
+        {
+            box.size = size;
+            grid = new LiveViewGrid(module);
+            grid->box.size = size;
+            addChild(grid);
+        }
+
+        void step() override
+        {
+            if (grid->update()) {
+                setDirty();
             }
+            FramebufferWidget::step();
         }
     };
 
@@ -716,6 +1062,10 @@ namespace MIDIRecorder {
 // shift the entire first column over a nudge to make room for a large button, but keep
 // all the ports and lights aligned with the big button:
 #define FIRST_COL_X (FIRST_X + BUTTON_OFFSET_X)
+// the live view fills the otherwise unused space above the REC button:
+#define LIVE_VIEW_WIDTH 13.0
+#define LIVE_VIEW_HEIGHT 16.0
+#define LIVE_VIEW_Y (FIRST_Y - 6.0)
 
     struct MIDIRecorderWidget : ModuleWidget {
         MIDIRecorderWidget(MIDIRecorder* module)
@@ -769,6 +1119,10 @@ namespace MIDIRecorder {
             bpmDisplay->box.size = Vec(30, 10);
             bpmDisplay->box.pos = mm2px(Vec(FIRST_X + LED_OFFSET_X, FIRST_Y + 8 * SPACING_Y + LED_OFFSET_Y));
             addChild(bpmDisplay);
+
+            auto liveView = new LiveViewDisplay(module, mm2px(Vec(LIVE_VIEW_WIDTH, LIVE_VIEW_HEIGHT)));
+            liveView->box.pos = mm2px(Vec(FIRST_COL_X - LIVE_VIEW_WIDTH / 2.0, LIVE_VIEW_Y));
+            addChild(liveView);
         }
 
         void appendContextMenu(Menu* menu) override
@@ -786,7 +1140,45 @@ namespace MIDIRecorder {
                 &module->incrementPath));
             menu->addChild(createBoolPtrMenuItem("Start at first note gate", "",
                 &module->alignToFirstNote));
+            menu->addChild(createIndexSubmenuItem(
+                "Start a new file every", ROLLOVER_MINUTES_NAMES,
+                [=]() {
+                    for (size_t i = 0; i < ROLLOVER_MINUTES_NAMES.size(); i++) {
+                        if (ROLLOVER_MINUTES[i] == module->rolloverMinutes)
+                            return i;
+                    }
+                    return (size_t)0;
+                },
+                [=](int val) {
+                    module->rolloverMinutes = ROLLOVER_MINUTES[val];
+                }));
+            menu->addChild(createIndexSubmenuItem(
+                "Start a new file at size", ROLLOVER_MB_NAMES,
+                [=]() {
+                    for (size_t i = 0; i < ROLLOVER_MB_NAMES.size(); i++) {
+                        if (ROLLOVER_MB[i] == module->rolloverMB)
+                            return i;
+                    }
+                    return (size_t)0;
+                },
+                [=](int val) {
+                    module->rolloverMB = ROLLOVER_MB[val];
+                }));
 
+            menu->addChild(createBoolPtrMenuItem("Compact MIDI encoding", "",
+                &module->compactEncoding));
+            menu->addChild(createIndexSubmenuItem(
+                "Live view length", LIVE_VIEW_SECONDS_NAMES,
+                [=]() {
+                    for (size_t i = 0; i < LIVE_VIEW_SECONDS_NAMES.size(); i++) {
+                        if (LIVE_VIEW_SECONDS[i] == module->liveViewSeconds)
+                            return i;
+                    }
+                    return (size_t)0;
+                },
+                [=](int val) {
+                    module->liveViewSeconds = LIVE_VIEW_SECONDS[val];
+                }));
             menu->addChild(createIndexSubmenuItem(
                 "VEL Input Range", CVRangeNames,
                 [=]() { return module->cvConfigVel; },
@@ -814,6 +1206,33 @@ namespace MIDIRecorder {
             menu->addChild(createBoolMenuItem(
                 "MW is 14bit", "", [=]() { return module->mwIs14bit; },
                 [=](bool val) { module->mwIs14bit = val; }));
+            appendSamplingMenu(menu, &module->sampling);
+
+#ifdef ARCH_LIN
+            menu->addChild(createSubmenuItem("Background threads", "",
+                [=](Menu* menu) {
+                    menu->addChild(createIndexSubmenuItem(
+                        "Scheduling", ThreadPolicyNames,
+                        [=]() { return module->threadPriority.policy; },
+                        [=](int val) {
+                            module->threadPriority.policy = val;
+                        }));
+                    menu->addChild(createIndexSubmenuItem(
+                        "Nice value", ThreadNiceNames,
+                        [=]() {
+                            for (size_t i = 0; i < ThreadNiceNames.size(); i++) {
+                                if (THREAD_NICE_VALUES[i] == module->threadPriority.nice)
+                                    return i;
+                            }
+                            return (size_t)0;
+                        },
+                        [=](int val) {
+                            module->threadPriority.nice = THREAD_NICE_VALUES[val];
+                        }));
+                    menu->addChild(createBoolPtrMenuItem("Run on last CPU core", "",
+                        &module->threadPriority.pinToLastCPU));
+                }));
+#endif
 
             STYLE_MENUS(MIDIRecorder::STYLE_PARAM);
         }
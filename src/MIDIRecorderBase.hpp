@@ -1,7 +1,9 @@
 #pragma once
 
+#include "AdaptiveSampler.hpp"
 #include "MidiMessage.h"
 #include "plugin.hpp"
+#include <type_traits>
 
 namespace Chinenual {
 namespace MIDIRecorder {
@@ -10,33 +12,112 @@ namespace MIDIRecorder {
     static const NVGcolor textColor_logoyellow = nvgRGB(0xff, 0xd5, 0x56);
 
 #define NUM_TRACKS 10
+// number of CC columns per track on each MIDIRecorderCC expander
+#define CC_COLS_PER_TRACK 5
+// expander messages are sized for at most this many MIDIRecorderCC's in a chain
+#define MAX_CHAINED_EXPANDERS 8
+
+    // The master and the expanders form a chain: each expander passes the master's status on to its
+    // right, and passes its own messages - merged with those from the expanders to its right - on to
+    // its left.  So every module only looks at its immediate neighbours, however long the chain.
 
     struct MasterToExpanderMessage {
-        bool isRecording;
+        // the frame this message was produced in (see ExpanderToMasterMessage::frame)
+        int64_t frame = -1;
+        // is there a master at the left end of the chain?
+        bool connected = false;
+        bool isRecording = false;
+        // changes whenever a new file (or new segment of a file) is started, so expanders know to
+        // send their current values again
+        int take = 0;
+        // events of the master's sampling budget handed to this expander and the rest of the chain
+        // this frame.  Each expander uses what it needs and passes the rest along; the last one
+        // returns what's left in ExpanderToMasterMessage::returnedGrant.
+        int samplingGrant = 0;
+        // the track every module starts at this frame, so no track always picks last from the budget
+        int firstTrack = 0;
+
+        bool isFresh(const int64_t currentFrame) const
+        {
+            return frame + 1 == currentFrame;
+        }
+    };
+
+    // a 3 byte controller message forwarded from an expander
+    struct ControllerRecord {
+        uint8_t status;
+        uint8_t cc;
+        uint8_t value;
     };
 
     struct ExpanderToMasterMessage {
-        // current status of the inputs for each track (are any inputs connected?)
+        // each column can produce at most one message per frame - two if it's 14bit (MSB and LSB) - and
+        // the block carries the messages of every expander further along the chain.  The CC's are
+        // rate limited so in practice there are many fewer than that, and each block is consumed the
+        // frame after it's produced.  Messages beyond that (a longer chain) are dropped, and counted.
+        static const int MAX_MSGS = CC_COLS_PER_TRACK * 2 * MAX_CHAINED_EXPANDERS;
+
+        // the frame this block was produced in; a block that's not from the previous frame is stale
+        // (e.g. the expander that produces it is bypassed) and is ignored
+        int64_t frame;
+
+        // current status of the inputs for each track (are any inputs connected?) on this expander or
+        // any further along the chain
         bool active[NUM_TRACKS];
 
-        // a vector of new midi messages since last flip per track
-        std::vector<smf::MidiMessage> msgs[NUM_TRACKS];
+        // the new controller messages since last flip per track.  Fixed size, so building the
+        // message never allocates on the audio thread.
+        int numMsgs[NUM_TRACKS];
+        ControllerRecord msgs[NUM_TRACKS][MAX_MSGS];
+        // messages that didn't fit, here or anywhere further along the chain
+        int droppedMsgs[NUM_TRACKS];
+        // unused events of the sampling budget, on their way back to the master
+        int returnedGrant;
 
         ExpanderToMasterMessage()
         {
-            // preallocate the vectors so we're not triggering an alloc in the audio thread.
-            // Technically, we only need room for 1 message per track since the CC's are rate limited to no
-            // more than one message per frame (and in practice many fewer than that due to the
-            // rateLimiter timer)  - and the master consumes the messages every frame even though the
-            // expanders don't produce them every frame.
-            //
-            // But preallocate extras "just in case" the master doesn't consume the vectors as expected.
-            // It's only few bytes of overhead.
+            frame = -1;
+            returnedGrant = 0;
             for (int t = 0; t < NUM_TRACKS; t++) {
-                msgs[t].reserve(3);
+                active[t] = false;
+                numMsgs[t] = 0;
+                droppedMsgs[t] = 0;
             }
         }
+
+        void clear(const int track)
+        {
+            numMsgs[track] = 0;
+            droppedMsgs[track] = 0;
+        }
+
+        void addController(const int track, const int cc, const int value)
+        {
+            if (numMsgs[track] < MAX_MSGS) {
+                ControllerRecord& r = msgs[track][numMsgs[track]++];
+                r.status = 0xb0;
+                r.cc = cc;
+                r.value = value;
+            } else {
+                droppedMsgs[track]++;
+            }
+        }
+
+        void append(const ExpanderToMasterMessage& other, const int track)
+        {
+            int n = std::min(other.numMsgs[track], MAX_MSGS - numMsgs[track]);
+            for (int i = 0; i < n; i++) {
+                msgs[track][numMsgs[track]++] = other.msgs[track][i];
+            }
+            droppedMsgs[track] += other.droppedMsgs[track] + other.numMsgs[track] - n;
+        }
+
+        bool isFresh(const int64_t currentFrame) const
+        {
+            return frame + 1 == currentFrame;
+        }
     };
+    static_assert(std::is_trivially_copyable<ExpanderToMasterMessage>::value, "expander messages must be plain data");
 
     // the grid of track inputs must be in one continuous sequence, starting with
     // FIRST_INPUT_ID, incrementing across columns, and then down tracks.
@@ -47,6 +128,12 @@ namespace MIDIRecorder {
 
         dsp::Timer rateLimiterTimer;
         bool rateLimiterTriggered = false;
+        // the first track processed this frame; it rotates so that when the sampling budget runs
+        // short, it's not always the same tracks that go without
+        int firstTrack = 0;
+
+        // persisted state:
+        SamplingConfig sampling;
 
         void processRateLimiter(const ProcessArgs& args)
         {
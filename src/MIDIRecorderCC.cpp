@@ -1,15 +1,33 @@
 #include "CVRange.hpp"
 #include "MIDIRecorderBase.hpp"
 #include "Style.hpp"
+#include "TextDisplay.hpp"
 #include "plugin.hpp"
 
 namespace Chinenual {
 namespace MIDIRecorder {
 
+    // deadband choices presented in the context menu, in steps of the (7 or 14bit) CC value:
+    static const float DEADBAND_STEPS[] = { 0.f, 0.5f, 1.f, 2.f, 4.f, 16.f };
+    static const std::vector<std::string> DEADBAND_NAMES = {
+        "Off", "1/2 step", "1 step", "2 steps", "4 steps", "16 steps"
+    };
+    // max rate choices presented in the context menu:
+    static const int MAX_RATES[] = { 200, 100, 50, 20, 10 };
+    static const std::vector<std::string> MAX_RATE_NAMES = {
+        "200 Hz", "100 Hz", "50 Hz", "20 Hz", "10 Hz"
+    };
+
     struct CCConfig {
         int cc;
         bool is14bit;
         CVRangeIndex range;
+        // only send a value when it differs from the last one sent
+        bool onlyOnChange = true;
+        // how far past a value boundary the input must move to count as a change
+        float deadband = 0.f;
+        // messages per second
+        int maxRate = 200;
 
         CCConfig(const int cc, const bool is14bit, CVRangeIndex range)
             : cc(cc)
@@ -19,9 +37,11 @@ namespace MIDIRecorder {
         }
     };
 
-    struct MIDIRecorderCC : MIDIRecorderBase<5> {
+    struct MIDIRecorderCC : MIDIRecorderBase<CC_COLS_PER_TRACK> {
         ExpanderToMasterMessage expanderToMasterMessage_a;
         ExpanderToMasterMessage expanderToMasterMessage_b;
+        MasterToExpanderMessage masterToExpanderMessage_a;
+        MasterToExpanderMessage masterToExpanderMessage_b;
 
         enum ParamId {
             STYLE_PARAM,
@@ -97,11 +117,23 @@ namespace MIDIRecorder {
             CCConfig(6, false, CV_RANGE_0_10),
         };
 
+        // per-input emission state:
+        ChangeFilter changeFilters[NUM_TRACKS][COLS_PER_TRACK];
+        int lastMsb[NUM_TRACKS][COLS_PER_TRACK];
+        double lastSendTime[NUM_TRACKS][COLS_PER_TRACK];
+        AdaptiveSampler samplers[NUM_TRACKS][COLS_PER_TRACK];
+        // the part of the recorder's sampling budget granted to us (and those to our right) this frame
+        EventBudget samplingGrant;
+        double time = 0.0;
+        int take = -1;
+
         MIDIRecorderCC()
             : MIDIRecorderBase(T1_CC_1_INPUT)
         {
             leftExpander.consumerMessage = &expanderToMasterMessage_a;
             leftExpander.producerMessage = &expanderToMasterMessage_b;
+            rightExpander.consumerMessage = &masterToExpanderMessage_a;
+            rightExpander.producerMessage = &masterToExpanderMessage_b;
 
             onReset();
 
@@ -124,6 +156,24 @@ namespace MIDIRecorder {
                 ccConfig[i].cc = 2 + i;
                 ccConfig[i].is14bit = false;
                 ccConfig[i].range = CV_RANGE_0_10;
+                ccConfig[i].onlyOnChange = true;
+                ccConfig[i].deadband = 0.f;
+                ccConfig[i].maxRate = 200;
+            }
+            sampling = SamplingConfig();
+            resetChangeFilters();
+        }
+
+        // forget what's been sent, so that every input sends its current value
+        void resetChangeFilters()
+        {
+            for (int t = 0; t < NUM_TRACKS; t++) {
+                for (int i = 0; i < COLS_PER_TRACK; i++) {
+                    changeFilters[t][i].reset();
+                    lastMsb[t][i] = -1;
+                    lastSendTime[t][i] = -1.0;
+                    samplers[t][i].reset();
+                }
             }
         }
 
@@ -138,15 +188,21 @@ namespace MIDIRecorder {
                 json_object_set_new(ccConfigJ, "cc", json_integer(ccConfig[i].cc));
                 json_object_set_new(ccConfigJ, "range",
                     json_integer(ccConfig[i].range));
+                json_object_set_new(ccConfigJ, "onlyOnChange",
+                    json_boolean(ccConfig[i].onlyOnChange));
+                json_object_set_new(ccConfigJ, "deadband", json_real(ccConfig[i].deadband));
+                json_object_set_new(ccConfigJ, "maxRate", json_integer(ccConfig[i].maxRate));
                 json_array_append_new(ccConfig_arrayJ, ccConfigJ);
             }
             json_object_set_new(rootJ, "ccConfig", ccConfig_arrayJ);
+            sampling.toJson(rootJ);
 
             return rootJ;
         }
 
         void dataFromJson(json_t* rootJ) override
         {
+            sampling.fromJson(rootJ);
             json_t* ccConfig_arrayJ = json_object_get(rootJ, "ccConfig");
             if (ccConfig_arrayJ) {
                 size_t i;
@@ -165,6 +221,18 @@ namespace MIDIRecorder {
                     if (rangeJ) {
                         ccConfig[i].range = (CVRangeIndex)json_integer_value(rangeJ);
                     }
+                    json_t* onlyOnChangeJ = json_object_get(eleJ, "onlyOnChange");
+                    if (onlyOnChangeJ) {
+                        ccConfig[i].onlyOnChange = json_boolean_value(onlyOnChangeJ);
+                    }
+                    json_t* deadbandJ = json_object_get(eleJ, "deadband");
+                    if (deadbandJ) {
+                        ccConfig[i].deadband = json_number_value(deadbandJ);
+                    }
+                    json_t* maxRateJ = json_object_get(eleJ, "maxRate");
+                    if (maxRateJ) {
+                        ccConfig[i].maxRate = json_integer_value(maxRateJ);
+                    }
                 }
             }
         }
@@ -176,25 +244,67 @@ namespace MIDIRecorder {
             const auto COL0_INPUT = FIRST_INPUT_ID + track * COLS_PER_TRACK;
             for (int i = 0; i < COLS_PER_TRACK; i++) {
                 int inputId = COL0_INPUT + i;
-                if (inputs[inputId].isConnected()) {
+                if (inputs[inputId].isConnected() && sampling.adaptive) {
+                    const CCConfig& config = ccConfig[i];
                     float v = inputs[inputId].getVoltage();
-                    if (ccConfig[i].is14bit) {
-                        int val = CVRanges[ccConfig[i].range].to14bit(v);
+                    AdaptiveSampler& sampler = samplers[track][i];
+                    if (config.is14bit) {
+                        float scaled = CVRanges[config.range].scale14bit(v);
+                        if (sampler.process(args.sampleTime, scaled, sampling, SAMPLING_ERROR_14BIT) && samplingGrant.take()) {
+                            sampler.sent(scaled);
+                            int msb, lsb;
+                            CVRanges[config.range].split14bit((int)std::round(scaled), msb, lsb);
+                            if (msb != lastMsb[track][i]) {
+                                expanderMsg->addController(track, config.cc, msb);
+                                lastMsb[track][i] = msb;
+                            }
+                            if (config.cc + 32 <= 127) {
+                                // silently ignore attempt to write invalid CCnumber
+                                expanderMsg->addController(track, config.cc + 32, lsb);
+                            }
+                        }
+                    } else {
+                        float scaled = CVRanges[config.range].scale7bit(v);
+                        if (sampler.process(args.sampleTime, scaled, sampling, SAMPLING_ERROR_7BIT) && samplingGrant.take()) {
+                            sampler.sent(scaled);
+                            expanderMsg->addController(track, config.cc, (int)std::round(scaled));
+                        }
+                    }
+                } else if (inputs[inputId].isConnected()) {
+                    const CCConfig& config = ccConfig[i];
+                    // allow for the rate limiter firing up to a sample early:
+                    if (time - lastSendTime[track][i] + args.sampleTime < 1.0 / config.maxRate) {
+                        continue;
+                    }
+                    float v = inputs[inputId].getVoltage();
+                    float scaled = config.is14bit ? CVRanges[config.range].scale14bit(v) : CVRanges[config.range].scale7bit(v);
+                    int val;
+                    if (config.onlyOnChange) {
+                        ChangeFilter& filter = changeFilters[track][i];
+                        filter.deadband = config.deadband;
+                        filter.max = config.is14bit ? 16383 : 127;
+                        if (!filter.process(scaled, val)) {
+                            continue;
+                        }
+                    } else {
+                        val = (int)std::round(scaled);
+                    }
+                    lastSendTime[track][i] = time;
+                    if (config.is14bit) {
                         int msb, lsb;
-                        CVRanges[ccConfig[i].range].split14bit(val, msb, lsb);
-                        smf::MidiMessage ccMsg_1, ccMsg_2;
-                        ccMsg_1.makeController(0, ccConfig[i].cc, msb);
-                        expanderMsg->msgs[track].push_back(ccMsg_1);
-                        if (ccConfig[i].cc + 32 <= 127) {
+                        CVRanges[config.range].split14bit(val, msb, lsb);
+                        // a receiver keeps the LSB until the next MSB, so an unchanged MSB need not be
+                        // resent
+                        if (!config.onlyOnChange || msb != lastMsb[track][i]) {
+                            expanderMsg->addController(track, config.cc, msb);
+                            lastMsb[track][i] = msb;
+                        }
+                        if (config.cc + 32 <= 127) {
                             // silently ignore attempt to write invalid CCnumber
-                            ccMsg_2.makeController(0, ccConfig[i].cc + 32, lsb);
-                            expanderMsg->msgs[track].push_back(ccMsg_2);
+                            expanderMsg->addController(track, config.cc + 32, lsb);
                         }
                     } else {
-                        int val = CVRanges[ccConfig[i].range].to7bit(v);
-                        smf::MidiMessage ccMsg;
-                        ccMsg.makeController(0, ccConfig[i].cc, val);
-                        expanderMsg->msgs[track].push_back(ccMsg);
+                        expanderMsg->addController(track, config.cc, val);
                     }
                 }
             }
@@ -203,39 +313,80 @@ namespace MIDIRecorder {
         void process(const ProcessArgs& args) override
         {
             MIDIRecorderBase::process(args);
-            // are we connected to a master module (possibly with other expanders in between?)
+            time += args.sampleTime;
+            // are we connected to a master module (possibly with other expanders in between?)  The
+            // master's status is passed along by our left neighbour.
             bool connected = false;
-            Module* m = this;
-            Module* master = 0;
-            while (m) {
-                if (m->model == modelMIDIRecorder) {
-                    connected = true;
-                    master = m;
-                    break;
+            bool isRecording = false;
+            int masterTake = take;
+            samplingGrant.tokens = 0.f;
+            Module* left = leftExpander.module;
+            if (left && (left->model == modelMIDIRecorder || left->model == modelMIDIRecorderCC)) {
+                auto consumerMessage = (MasterToExpanderMessage*)left->rightExpander.consumerMessage;
+                connected = consumerMessage->connected;
+                isRecording = consumerMessage->isRecording;
+                masterTake = consumerMessage->take;
+                // a stale message (e.g. our left neighbour is bypassed) must not grant the same
+                // events again
+                if (consumerMessage->isFresh(args.frame)) {
+                    samplingGrant.tokens = consumerMessage->samplingGrant;
+                    firstTrack = consumerMessage->firstTrack;
                 }
-                if (m->model != modelMIDIRecorderCC) {
-                    break;
-                }
-                m = m->leftExpander.module;
+            }
+            Module* right = rightExpander.module;
+            const bool hasExpander = right && right->model == modelMIDIRecorderCC;
+            if (masterTake != take) {
+                // a new file - it needs every input's current value
+                take = masterTake;
+                resetChangeFilters();
             }
             if (connected) {
-                auto consumerMessage = (MasterToExpanderMessage*)master->rightExpander.consumerMessage;
+                // merge the messages from the expanders to our right (already merged by our right
+                // neighbour) with our own
+                const ExpanderToMasterMessage* rightMessage = 0;
+                if (hasExpander) {
+                    rightMessage = (ExpanderToMasterMessage*)right->leftExpander.consumerMessage;
+                    if (!rightMessage->isFresh(args.frame)) {
+                        rightMessage = 0;
+                    }
+                }
                 auto producerMessage = (ExpanderToMasterMessage*)leftExpander.producerMessage;
-                if (consumerMessage->isRecording) {
-                    for (int t = 0; t < NUM_TRACKS; t++) {
-                        producerMessage->msgs[t].clear();
-                        producerMessage->active[t] = trackIsActive(t);
-                        if (rateLimiterTriggered && trackIsActive(t)) {
+                producerMessage->frame = args.frame;
+                for (int i = 0; i < NUM_TRACKS; i++) {
+                    const int t = (firstTrack + i) % NUM_TRACKS;
+                    producerMessage->clear(t);
+                    producerMessage->active[t] = trackIsActive(t) || (rightMessage && rightMessage->active[t]);
+                    if (isRecording) {
+                        if (rightMessage) {
+                            producerMessage->append(*rightMessage, t);
+                        }
+                        // adaptive sampling decides for itself, every frame, which inputs to sample
+                        if ((rateLimiterTriggered || sampling.adaptive) && trackIsActive(t)) {
                             processMidiTrack(t, args);
                         }
+                    }
 #if 0
-                        if (producerMessage->msgs[t].size() > 0) {
-                            INFO("TRACK %d %lu msgs", t, producerMessage->msgs[t].size());
-                        }
-#endif
+                    if (producerMessage->numMsgs[t] > 0) {
+                        INFO("TRACK %d %d msgs", t, producerMessage->numMsgs[t]);
                     }
-                    leftExpander.requestMessageFlip();
+#endif
                 }
+                // what's left of the grant goes on to the expanders to our right, or - if we're the
+                // last - back to the recorder, along with whatever they've returned
+                producerMessage->returnedGrant = (rightMessage ? rightMessage->returnedGrant : 0)
+                    + (hasExpander ? 0 : (int)samplingGrant.tokens);
+                leftExpander.requestMessageFlip();
+            }
+            {
+                // pass it on to the expanders to our right
+                auto producerMessage = (MasterToExpanderMessage*)rightExpander.producerMessage;
+                producerMessage->frame = args.frame;
+                producerMessage->connected = connected;
+                producerMessage->isRecording = isRecording;
+                producerMessage->take = take;
+                producerMessage->samplingGrant = hasExpander ? (int)samplingGrant.tokens : 0;
+                producerMessage->firstTrack = firstTrack;
+                rightExpander.requestMessageFlip();
             }
         }
     };
@@ -279,45 +430,28 @@ namespace MIDIRecorder {
         };
     };
 
-    struct CCDisplayWidget : TransparentWidget {
-        std::shared_ptr<Font> font;
-        std::string fontPath;
+    struct CCDisplayWidget : TextDisplay {
         char displayStr[16];
         CCConfig* ccConfigPtr;
         MIDIRecorderCC* module;
 
         CCDisplayWidget(MIDIRecorderCC* m, CCConfig* ccConfig)
+            : TextDisplay(asset::plugin(pluginInstance, "res/fonts/DSEG14Modern-BoldItalic.ttf"), 11.0, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, 40.0)
         {
             module = m;
             ccConfigPtr = ccConfig;
-            fontPath = std::string(
-                asset::plugin(pluginInstance, "res/fonts/DSEG14Modern-BoldItalic.ttf"));
         }
 
-        void drawLayer(const DrawArgs& args, int layer) override
+        void step() override
         {
-            if (layer == 1) {
-                NVGcolor ledTextColor = Style::getNVGColor(module ? (Style::Color)module->params[MIDIRecorderCC::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR);
-
-                if (!(font = APP->window->loadFont(fontPath))) {
-                    return;
-                }
-                nvgFontSize(args.vg, 11.0);
-                nvgFontFaceId(args.vg, font->handle);
-
-                Vec textPos = Vec(6, 24);
-
-                nvgFillColor(args.vg, ledTextColor);
-
-                if (!ccConfigPtr) {
-                    snprintf(displayStr, 16, "---");
-                } else {
-                    snprintf(displayStr, 16, "%3u", ccConfigPtr->cc);
-                }
-                nvgTextAlign(args.vg, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM);
-
-                nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
+            setColor(Style::getNVGColor(module ? (Style::Color)module->params[MIDIRecorderCC::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR));
+            if (!ccConfigPtr) {
+                snprintf(displayStr, 16, "---");
+            } else {
+                snprintf(displayStr, 16, "%3u", ccConfigPtr->cc);
             }
+            setText(displayStr);
+            TextDisplay::step();
         }
     };
 
@@ -381,6 +515,35 @@ namespace MIDIRecorder {
                             "14bit", "", [=]() { return module->ccConfig[i].is14bit; },
                             [=](bool val) { module->ccConfig[i].is14bit = val; }));
 
+                        menu->addChild(createBoolPtrMenuItem("Send only on change", "",
+                            &module->ccConfig[i].onlyOnChange));
+
+                        menu->addChild(createIndexSubmenuItem(
+                            "Deadband", DEADBAND_NAMES,
+                            [=]() {
+                                for (size_t j = 0; j < DEADBAND_NAMES.size(); j++) {
+                                    if (DEADBAND_STEPS[j] == module->ccConfig[i].deadband)
+                                        return j;
+                                }
+                                return (size_t)0;
+                            },
+                            [=](int val) {
+                                module->ccConfig[i].deadband = DEADBAND_STEPS[val];
+                            }));
+
+                        menu->addChild(createIndexSubmenuItem(
+                            "Max rate", MAX_RATE_NAMES,
+                            [=]() {
+                                for (size_t j = 0; j < MAX_RATE_NAMES.size(); j++) {
+                                    if (MAX_RATES[j] == module->ccConfig[i].maxRate)
+                                        return j;
+                                }
+                                return (size_t)0;
+                            },
+                            [=](int val) {
+                                module->ccConfig[i].maxRate = MAX_RATES[val];
+                            }));
+
                         {
                             // adapted from Voxglitch's DigitalSequencerXP:
                             // Add label input
@@ -405,6 +568,8 @@ namespace MIDIRecorder {
                         }
                     }));
             }
+            appendSamplingMenu(menu, &module->sampling, false);
+
             STYLE_MENUS(MIDIRecorderCC::STYLE_PARAM);
         }
     };
@@ -0,0 +1,62 @@
+#pragma once
+#include <rack.hpp>
+
+namespace Chinenual {
+
+// Channel layout of the Mix output of Tint and Inv: the melody and the harmony (or inversion)
+// voices merged into one polyphonic cable.  Two voices per melody channel don't fit in
+// PORT_MAX_CHANNELS beyond 8 melody voices, so the layout is capped at PORT_MAX_CHANNELS and the
+// voices that don't fit are left out (the module's own harmony output always has every voice).
+//
+// The mapping only depends on the number of melody channels and the mode, so it's rebuilt when
+// either changes rather than recomputed every sample.
+
+enum MixMode {
+    // melody 1, harmony 1, melody 2, harmony 2 ...: the first 8 melody voices and their harmonies
+    MIX_INTERLEAVED,
+    // melody 1..N, then harmony 1..N, cut off at 16 channels
+    MIX_CONCATENATED
+};
+static const std::vector<std::string> MixModeNames = {
+    "Interleaved",
+    "Concatenated",
+};
+
+struct MixMap {
+    MixMode mode = MIX_INTERLEAVED;
+    int inputChannels = -1;
+    int numChannels = 0;
+    // for each Mix output channel: the voice it copies, and whether it's the harmony voice
+    int voice[rack::PORT_MAX_CHANNELS];
+    bool harmony[rack::PORT_MAX_CHANNELS];
+
+    /* rebuild the mapping if the number of melody channels or the mode has changed */
+    void update(int channels, MixMode newMode)
+    {
+        if (channels == inputChannels && newMode == mode) {
+            return;
+        }
+        inputChannels = channels;
+        mode = newMode;
+        numChannels = std::min(2 * channels, rack::PORT_MAX_CHANNELS);
+        for (int m = 0; m < numChannels; m++) {
+            if (mode == MIX_CONCATENATED) {
+                voice[m] = m < channels ? m : m - channels;
+                harmony[m] = m >= channels;
+            } else {
+                voice[m] = m / 2;
+                harmony[m] = m % 2;
+            }
+        }
+    }
+
+    void process(rack::engine::Output& output, const float* melody_v, const float* harmony_v)
+    {
+        for (int m = 0; m < numChannels; m++) {
+            output.setVoltage(harmony[m] ? harmony_v[voice[m]] : melody_v[voice[m]], m);
+        }
+        output.setChannels(numChannels);
+    }
+};
+
+} // namespace Chinenual
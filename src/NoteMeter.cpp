@@ -1,7 +1,12 @@
 #include <osdialog.h>
 
+#include "DisplaySnapshot.hpp"
+#include "NoteMeterDisplay.hpp"
+#include "PitchDetector.hpp"
 #include "PitchNote.hpp"
 #include "Style.hpp"
+#include "TextDisplay.hpp"
+#include "WindowedStatistics.hpp"
 #include "logger.hpp"
 #include "plugin.hpp"
 
@@ -12,19 +17,22 @@
 namespace Chinenual {
 namespace NoteMeter {
 
+    // statistics mode: the inputs are sampled this often (Hz), and the statistics kept over the last
+    // few seconds of them
+    static const int STATISTICS_RATE = 100;
+    static const int STATISTICS_WINDOW_SECONDS[] = { 1, 5, 10, 30 };
+    static const std::vector<std::string> STATISTICS_WINDOW_NAMES = { "1 s", "5 s", "10 s", "30 s" };
+    static const int STATISTICS_CAPACITY = 30 * STATISTICS_RATE;
+
     struct NoteMeter : Module {
-        enum VoltageModeEnum {
-            VOLTAGE_MODE_NOTENAME = 0,
-            VOLTAGE_MODE_VOLTAGE = 1,
-            VOLTAGE_MODE_VOCT_FREQUENCY = 2
-        };
-        const char* modeLabel[3] = { "", "V", "Hz" };
+        const char* modeLabel[6] = { "", "V", "Hz", "", "", "cents" };
 
         enum ParamId {
             NOTE_ACCIDENTAL_PARAM,
             VOLTAGE_MODE_PARAM,
             VOLTAGE_DECIMALS_PARAM,
             STYLE_PARAM,
+            STATISTICS_WINDOW_PARAM,
             PARAMS_LEN
         };
         enum InputId {
@@ -62,134 +70,153 @@ namespace NoteMeter {
                 configInput(i, string::f("Pitch %d", i - PITCH_INPUT_1 + 1));
             }
             configParam(NOTE_ACCIDENTAL_PARAM, 0.f, 1.f, 0.f, "Display notes as sharps or flats");
-            configParam(VOLTAGE_MODE_PARAM, 0.f, 2.f, 0.f, "Display voltage value rather than note name");
+            configParam(VOLTAGE_MODE_PARAM, 0.f, 5.f, 0.f, "Display voltage value rather than note name");
             configParam(VOLTAGE_DECIMALS_PARAM, 0.f, 8.f, 5.f, "Number of decimal places to display in voltage/frequency value");
             CONFIG_STYLE(STYLE_PARAM);
+            configParam(STATISTICS_WINDOW_PARAM, 0.f, 3.f, 1.f, "Statistics window");
         }
 
-        std::string text[NUM_INPUTS];
+        DisplaySnapshot<NoteMeterDisplay> display;
+        // the labels as the engine last saw them; published only when some label's text changes
+        NoteMeterDisplay labels;
+        // tuner mode
+        PitchDetector tuner;
+        // statistics mode
+        WindowedStatistics<STATISTICS_CAPACITY> statistics[NUM_INPUTS];
 
         void onReset() override
         {
         }
 
-        inline float voct_to_hz(float v)
+        /* each label's input voltage; a polyphonic input's channels spill over onto the labels below it */
+        void readLabels(bool active[NUM_INPUTS], float voltage[NUM_INPUTS])
         {
-            return powf(2, v) * 261.625565;
+            for (int i = 0; i < NUM_INPUTS; i++) {
+                int label_i = i;
+                Input& in = inputs[PITCH_INPUT_1 + i];
+                if (in.isConnected()) {
+                    for (int c = 0; c < in.getChannels(); c++) {
+                        active[label_i] = true;
+                        voltage[label_i] = in.getVoltage(c);
+                        label_i++;
+                        if (label_i >= NUM_INPUTS) {
+                            break; // inner loop
+                        }
+                    }
+                }
+            }
         }
 
         void process(const ProcessArgs& args) override
         {
-            if ((args.frame % 100) == 0) { // throttle
+            const int mode = (int)params[VOLTAGE_MODE_PARAM].getValue();
+            if (mode == VOLTAGE_MODE_TUNER) {
+                if (args.sampleRate != tuner.sampleRate) {
+                    tuner.setSampleRate(args.sampleRate);
+                } else if (labels.mode != VOLTAGE_MODE_TUNER) {
+                    // don't detect whatever was left in the buffers the last time
+                    tuner.reset();
+                }
+                bool active[NUM_INPUTS] = {};
+                float audio[NUM_INPUTS] = {};
+                readLabels(active, audio);
                 for (int i = 0; i < NUM_INPUTS; i++) {
-                    text[i] = "";
+                    tuner.active[i] = active[i];
                 }
-                std::string voltagePrintfFormat = "% 2.6f";
-                if (params[VOLTAGE_MODE_PARAM].getValue() != VOLTAGE_MODE_NOTENAME) {
-                    // recompute the printformat to match the current param value
-                    char buff[40];
-                    std::snprintf(buff, sizeof(buff), "%% 2.%df", (int)params[VOLTAGE_DECIMALS_PARAM].getValue());
-                    voltagePrintfFormat = buff;
+                tuner.process(audio);
+            } else if (mode == VOLTAGE_MODE_STATISTICS) {
+                if (labels.mode != VOLTAGE_MODE_STATISTICS) {
+                    // start over
+                    for (int i = 0; i < NUM_INPUTS; i++) {
+                        statistics[i].clear();
+                    }
                 }
-
-                for (int i = 0; i < NUM_INPUTS; i++) {
-                    int label_i = i;
-                    auto in = inputs[PITCH_INPUT_1 + i];
-                    if (in.isConnected()) {
-                        for (int c = 0; c < in.getChannels(); c++) {
-                            if (params[VOLTAGE_MODE_PARAM].getValue() == VOLTAGE_MODE_VOLTAGE) {
-                                char buff[40];
-                                std::snprintf(buff, sizeof(buff), voltagePrintfFormat.c_str(), in.getVoltage(c));
-                                text[label_i] = buff;
-                            } else if (params[VOLTAGE_MODE_PARAM].getValue() == VOLTAGE_MODE_VOCT_FREQUENCY) {
-                                char buff[40];
-                                std::snprintf(buff, sizeof(buff), voltagePrintfFormat.c_str(), voct_to_hz(in.getVoltage(c)));
-                                text[label_i] = buff;
-                            } else {
-                                // we assume inputs are in +/-10V
-                                auto in_v = clamp(in.getVoltage(c), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
-                                auto n = voltageToPitch(in_v);
-                                auto fn = voltageToMicroPitch(in_v);
-                                pitchToText(text[label_i], n, fn - ((float)n), (Chinenual::NoteAccidental)(params[NOTE_ACCIDENTAL_PARAM].getValue()));
-                            }
-                            label_i++;
-                            if (label_i >= NUM_INPUTS) {
-                                // INFO("  EARLY RETURN[%d]   i = %d   channels = %d\n", label_i, i, in.getChannels());
-                                break; // inner loop
-                            }
+                const int divider = std::max(1, (int)std::round(args.sampleRate / STATISTICS_RATE));
+                if ((args.frame % divider) == 0) {
+                    const int window = STATISTICS_WINDOW_SECONDS[(int)params[STATISTICS_WINDOW_PARAM].getValue()] * STATISTICS_RATE;
+                    bool active[NUM_INPUTS] = {};
+                    float voltage[NUM_INPUTS] = {};
+                    readLabels(active, voltage);
+                    for (int i = 0; i < NUM_INPUTS; i++) {
+                        statistics[i].setWindow(window);
+                        if (!active[i]) {
+                            statistics[i].clear();
+                        } else {
+                            statistics[i].add(voltageToMicroPitch(clamp(voltage[i], PITCH_VOCT_MIN, PITCH_VOCT_MAX)));
                         }
                     }
                 }
             }
+            if ((args.frame % 100) == 0 || mode != labels.mode) { // throttle
+                bool changed = labels.setFormat(mode,
+                    (int)params[VOLTAGE_DECIMALS_PARAM].getValue(),
+                    (int)params[NOTE_ACCIDENTAL_PARAM].getValue());
+                bool active[NUM_INPUTS] = {};
+                float voltage[NUM_INPUTS] = {};
+                readLabels(active, voltage);
+                if (mode == VOLTAGE_MODE_TUNER) {
+                    for (int i = 0; i < NUM_INPUTS; i++) {
+                        voltage[i] = tuner.pitchVoltage(i);
+                    }
+                }
+                if (mode == VOLTAGE_MODE_STATISTICS) {
+                    for (int i = 0; i < NUM_INPUTS; i++) {
+                        const WindowedStatistics<STATISTICS_CAPACITY>& s = statistics[i];
+                        changed |= labels.setStatistics(i, active[i] && s.count > 0,
+                            s.mean, s.standardDeviation(), s.min(), s.max());
+                    }
+                } else {
+                    for (int i = 0; i < NUM_INPUTS; i++) {
+                        changed |= labels.setLabel(i, active[i], voltage[i]);
+                    }
+                }
+                if (changed) {
+                    labels.updateChord();
+                    display.write() = labels;
+                    display.publish();
+                }
+            }
         }
     };
 
-    struct ModeLabelDisplayWidget : TransparentWidget {
-        std::shared_ptr<Font> font;
-        std::string fontPath;
-        char displayStr[16];
+    struct ModeLabelDisplayWidget : TextDisplay {
+        const char* chordText;
         NoteMeter* module;
 
-        ModeLabelDisplayWidget(NoteMeter* m)
+        ModeLabelDisplayWidget(NoteMeter* m, const char* chordText)
+            : TextDisplay(asset::plugin(pluginInstance, "res/fonts/opensans/OpenSans-Regular.ttf"), 15.0, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM, 110.0)
         {
             module = m;
-            fontPath = std::string(
-                asset::plugin(pluginInstance, "res/fonts/opensans/OpenSans-Regular.ttf"));
+            this->chordText = chordText;
+            setColor(nvgRGB(0xff, 0xd4, 0x56)); // yellow
         }
 
-        void drawLayer(const DrawArgs& args, int layer) override
+        void step() override
         {
-            NVGcolor labelTextColor = nvgRGB(0xff, 0xd4, 0x56); // yellow
-
-            if (layer == 1) {
-                if (!(font = APP->window->loadFont(fontPath))) {
-                    return;
-                }
-                nvgFontSize(args.vg, 15.0);
-                nvgFontFaceId(args.vg, font->handle);
-
-                Vec textPos = Vec(6, 24);
-
-                nvgFillColor(args.vg, labelTextColor);
-
-                nvgTextAlign(args.vg, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM);
-                nvgText(args.vg, textPos.x, textPos.y, module ? module->modeLabel[(int)(module->params[NoteMeter::VOLTAGE_MODE_PARAM].getValue())] : "", NULL);
-            }
+            int mode = module ? (int)(module->params[NoteMeter::VOLTAGE_MODE_PARAM].getValue()) : 0;
+            // in chord mode, the chord name takes the place of the units
+            setText(mode == VOLTAGE_MODE_CHORD ? chordText : module ? module->modeLabel[mode] : "");
+            TextDisplay::step();
         }
     };
-    struct NoteDisplayWidget : TransparentWidget {
-        std::shared_ptr<Font> font;
-        std::string fontPath;
-        char displayStr[16];
-        std::string* text;
+    struct NoteDisplayWidget : TextDisplay {
+        const char* text;
         NoteMeter* module;
 
-        NoteDisplayWidget(NoteMeter* m, std::string* t)
+        NoteDisplayWidget(NoteMeter* m, const char* t)
+            : TextDisplay(asset::plugin(pluginInstance, "res/fonts/opensans/OpenSans-Regular.ttf"), 18.0, NVG_ALIGN_LEFT | NVG_ALIGN_BOTTOM, 160.0)
         {
             text = t;
             module = m;
-            fontPath = std::string(
-                asset::plugin(pluginInstance, "res/fonts/opensans/OpenSans-Regular.ttf"));
         }
 
-        void drawLayer(const DrawArgs& args, int layer) override
+        void step() override
         {
-            NVGcolor ledTextColor = Style::getNVGColor(module ? (Style::Color)module->params[NoteMeter::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR);
-
-            if (layer == 1) {
-                if (!(font = APP->window->loadFont(fontPath))) {
-                    return;
-                }
-                nvgFontSize(args.vg, 18.0);
-                nvgFontFaceId(args.vg, font->handle);
-
-                Vec textPos = Vec(6, 24);
-
-                nvgFillColor(args.vg, ledTextColor);
-
-                nvgTextAlign(args.vg, NVG_ALIGN_LEFT | NVG_ALIGN_BOTTOM);
-                nvgText(args.vg, textPos.x, textPos.y, text ? text->c_str() : "", NULL);
-            }
+            setColor(Style::getNVGColor(module ? (Style::Color)module->params[NoteMeter::STYLE_PARAM].getValue() : Style::DEFAULT_COLOR));
+            // two smaller lines of statistics
+            setFontSize(module && module->params[NoteMeter::VOLTAGE_MODE_PARAM].getValue() == VOLTAGE_MODE_STATISTICS ? 11.0 : 18.0);
+            setText(text ? text : "");
+            TextDisplay::step();
         }
     };
 
@@ -216,6 +243,11 @@ namespace NoteMeter {
 #define LED_OFFSET_Y -5.5
 
     struct NoteMeterWidget : ModuleWidget {
+        char text[NUM_INPUTS][LABEL_TEXT_SIZE] = {};
+        char chordText[CHORD_TEXT_SIZE] = {};
+        // the labels as last rendered into text[]
+        NoteMeterDisplay rendered;
+
         NoteMeterWidget(NoteMeter* module)
         {
             setModule(module);
@@ -229,7 +261,7 @@ namespace NoteMeter {
             addChild(createWidget<ScrewBlack>(Vec(box.size.x - 2 * RACK_GRID_WIDTH,
                 RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
-            auto modeDisplay = new ModeLabelDisplayWidget(module);
+            auto modeDisplay = new ModeLabelDisplayWidget(module, chordText);
             modeDisplay->box.size = Vec(30, 10);
             modeDisplay->box.pos = mm2px(Vec(MODE_X, MODE_Y));
             addChild(modeDisplay);
@@ -243,13 +275,35 @@ namespace NoteMeter {
                     addInput(createInputCentered<PJ301MPort>(
                         mm2px(Vec(x, y)), module, in));
 
-                    auto noteDisplay = new NoteDisplayWidget(module, module ? &module->text[row] : NULL);
+                    auto noteDisplay = new NoteDisplayWidget(module, module ? text[row] : NULL);
                     noteDisplay->box.size = Vec(30, 10);
                     noteDisplay->box.pos = mm2px(Vec(x + LED_OFFSET_X, y + LED_OFFSET_Y));
                     addChild(noteDisplay);
                 }
             }
         }
+
+        void step() override
+        {
+            NoteMeter* module = dynamic_cast<NoteMeter*>(this->module);
+            // format the text here on the UI thread, only when the engine has published new values:
+            if (module && module->display.update()) {
+                const NoteMeterDisplay& d = module->display.read();
+                // only the labels whose text has changed:
+                const uint32_t dirty = d.changedLabels(rendered);
+                for (int i = 0; i < NUM_INPUTS; i++) {
+                    if (dirty & (1u << i)) {
+                        d.formatLabel(text[i], sizeof(text[i]), i);
+                    }
+                }
+                if (d.chord != rendered.chord || !d.sameFormat(rendered)) {
+                    d.formatChord(chordText, sizeof(chordText));
+                }
+                rendered = d;
+            }
+            ModuleWidget::step();
+        }
+
         void appendContextMenu(Menu* menu) override
         {
             NoteMeter* module = dynamic_cast<NoteMeter*>(this->module);
@@ -267,6 +321,9 @@ namespace NoteMeter {
                     "Note Name",
                     "Voltage (V)",
                     "V/Oct as Frequency (Hz)",
+                    "Note Name and Chord",
+                    "Tuner (audio inputs)",
+                    "Pitch Statistics (cents)",
                 },
                 [=]() { return module->params[NoteMeter::VOLTAGE_MODE_PARAM].getValue(); },
                 [=](int val) {
@@ -293,6 +350,12 @@ namespace NoteMeter {
                     module->params[NoteMeter::VOLTAGE_DECIMALS_PARAM].setValue((int)val);
                     module->onReset();
                 }));
+            menu->addChild(createIndexSubmenuItem(
+                "Statistics window", STATISTICS_WINDOW_NAMES,
+                [=]() { return module->params[NoteMeter::STATISTICS_WINDOW_PARAM].getValue(); },
+                [=](int val) {
+                    module->params[NoteMeter::STATISTICS_WINDOW_PARAM].setValue((int)val);
+                }));
             STYLE_MENUS(NoteMeter::STYLE_PARAM);
         }
     };
@@ -0,0 +1,244 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "ChordName.hpp"
+#include "PitchNote.hpp"
+
+namespace Chinenual {
+namespace NoteMeter {
+
+    static const int NUM_LABELS = 16;
+
+    // longest label: the two lines of statistics, a note name with cents, or a voltage/frequency with
+    // the most decimals
+    static const int LABEL_TEXT_SIZE = 64;
+
+    enum VoltageModeEnum {
+        VOLTAGE_MODE_NOTENAME = 0,
+        VOLTAGE_MODE_VOLTAGE = 1,
+        VOLTAGE_MODE_VOCT_FREQUENCY = 2,
+        // note names, plus the name of the chord they make
+        VOLTAGE_MODE_CHORD = 3,
+        // the inputs are audio: note names of their detected pitches (NaN: no pitch)
+        VOLTAGE_MODE_TUNER = 4,
+        // running statistics of each input's pitch, in cents
+        VOLTAGE_MODE_STATISTICS = 5
+    };
+
+    // statistics mode: each label's nearest note to the mean, then the mean, standard deviation, min
+    // and max in tenths of a cent (relative to that note, but for the standard deviation)
+    enum StatisticId {
+        STATISTIC_NOTE,
+        STATISTIC_MEAN,
+        STATISTIC_DEVIATION,
+        STATISTIC_MIN,
+        STATISTIC_MAX,
+        NUM_STATISTICS
+    };
+
+    inline float voct_to_hz(float v)
+    {
+        return powf(2, v) * 261.625565;
+    }
+
+    // What the engine thread publishes for the labels; formatted as text on the UI thread.
+    //
+    // Each label carries a key: a number that changes whenever the label's text would, given the
+    // format (mode, decimals, accidentals).  The engine publishes only when some key (or the format)
+    // has changed, and the UI re-renders only the labels whose key differs from what it last drew -
+    // so static pitches cost neither thread more than a compare per label.
+    struct NoteMeterDisplay {
+        int mode = -1;
+        int decimals = 0;
+        int accidental = 0;
+        // a label shows a value only if some input channel is mapped to it
+        bool active[NUM_LABELS] = {};
+        float voltage[NUM_LABELS] = {};
+        int64_t key[NUM_LABELS] = {};
+        int32_t statistics[NUM_LABELS][NUM_STATISTICS] = {};
+        // chord mode: the labels' pitch class mask | the bass's pitch class << 12; -1 otherwise
+        int32_t chord = -1;
+
+        bool sameFormat(const NoteMeterDisplay& other) const
+        {
+            return mode == other.mode && decimals == other.decimals && accidental == other.accidental;
+        }
+
+        /* the key of voltage v in this display's format: equal keys always format as equal text */
+        int64_t displayKey(float v) const
+        {
+            if (mode == VOLTAGE_MODE_TUNER && std::isnan(v)) {
+                return INT64_MIN;
+            }
+            if (mode == VOLTAGE_MODE_NOTENAME || mode == VOLTAGE_MODE_CHORD || mode == VOLTAGE_MODE_TUNER) {
+                // the same steps as formatLabel() / pitchToText(), down to the whole cents shown
+                const float in_v = rack::clamp(v, PITCH_VOCT_MIN, PITCH_VOCT_MAX);
+                const int note = voltageToPitch(in_v);
+                const float noteDeviation = voltageToMicroPitch(in_v) - ((float)note);
+                const int n = std::round(note + noteDeviation);
+                const float nDeviation = noteDeviation - (n - note);
+                const int cents = (int)(std::abs(nDeviation) * 100);
+                return (int64_t)n * 256 + (nDeviation > 0 ? cents : -cents);
+            }
+            const float value = mode == VOLTAGE_MODE_VOCT_FREQUENCY ? voct_to_hz(v) : v;
+            // printf rounds to even, as nearbyint does in the default rounding mode.  The sign is
+            // part of the key since -0.0 and 0.0 print differently
+            const double x = value * std::pow(10.0, decimals);
+            if (!(std::fabs(x) < 1e18)) {
+                // out of range, infinite or NaN: any change at all re-renders
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                return INT64_MIN + bits;
+            }
+            return (int64_t)std::nearbyint(x) * 2 + (std::signbit(value) ? 1 : 0);
+        }
+
+        /* bit i set for each label that differs between the two displays */
+        uint32_t changedLabels(const NoteMeterDisplay& other) const
+        {
+            if (!sameFormat(other)) {
+                return (1u << NUM_LABELS) - 1;
+            }
+            uint32_t mask = 0;
+            for (int i = 0; i < NUM_LABELS; i++) {
+                if (active[i] != other.active[i] || (active[i] && key[i] != other.key[i])
+                    || (active[i] && mode == VOLTAGE_MODE_STATISTICS && std::memcmp(statistics[i], other.statistics[i], sizeof(statistics[i])) != 0)) {
+                    mask |= 1u << i;
+                }
+            }
+            return mask;
+        }
+
+        /* engine thread: set label i to voltage v (or inactive).  Returns true if its text changes.
+           The key is only recomputed if the voltage has changed */
+        bool setLabel(int i, bool isActive, float v)
+        {
+            if (!isActive) {
+                const bool changed = active[i];
+                active[i] = false;
+                return changed;
+            }
+            if (active[i] && std::memcmp(&voltage[i], &v, sizeof(v)) == 0) {
+                return false;
+            }
+            const int64_t newKey = displayKey(v);
+            const bool changed = !active[i] || newKey != key[i];
+            active[i] = true;
+            voltage[i] = v;
+            key[i] = newKey;
+            return changed;
+        }
+
+        /* engine thread, statistics mode: set label i's statistics (as MIDI note numbers, from
+           voltageToMicroPitch(); the deviation in semitones).  Returns true if its text changes */
+        bool setStatistics(int i, bool isActive, float mean, float deviation, float min, float max)
+        {
+            int32_t s[NUM_STATISTICS] = {};
+            if (isActive) {
+                const int note = (int)std::round(mean);
+                // tenths of a cent, as displayed; clamped to what fits
+                auto tenths = [](float semitones) {
+                    return (int32_t)std::lround(rack::clamp(semitones * 1000.f, -1e8f, 1e8f));
+                };
+                s[STATISTIC_NOTE] = note;
+                s[STATISTIC_MEAN] = tenths(mean - note);
+                s[STATISTIC_DEVIATION] = tenths(deviation);
+                s[STATISTIC_MIN] = tenths(min - note);
+                s[STATISTIC_MAX] = tenths(max - note);
+            }
+            const bool changed = isActive != active[i] || std::memcmp(s, statistics[i], sizeof(s)) != 0;
+            active[i] = isActive;
+            std::memcpy(statistics[i], s, sizeof(s));
+            return changed;
+        }
+
+        /* engine thread: change the format, recomputing every key.  Returns true if it changed */
+        bool setFormat(int newMode, int newDecimals, int newAccidental)
+        {
+            if (newMode == mode && newDecimals == decimals && newAccidental == accidental) {
+                return false;
+            }
+            mode = newMode;
+            decimals = newDecimals;
+            accidental = newAccidental;
+            for (int i = 0; i < NUM_LABELS; i++) {
+                key[i] = displayKey(voltage[i]);
+            }
+            return true;
+        }
+
+        /* engine thread: recompute the chord from the labels.  Returns true if it changed */
+        bool updateChord()
+        {
+            int32_t newChord = -1;
+            if (mode == VOLTAGE_MODE_CHORD) {
+                int mask = 0;
+                int bass = 0;
+                float bassVoltage = INFINITY;
+                for (int i = 0; i < NUM_LABELS; i++) {
+                    if (active[i]) {
+                        // the note as displayed by the label
+                        const float in_v = rack::clamp(voltage[i], PITCH_VOCT_MIN, PITCH_VOCT_MAX);
+                        const int n = std::round(voltageToMicroPitch(in_v));
+                        const int pitchClass = ((n % 12) + 12) % 12;
+                        mask |= 1 << pitchClass;
+                        if (in_v < bassVoltage) {
+                            bassVoltage = in_v;
+                            bass = pitchClass;
+                        }
+                    }
+                }
+                newChord = mask | (bass << 12);
+            }
+            const bool changed = newChord != chord;
+            chord = newChord;
+            return changed;
+        }
+
+        /* format the chord name as text (empty outside chord mode) */
+        void formatChord(char* text, size_t size) const
+        {
+            if (chord < 0) {
+                text[0] = 0;
+                return;
+            }
+            chordToText(text, size, chord & 0xfff, chord >> 12, (Chinenual::NoteAccidental)accidental);
+        }
+
+        /* format label i as text */
+        void formatLabel(char* text, size_t size, int i) const
+        {
+            if (!active[i]) {
+                text[0] = 0;
+                return;
+            }
+            if (mode == VOLTAGE_MODE_STATISTICS) {
+                const int32_t* s = statistics[i];
+                char note[PITCH_TEXT_SIZE];
+                pitchToText(note, sizeof(note), s[STATISTIC_NOTE], 0.f, (Chinenual::NoteAccidental)accidental);
+                // "A4 +3.1c ±0.4" over "-1.2 .. +6.0c"
+                std::snprintf(text, size, "%s %+.1fc \xc2\xb1%.1f\n%+.1f .. %+.1fc", note,
+                    s[STATISTIC_MEAN] / 10.0, s[STATISTIC_DEVIATION] / 10.0, s[STATISTIC_MIN] / 10.0, s[STATISTIC_MAX] / 10.0);
+            } else if (mode == VOLTAGE_MODE_TUNER && std::isnan(voltage[i])) {
+                std::snprintf(text, size, "-");
+            } else if (mode == VOLTAGE_MODE_VOLTAGE || mode == VOLTAGE_MODE_VOCT_FREQUENCY) {
+                float value = voltage[i];
+                if (mode == VOLTAGE_MODE_VOCT_FREQUENCY) {
+                    value = voct_to_hz(value);
+                }
+                std::snprintf(text, size, "% 2.*f", decimals, value);
+            } else {
+                // we assume inputs are in +/-10V
+                auto in_v = rack::clamp(voltage[i], PITCH_VOCT_MIN, PITCH_VOCT_MAX);
+                auto n = voltageToPitch(in_v);
+                auto fn = voltageToMicroPitch(in_v);
+                pitchToText(text, size, n, fn - ((float)n), (Chinenual::NoteAccidental)accidental);
+            }
+        }
+    };
+
+} // namespace NoteMeter
+} // namespace Chinenual
@@ -0,0 +1,289 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <rack.hpp>
+
+namespace Chinenual {
+
+// Detects the pitch of up to 16 audio channels at once, for NoteMeter's tuner mode.
+//
+// Every channel is low-pass filtered and decimated to about 12 kHz (four channels to a float_4)
+// into a ring buffer of the last WINDOW samples.  Every HOP decimated samples, one channel's window
+// is analysed with the McLeod Pitch Method: the normalized square difference function (NSDF) is
+// computed from the window's autocorrelation - by FFT - and the first of its highest peaks gives the
+// period.  The channels take turns, and each analysis is split into slices run on successive
+// decimated samples, so the cost of any one sample is bounded: the decimator plus at most one slice
+// (the largest being a single 2048 point FFT).
+struct PitchDetector {
+    static const int CHANNELS = 16;
+    // decimated samples analysed: two periods of the lowest pitch detected (~23 Hz)
+    static const int WINDOW = 1024;
+    static const int FFT_SIZE = 2 * WINDOW;
+    // decimated samples between analyses (of successive channels)
+    static const int HOP = 64;
+    static const int TARGET_RATE = 12000;
+    static const int MAX_FREQUENCY = 2000;
+    static const int MAX_KEY_MAXIMA = 64;
+
+    // MPM: the first NSDF peak within this fraction of the highest one is the period
+    static constexpr float PEAK_THRESHOLD = 0.9f;
+    // an NSDF peak lower than this isn't a pitch (noise, or a chord)
+    static constexpr float MIN_CLARITY = 0.6f;
+    // RMS below this (in V) is silence
+    static constexpr float MIN_LEVEL = 0.01f;
+
+    enum Stage {
+        IDLE,
+        // power spectrum, inverse FFT
+        AUTOCORRELATION,
+        // NSDF and peak picking
+        PEAK
+    };
+
+    // results, per channel: 0 for no pitch
+    float frequency[CHANNELS];
+    // the height of the chosen NSDF peak: 1 for a perfectly periodic signal
+    float clarity[CHANNELS];
+    // inactive channels aren't analysed
+    bool active[CHANNELS];
+
+    float sampleRate = 0.f;
+    // decimated sample rate
+    float rate = 0.f;
+    int factor = 1;
+    int phase = 0;
+    float coefficient = 0.f;
+    rack::simd::float_4 lowpass1[CHANNELS / 4];
+    rack::simd::float_4 lowpass2[CHANNELS / 4];
+
+    alignas(16) float ring[WINDOW][CHANNELS];
+    int writePos = 0;
+    int hopCount = 0;
+
+    // the analysis in progress:
+    int stage = IDLE;
+    int channel = CHANNELS - 1;
+    float window[WINDOW];
+    alignas(16) float fftBuffer[FFT_SIZE];
+    alignas(16) float spectrum[FFT_SIZE];
+    float nsdf[WINDOW / 2 + 2];
+    rack::dsp::RealFFT fft { FFT_SIZE };
+
+    PitchDetector()
+    {
+        for (int c = 0; c < CHANNELS; c++) {
+            active[c] = false;
+        }
+        setSampleRate(48000.f);
+    }
+
+    void reset()
+    {
+        for (int g = 0; g < CHANNELS / 4; g++) {
+            lowpass1[g] = 0.f;
+            lowpass2[g] = 0.f;
+        }
+        std::memset(ring, 0, sizeof(ring));
+        for (int c = 0; c < CHANNELS; c++) {
+            frequency[c] = 0.f;
+            clarity[c] = 0.f;
+        }
+        phase = 0;
+        writePos = 0;
+        hopCount = 0;
+        stage = IDLE;
+    }
+
+    void setSampleRate(float newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        factor = std::max(1, (int)std::round(sampleRate / TARGET_RATE));
+        rate = sampleRate / factor;
+        // two one pole low-passes at a quarter of the decimated rate, against aliasing
+        const float cutoff = 0.25f * rate;
+        coefficient = 1.f - std::exp(-2.f * (float)M_PI * cutoff / sampleRate);
+        reset();
+    }
+
+    /* the detected pitch of channel c as V/oct, or NaN if none */
+    float pitchVoltage(int c) const
+    {
+        return frequency[c] > 0.f ? std::log2(frequency[c] / 261.625565f) : NAN;
+    }
+
+    /* one sample of each channel's audio */
+    void process(const float* in)
+    {
+        for (int g = 0; g < CHANNELS / 4; g++) {
+            const rack::simd::float_4 x = rack::simd::float_4::load(in + 4 * g);
+            lowpass1[g] += coefficient * (x - lowpass1[g]);
+            lowpass2[g] += coefficient * (lowpass1[g] - lowpass2[g]);
+        }
+        if (++phase < factor) {
+            return;
+        }
+        phase = 0;
+        for (int g = 0; g < CHANNELS / 4; g++) {
+            lowpass2[g].store(&ring[writePos][4 * g]);
+        }
+        writePos = (writePos + 1) & (WINDOW - 1);
+
+        switch (stage) {
+        case AUTOCORRELATION:
+            autocorrelation();
+            break;
+        case PEAK:
+            peak();
+            break;
+        default:
+            if (++hopCount >= HOP) {
+                hopCount = 0;
+                start();
+            }
+        }
+    }
+
+    /* next active channel's window: remove its DC and FFT it */
+    void start()
+    {
+        int c = channel;
+        for (int i = 0; i < CHANNELS; i++) {
+            c = (c + 1) % CHANNELS;
+            if (active[c]) {
+                break;
+            }
+            frequency[c] = 0.f;
+        }
+        if (!active[c]) {
+            return;
+        }
+        channel = c;
+
+        float mean = 0.f;
+        for (int i = 0; i < WINDOW; i++) {
+            // oldest first
+            window[i] = ring[(writePos + i) & (WINDOW - 1)][c];
+            mean += window[i];
+        }
+        mean /= WINDOW;
+        float energy = 0.f;
+        for (int i = 0; i < WINDOW; i++) {
+            window[i] -= mean;
+            energy += window[i] * window[i];
+        }
+        if (energy < MIN_LEVEL * MIN_LEVEL * WINDOW) {
+            frequency[c] = 0.f;
+            clarity[c] = 0.f;
+            return;
+        }
+        // zero padded to twice the window, so the autocorrelation doesn't wrap around
+        std::memcpy(fftBuffer, window, sizeof(window));
+        std::memset(fftBuffer + WINDOW, 0, sizeof(float) * (FFT_SIZE - WINDOW));
+        fft.rfft(fftBuffer, spectrum);
+        stage = AUTOCORRELATION;
+    }
+
+    void autocorrelation()
+    {
+        // ordered as [DC, Nyquist, re1, im1, re2, im2 ...]
+        spectrum[0] *= spectrum[0];
+        spectrum[1] *= spectrum[1];
+        for (int k = 2; k < FFT_SIZE; k += 2) {
+            spectrum[k] = spectrum[k] * spectrum[k] + spectrum[k + 1] * spectrum[k + 1];
+            spectrum[k + 1] = 0.f;
+        }
+        // fftBuffer[tau] = FFT_SIZE * autocorrelation at lag tau
+        fft.irfft(spectrum, fftBuffer);
+        stage = PEAK;
+    }
+
+    void peak()
+    {
+        stage = IDLE;
+        const int c = channel;
+        const int maxLag = WINDOW / 2;
+        const int minLag = std::max(2, (int)(rate / MAX_FREQUENCY));
+
+        // NSDF(tau) = 2 r(tau) / m(tau), m(tau) = sum of x[j]^2 + x[j + tau]^2 over the overlap
+        float m = 2.f * fftBuffer[0];
+        nsdf[0] = 1.f;
+        for (int tau = 1; tau <= maxLag + 1; tau++) {
+            const float a = window[tau - 1];
+            const float b = window[WINDOW - tau];
+            m -= FFT_SIZE * (a * a + b * b);
+            nsdf[tau] = m > 0.f ? 2.f * fftBuffer[tau] / m : 0.f;
+        }
+
+        // the highest point of each positive lobe after the first zero crossing
+        int keyMaxima[MAX_KEY_MAXIMA];
+        int numKeyMaxima = 0;
+        float highest = 0.f;
+        int tau = 1;
+        while (tau <= maxLag && nsdf[tau] > 0.f) {
+            tau++;
+        }
+        while (tau <= maxLag && numKeyMaxima < MAX_KEY_MAXIMA) {
+            while (tau <= maxLag && nsdf[tau] <= 0.f) {
+                tau++;
+            }
+            int best = -1;
+            while (tau <= maxLag && nsdf[tau] > 0.f) {
+                if (tau >= minLag && (best < 0 || nsdf[tau] > nsdf[best])) {
+                    best = tau;
+                }
+                tau++;
+            }
+            if (best >= 0) {
+                keyMaxima[numKeyMaxima++] = best;
+                highest = std::max(highest, nsdf[best]);
+            }
+        }
+
+        frequency[c] = 0.f;
+        clarity[c] = 0.f;
+        for (int i = 0; i < numKeyMaxima; i++) {
+            const int t = keyMaxima[i];
+            if (nsdf[t] < PEAK_THRESHOLD * highest) {
+                continue;
+            }
+            float height;
+            float period = interpolatePeak(t, height);
+            if (height < MIN_CLARITY) {
+                break;
+            }
+            // High pitches are only a few lags long, too short to interpolate accurately: measure
+            // the peak at a multiple of the period instead, and divide
+            const int multiple = (int)(maxLag / 2 / period);
+            if (multiple >= 2) {
+                int tm = (int)std::round(multiple * period);
+                for (int step = 0; step < 2; step++) {
+                    tm += nsdf[tm + 1] > nsdf[tm] ? 1 : nsdf[tm - 1] > nsdf[tm] ? -1 : 0;
+                }
+                float multipleHeight;
+                const float multiplePeriod = interpolatePeak(tm, multipleHeight) / multiple;
+                if (multipleHeight >= MIN_CLARITY && std::abs(multiplePeriod - period) < 0.5f) {
+                    period = multiplePeriod;
+                }
+            }
+            frequency[c] = rate / period;
+            clarity[c] = std::min(height, 1.f);
+            break;
+        }
+    }
+
+    /* the lag of the NSDF peak near lag t, by parabolic interpolation between its neighbours */
+    float interpolatePeak(int t, float& height) const
+    {
+        const float y0 = nsdf[t - 1];
+        const float y1 = nsdf[t];
+        const float y2 = nsdf[t + 1];
+        const float d = y0 - 2.f * y1 + y2;
+        const float delta = d < 0.f ? 0.5f * (y0 - y2) / d : 0.f;
+        height = y1 - 0.25f * (y0 - y2) * delta;
+        return t + delta;
+    }
+};
+
+}
@@ -5,30 +5,123 @@
 namespace Chinenual {
 namespace Inv {
 
+    using rack::simd::float_4;
+
     struct PitchInverter {
         enum Mode {
             MODE_CHROMATIC,
-            // no support for TONAL inversion (yet?).  Requires more thought on how to specify the pitch offset
-            // to start the inversion
-            // MODE_DIATONIC,
+            // reflect by scale degree within the scale set by setScale().  Both the pivot and the
+            // melody note are snapped to the nearest scale note (up, if equidistant); the result is
+            // always a (12-TET) scale note.
+            MODE_DIATONIC,
         };
 
         Mode mode;
+        // the scale's pitch classes (bit 0 == C); 0 (no scale) behaves as the chromatic scale
+        int scaleMask;
+        // Reflection table built by setScale(), indexed by [pivot pitch class * 12 + note pitch
+        // class]: the diatonic inversion of note n about pivot p (in semitones) is
+        //   2p - n + reflection[..]
+        // i.e. the chromatic inversion plus a correction that only depends on the two pitch
+        // classes, since moving either note by an octave moves the result by a whole number of
+        // octaves.
+        float reflection[12 * 12];
 
         void reset()
         {
             mode = MODE_CHROMATIC;
+            setScale(0);
         }
 
-        /* All args in V/oct.  pivot: the note around which to reflect; v: the note to invert */
-        float invert(float pivot_v, float v)
+        /* Set up reflection[] for the given scale.  Call only when the scale changes. */
+        void setScale(int mask)
+        {
+            scaleMask = mask & 0xfff;
+            int scale[12];
+            int k = 0;
+            for (int pc = 0; pc < 12; pc++) {
+                if (scaleMask == 0 || (scaleMask & (1 << pc))) {
+                    scale[k++] = pc;
+                }
+            }
+            for (int p = 0; p < 12; p++) {
+                for (int n = 0; n < 12; n++) {
+                    const int inverted = noteOfDegree(scale, k, 2 * degreeOf(scale, k, p) - degreeOf(scale, k, n));
+                    reflection[p * 12 + n] = inverted - (2 * p - n);
+                }
+            }
+        }
+
+        /* floor division (rounding toward minus infinity) */
+        static int floorDiv(int a, int b)
+        {
+            return a >= 0 ? a / b : -((b - 1 - a) / b);
+        }
+
+        static bool inScale(const int* scale, int k, int n)
+        {
+            const int pc = n - 12 * floorDiv(n, 12);
+            for (int i = 0; i < k; i++) {
+                if (scale[i] == pc) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /* scale degree (counting from 0V == degree 0) of the scale note nearest to semitone note n */
+        static int degreeOf(const int* scale, int k, int n)
         {
-            if (mode == MODE_CHROMATIC) {
-                float offset = v - pivot_v;
-                return pivot_v - offset;
+            int snapped = n;
+            for (int d = 0; d <= 6; d++) {
+                // check up first, so an equidistant note snaps up
+                if (inScale(scale, k, n + d)) {
+                    snapped = n + d;
+                    break;
+                }
+                if (inScale(scale, k, n - d)) {
+                    snapped = n - d;
+                    break;
+                }
+            }
+            const int octave = floorDiv(snapped, 12);
+            const int pc = snapped - 12 * octave;
+            int i = 0;
+            while (scale[i] != pc) {
+                i++;
             }
-            // should never happen. return something "reasonable"
-            return v;
+            return octave * k + i;
+        }
+
+        static int noteOfDegree(const int* scale, int k, int degree)
+        {
+            const int octave = floorDiv(degree, k);
+            return 12 * octave + scale[degree - octave * k];
+        }
+
+        /* All args in V/oct, one channel per lane.  pivot: the note around which to reflect; v: the note to invert */
+        float_4 invert(float_4 pivot_v, float_4 v)
+        {
+            if (mode == MODE_DIATONIC) {
+                const float_4 p = rack::simd::round(pivot_v * 12.f);
+                const float_4 n = rack::simd::round(v * 12.f);
+                const float_4 pc_p = p - rack::simd::floor(p / 12.f) * 12.f;
+                const float_4 pc_n = n - rack::simd::floor(n / 12.f) * 12.f;
+                const float_4 index = pc_p * 12.f + pc_n;
+                float_4 r;
+                for (int i = 0; i < 4; i++) {
+                    r[i] = reflection[(int)index[i]];
+                }
+                return (2.f * p - n + r) / 12.f;
+            }
+            // MODE_CHROMATIC
+            const float_4 offset = v - pivot_v;
+            return pivot_v - offset;
+        }
+
+        float invert(float pivot_v, float v)
+        {
+            return invert(float_4(pivot_v), float_4(v))[0];
         }
     };
 
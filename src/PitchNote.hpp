@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+#include <cstring>
 #include <rack.hpp>
 
 namespace Chinenual {
@@ -51,34 +53,75 @@ inline float pitchDevToFrequencyDev(float pitchDeviation)
     return pitchDeviation / 12.f;
 }
 
-/* Careful: noteDeviation is scaled by note value - not by voltage */
-inline void pitchToText(std::string& text, int note, float noteDeviation, NoteAccidental accidentalMode)
+// note names indexed by [accidentalMode][pitch class]
+static constexpr const char* NOTE_NAMES[2][12] = {
+    { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" },
+    { "C", "Db", "D", "Eb", "E", "F", "Gb", "G", "Ab", "A", "Bb", "B" },
+};
+
+// big enough for any pitchToText() result, e.g. "C#-6 -49c"
+static const int PITCH_TEXT_SIZE = 24;
+
+/* append the decimal digits of v to p */
+inline char* appendInt(char* p, int v)
+{
+    char digits[12];
+    int n = 0;
+    unsigned int u = v < 0 ? 0u - (unsigned int)v : (unsigned int)v;
+    do {
+        digits[n++] = '0' + (u % 10);
+        u /= 10;
+    } while (u > 0);
+    if (v < 0) {
+        *p++ = '-';
+    }
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+/* Careful: noteDeviation is scaled by note value - not by voltage.
+   Writes the note name (e.g. "C#4" or "C4 +49c") into text, truncated to size; returns its length.
+   Doesn't allocate. */
+inline int pitchToText(char* text, size_t size, int note, float noteDeviation, NoteAccidental accidentalMode = SHARP)
 {
+    if (size == 0) {
+        return 0;
+    }
     // warning: note is not just in the MIDI range - might be much lower (-10v in v/oct == -60 "note")
 
     // in case noteDeviation is larger than a semitone, apply it first and compute a new "smaller than semitone" deviation:
     int n = std::round(note + noteDeviation);
     float nDeviation = noteDeviation - (n - note);
 
-    std::vector<std::string> noteNames;
-    if (accidentalMode == SHARP) {
-        noteNames = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
-    } else {
-        noteNames = { "C", "Db", "D", "Eb", "E", "F", "Gb", "G", "Ab", "A", "Bb", "B" };
-    }
-
-    // ensure nameIndex is positive -- add several octaves to ensure we the numerator is > 0.  n could be as low
-    // as -60.   But just in case we feed this something way out of range, add even more.  (Bogaudio LLFO seems to somehow be abnle to send +/- 12V?)
-    int nameIndex = (1200 + n) % 12;
+    // floor division, so negative notes are in the right octave; 60 == C4
+    int octave = (n >= 0 ? n / 12 : -((11 - n) / 12)) - 1;
+    int nameIndex = n - (octave + 1) * 12;
 
-    int octave = (n / 12) - 1; // simple division produces 60=C5; we want to display that as C4, so subtract 1
-    auto absDeviation = std::abs(nDeviation);
-    if (absDeviation >= 0.01f) {
-        text = rack::string::f("%s%d %s%dc", noteNames[nameIndex].c_str(), octave,
-            (nDeviation > 0 ? "+" : "-"),
-            (int)(absDeviation * 100));
-    } else {
-        text = rack::string::f("%s%d", noteNames[nameIndex].c_str(), octave);
+    char buff[PITCH_TEXT_SIZE + 16];
+    char* p = buff;
+    for (const char* name = NOTE_NAMES[accidentalMode == FLAT ? 1 : 0][nameIndex]; *name; name++) {
+        *p++ = *name;
+    }
+    p = appendInt(p, octave);
+    int cents = (int)(std::abs(nDeviation) * 100);
+    if (cents != 0) {
+        *p++ = ' ';
+        *p++ = nDeviation > 0 ? '+' : '-';
+        p = appendInt(p, cents);
+        *p++ = 'c';
     }
+    int len = std::min((int)(p - buff), (int)size - 1);
+    std::memcpy(text, buff, len);
+    text[len] = 0;
+    return len;
+}
+
+inline void pitchToText(std::string& text, int note, float noteDeviation, NoteAccidental accidentalMode = SHARP)
+{
+    char buff[PITCH_TEXT_SIZE];
+    pitchToText(buff, sizeof(buff), note, noteDeviation, accidentalMode);
+    text = buff;
 }
 }
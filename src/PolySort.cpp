@@ -1,7 +1,7 @@
 #include <osdialog.h>
 
+#include "SortingNetwork.hpp"
 #include "plugin.hpp"
-#include <array>
 
 namespace Chinenual {
 namespace PolySort {
@@ -74,45 +74,76 @@ namespace PolySort {
 
         void process(const ProcessArgs& args) override
         {
-            typedef struct {
-                float voltage;
-                int order;
-            } SortData;
-            std::array<SortData, 16> sorted;
+            // the input whose sort order each input uses: itself, or (linked) the previous input's.
+            // The first input has no "link" (the link[0] param is ignored)
+            int leader[NUM_INPUTS];
             for (int i = 0; i < NUM_INPUTS; i++) {
-                // the first input has no "link" (the link[0] param is ignored)
-                bool useLink = (i > 0 && params[LINK_PARAM + i].getValue());
+                leader[i] = i;
                 if (i > 0) {
-                    lights[LINK_LIGHT + i].setBrightness(params[LINK_PARAM + i].getValue() ? 1.0f : 0.0f);
+                    const bool useLink = params[LINK_PARAM + i].getValue();
+                    lights[LINK_LIGHT + i].setBrightness(useLink ? 1.0f : 0.0f);
+                    if (useLink) {
+                        leader[i] = leader[i - 1];
+                    }
                 }
+            }
 
-                for (int ch = 0; ch < 16; ch++) {
-                    sorted[ch].voltage = inputs[IN_INPUT + i].getVoltage(ch);
-                    if (useLink) {
-                        // reuse the sort order from the previous input
-                    } else {
-                        sorted[ch].order = ch;
+            // each leader's sort order: order[i][ch] is the channel with the ch'th lowest voltage.
+            // Leaders are sorted four at a time, one per float_4 lane; channels past a leader's
+            // channel count sort last, in place.  Unconnected leaders keep the channels in order.
+            int order[NUM_INPUTS][16];
+            int group[4];
+            int groupSize = 0;
+            for (int i = 0; i < NUM_INPUTS; i++) {
+                if (leader[i] == i && inputs[IN_INPUT + i].isConnected()) {
+                    group[groupSize++] = i;
+                } else if (leader[i] == i) {
+                    for (int ch = 0; ch < 16; ch++) {
+                        order[i][ch] = ch;
                     }
                 }
+                if (groupSize == 4 || (groupSize > 0 && i == NUM_INPUTS - 1)) {
+                    sortGroup(group, groupSize, order);
+                    groupSize = 0;
+                }
+            }
+
+            for (int i = 0; i < NUM_INPUTS; i++) {
                 outputs[OUT_OUTPUT + i].setChannels(inputs[IN_INPUT + i].getChannels());
                 if (inputs[IN_INPUT + i].isConnected()) {
-                    if (useLink) {
-                        for (int ch = 0; ch < 16; ch++) {
-                            int idx = sorted[ch].order;
-                            outputs[OUT_OUTPUT + i].setVoltage(sorted[idx].voltage, ch);
-                        }
-                    } else {
-                        std::sort(sorted.begin(), sorted.begin() + inputs[IN_INPUT + i].getChannels(),
-                            [](const SortData& a, const SortData& b) {
-                                return a.voltage < b.voltage;
-                            });
-                        for (int ch = 0; ch < 16; ch++) {
-                            outputs[OUT_OUTPUT + i].setVoltage(sorted[ch].voltage, ch);
-                        }
+                    for (int ch = 0; ch < 16; ch++) {
+                        outputs[OUT_OUTPUT + i].setVoltage(inputs[IN_INPUT + i].getVoltage(order[leader[i]][ch]), ch);
                     }
                 }
             }
         }
+
+        /* sort the voltages of up to four inputs at once, into their orders */
+        void sortGroup(const int* group, int groupSize, int order[][16])
+        {
+            SortingNetwork::KeyedLanes sorted[16];
+            int numChannels = 0;
+            for (int lane = 0; lane < groupSize; lane++) {
+                numChannels = std::max(numChannels, inputs[IN_INPUT + group[lane]].getChannels());
+            }
+            for (int ch = 0; ch < numChannels; ch++) {
+                float key[4] = { INFINITY, INFINITY, INFINITY, INFINITY };
+                for (int lane = 0; lane < groupSize; lane++) {
+                    Input& input = inputs[IN_INPUT + group[lane]];
+                    if (ch < input.getChannels()) {
+                        key[lane] = input.getVoltage(ch);
+                    }
+                }
+                sorted[ch].key = simd::float_4::load(key);
+                sorted[ch].value = ch;
+            }
+            SortingNetwork::sort(numChannels, sorted, SortingNetwork::ByKeyLanes());
+            for (int lane = 0; lane < groupSize; lane++) {
+                for (int ch = 0; ch < 16; ch++) {
+                    order[group[lane]][ch] = ch < numChannels ? (int)sorted[ch].value[lane] : ch;
+                }
+            }
+        }
     };
 
 #define FIRST_X 5.0
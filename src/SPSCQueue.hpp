@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Chinenual {
+
+// A bounded, preallocated, lock-free single producer / single consumer FIFO.  Neither side ever
+// waits or allocates: push() fails (and the item is dropped) when the queue is full, pop() fails
+// when it's empty.
+
+template <typename T, int SIZE>
+struct SPSCQueue {
+    static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2");
+
+    T items[SIZE];
+    // total number of items ever pushed / popped
+    std::atomic<uint32_t> head { 0 };
+    std::atomic<uint32_t> tail { 0 };
+    // items dropped because the queue was full (written by the producer)
+    std::atomic<uint32_t> dropped { 0 };
+
+    // producer only
+    bool push(const T& item)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= (uint32_t)SIZE) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items[h & (SIZE - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only: the oldest item, without removing it; NULL if empty
+    const T* front() const
+    {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t) {
+            return NULL;
+        }
+        return &items[t & (SIZE - 1)];
+    }
+
+    // consumer only: remove the item returned by front()
+    void pop()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer only
+    bool pop(T& item)
+    {
+        const T* f = front();
+        if (!f) {
+            return false;
+        }
+        item = *f;
+        pop();
+        return true;
+    }
+
+    // consumer only: discard everything queued so far
+    void clear()
+    {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+};
+
+} // namespace Chinenual
@@ -0,0 +1,246 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#include <rack.hpp>
+
+namespace Chinenual {
+namespace SortingNetwork {
+
+    // Sorting up to 16 channels with sorting networks: a fixed sequence of compare-exchanges for each
+    // channel count, unrolled at compile time, so sorting is branch free (each exchange is a min/max,
+    // a masked swap or a select) and costs the same whatever the input order.  The channel count at
+    // run time picks the network from a table of function pointers.
+    //
+    // The networks are Batcher's odd-even merge sort for the next power of two, less the comparators
+    // involving channels past the count.  That's the best known size for up to 8 channels, and at
+    // most 3 compare-exchanges more than the best known for up to 16.  test_SortingNetwork checks
+    // every one sorts all 2^N inputs of 0s and 1s (which means it sorts anything).
+
+    static const int MAX_CHANNELS = 16;
+
+    // the compare-exchanges (i, j), i < j, of every network, in order: smaller to i, larger to j
+    static constexpr uint8_t PAIRS[][2] = {
+        // 2: 1
+        { 0, 1 },
+        // 3: 3
+        { 0, 1 }, { 0, 2 }, { 1, 2 },
+        // 4: 5
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 },
+        // 5: 9
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 0, 4 }, { 2, 4 }, { 1, 2 },
+        { 3, 4 },
+        // 6: 12
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 0, 4 }, { 2, 4 },
+        { 1, 5 }, { 3, 5 }, { 1, 2 }, { 3, 4 },
+        // 7: 16
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 4, 6 }, { 5, 6 },
+        { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 5 }, { 1, 2 }, { 3, 4 }, { 5, 6 },
+        // 8: 19
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 6, 7 }, { 4, 6 },
+        { 5, 7 }, { 5, 6 }, { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 7 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 },
+        // 9: 28
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 6, 7 }, { 4, 6 },
+        { 5, 7 }, { 5, 6 }, { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 7 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 0, 8 }, { 4, 8 }, { 2, 4 }, { 6, 8 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 },
+        // 10: 32
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 6, 7 }, { 4, 6 },
+        { 5, 7 }, { 5, 6 }, { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 7 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 8, 9 }, { 0, 8 }, { 4, 8 }, { 2, 4 }, { 6, 8 },
+        { 1, 9 }, { 5, 9 }, { 3, 5 }, { 7, 9 }, { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 },
+        // 11: 37
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 6, 7 }, { 4, 6 },
+        { 5, 7 }, { 5, 6 }, { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 7 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 8, 9 }, { 8, 10 }, { 9, 10 }, { 0, 8 }, { 4, 8 },
+        { 2, 10 }, { 6, 10 }, { 2, 4 }, { 6, 8 }, { 1, 9 }, { 5, 9 }, { 3, 5 }, { 7, 9 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 }, { 9, 10 },
+        // 12: 41
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 6, 7 }, { 4, 6 },
+        { 5, 7 }, { 5, 6 }, { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 7 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 8, 9 }, { 10, 11 }, { 8, 10 }, { 9, 11 }, { 9, 10 },
+        { 0, 8 }, { 4, 8 }, { 2, 10 }, { 6, 10 }, { 2, 4 }, { 6, 8 }, { 1, 9 }, { 5, 9 },
+        { 3, 11 }, { 7, 11 }, { 3, 5 }, { 7, 9 }, { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 },
+        { 9, 10 },
+        // 13: 48
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 6, 7 }, { 4, 6 },
+        { 5, 7 }, { 5, 6 }, { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 7 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 8, 9 }, { 10, 11 }, { 8, 10 }, { 9, 11 }, { 9, 10 },
+        { 8, 12 }, { 10, 12 }, { 9, 10 }, { 11, 12 }, { 0, 8 }, { 4, 12 }, { 4, 8 }, { 2, 10 },
+        { 6, 10 }, { 2, 4 }, { 6, 8 }, { 10, 12 }, { 1, 9 }, { 5, 9 }, { 3, 11 }, { 7, 11 },
+        { 3, 5 }, { 7, 9 }, { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 }, { 9, 10 }, { 11, 12 },
+        // 14: 53
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 6, 7 }, { 4, 6 },
+        { 5, 7 }, { 5, 6 }, { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 7 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 8, 9 }, { 10, 11 }, { 8, 10 }, { 9, 11 }, { 9, 10 },
+        { 12, 13 }, { 8, 12 }, { 10, 12 }, { 9, 13 }, { 11, 13 }, { 9, 10 }, { 11, 12 }, { 0, 8 },
+        { 4, 12 }, { 4, 8 }, { 2, 10 }, { 6, 10 }, { 2, 4 }, { 6, 8 }, { 10, 12 }, { 1, 9 },
+        { 5, 13 }, { 5, 9 }, { 3, 11 }, { 7, 11 }, { 3, 5 }, { 7, 9 }, { 11, 13 }, { 1, 2 },
+        { 3, 4 }, { 5, 6 }, { 7, 8 }, { 9, 10 }, { 11, 12 },
+        // 15: 59
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 6, 7 }, { 4, 6 },
+        { 5, 7 }, { 5, 6 }, { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 7 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 8, 9 }, { 10, 11 }, { 8, 10 }, { 9, 11 }, { 9, 10 },
+        { 12, 13 }, { 12, 14 }, { 13, 14 }, { 8, 12 }, { 10, 14 }, { 10, 12 }, { 9, 13 }, { 11, 13 },
+        { 9, 10 }, { 11, 12 }, { 13, 14 }, { 0, 8 }, { 4, 12 }, { 4, 8 }, { 2, 10 }, { 6, 14 },
+        { 6, 10 }, { 2, 4 }, { 6, 8 }, { 10, 12 }, { 1, 9 }, { 5, 13 }, { 5, 9 }, { 3, 11 },
+        { 7, 11 }, { 3, 5 }, { 7, 9 }, { 11, 13 }, { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 },
+        { 9, 10 }, { 11, 12 }, { 13, 14 },
+        // 16: 63
+        { 0, 1 }, { 2, 3 }, { 0, 2 }, { 1, 3 }, { 1, 2 }, { 4, 5 }, { 6, 7 }, { 4, 6 },
+        { 5, 7 }, { 5, 6 }, { 0, 4 }, { 2, 6 }, { 2, 4 }, { 1, 5 }, { 3, 7 }, { 3, 5 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 8, 9 }, { 10, 11 }, { 8, 10 }, { 9, 11 }, { 9, 10 },
+        { 12, 13 }, { 14, 15 }, { 12, 14 }, { 13, 15 }, { 13, 14 }, { 8, 12 }, { 10, 14 }, { 10, 12 },
+        { 9, 13 }, { 11, 15 }, { 11, 13 }, { 9, 10 }, { 11, 12 }, { 13, 14 }, { 0, 8 }, { 4, 12 },
+        { 4, 8 }, { 2, 10 }, { 6, 14 }, { 6, 10 }, { 2, 4 }, { 6, 8 }, { 10, 12 }, { 1, 9 },
+        { 5, 13 }, { 5, 9 }, { 3, 11 }, { 7, 15 }, { 7, 11 }, { 3, 5 }, { 7, 9 }, { 11, 13 },
+        { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 }, { 9, 10 }, { 11, 12 }, { 13, 14 },
+    };
+    // network N's compare-exchanges are PAIRS[OFFSET[N]] up to PAIRS[OFFSET[N + 1]]
+    static constexpr int OFFSET[MAX_CHANNELS + 2] = { 0, 0, 0, 1, 4, 9, 18, 30, 46, 65, 93, 125, 162, 203, 251, 304, 363, 426 };
+
+    /* compare-exchange K to END - 1, each with constant indices */
+    template <int K, int END>
+    struct Unroll {
+        template <typename T, typename Exchange>
+        static inline void run(T* v, const Exchange& exchange)
+        {
+            exchange(v[PAIRS[K][0]], v[PAIRS[K][1]]);
+            Unroll<K + 1, END>::run(v, exchange);
+        }
+    };
+    template <int END>
+    struct Unroll<END, END> {
+        template <typename T, typename Exchange>
+        static inline void run(T* v, const Exchange& exchange)
+        {
+        }
+    };
+
+    /* sort N elements of v */
+    template <int N, typename T, typename Exchange>
+    void sort(T* v, const Exchange& exchange)
+    {
+        Unroll<OFFSET[N], OFFSET[N + 1]>::run(v, exchange);
+    }
+
+    template <typename T, typename Exchange>
+    struct Dispatch {
+        typedef void (*Sort)(T*, const Exchange&);
+        static const Sort table[MAX_CHANNELS + 1];
+    };
+    template <typename T, typename Exchange>
+    const typename Dispatch<T, Exchange>::Sort Dispatch<T, Exchange>::table[MAX_CHANNELS + 1] = {
+        sort<0, T, Exchange>, sort<1, T, Exchange>, sort<2, T, Exchange>, sort<3, T, Exchange>,
+        sort<4, T, Exchange>, sort<5, T, Exchange>, sort<6, T, Exchange>, sort<7, T, Exchange>,
+        sort<8, T, Exchange>, sort<9, T, Exchange>, sort<10, T, Exchange>, sort<11, T, Exchange>,
+        sort<12, T, Exchange>, sort<13, T, Exchange>, sort<14, T, Exchange>, sort<15, T, Exchange>,
+        sort<16, T, Exchange>
+    };
+
+    /* sort the first n (0 .. 16) elements of v */
+    template <typename T, typename Exchange>
+    inline void sort(int n, T* v, const Exchange& exchange)
+    {
+        Dispatch<T, Exchange>::table[n](v, exchange);
+    }
+
+    // Exchanges:
+
+    /* plain values, ascending: a min and a max */
+    struct Ascending {
+        inline void operator()(float& a, float& b) const
+        {
+            // two conditions, each a plain min or max: with one, GCC may branch on it instead.  (So
+            // of a 0 and a -0, both come out as the first)
+            const float lo = b < a ? b : a;
+            const float hi = a < b ? b : a;
+            a = lo;
+            b = hi;
+        }
+    };
+
+    // A value sorted by a separate key, packed into one integer that orders as the key: the key's bits
+    // (made to order as integers do) above the value's.  An exchange is then an integer compare and
+    // a masked swap, all in the general purpose registers, which 16 of them about fit.  (As a pair of
+    // floats, every exchange moves between SSE and integer registers, and 32 floats don't fit the SSE
+    // registers.)  -0 keys are packed as 0; equal keys order by the value's bits.
+    typedef int64_t Keyed;
+
+    inline Keyed keyed(float key, float value)
+    {
+        int32_t k;
+        uint32_t v;
+        std::memcpy(&k, &key, sizeof(k));
+        std::memcpy(&v, &value, sizeof(v));
+        // negative floats order backwards as integers: flip all but their sign bit
+        k = (k & 0x7fffffff) == 0 ? 0 : k ^ ((k >> 31) & 0x7fffffff);
+        return (Keyed)((uint64_t)(uint32_t)k << 32 | v);
+    }
+
+    inline float keyOf(Keyed k)
+    {
+        int32_t bits = (int32_t)(k >> 32);
+        bits ^= (bits >> 31) & 0x7fffffff;
+        float key;
+        std::memcpy(&key, &bits, sizeof(key));
+        return key;
+    }
+
+    inline float valueOf(Keyed k)
+    {
+        const uint32_t bits = (uint32_t)k;
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /* exchange a and b if swap, by masking (GCC turns a select into a branch) */
+    inline void swapIf(bool swap, Keyed& a, Keyed& b)
+    {
+        const Keyed d = (a ^ b) & -(Keyed)swap;
+        a ^= d;
+        b ^= d;
+    }
+
+    /* by key, ascending */
+    struct ByKey {
+        inline void operator()(Keyed& a, Keyed& b) const
+        {
+            swapIf(b < a, a, b);
+        }
+    };
+
+    /* by key, ascending - but an element with a key of 0 never moves ahead of another.  (A sorting
+       link's unused channels read 0.) */
+    struct ByLinkKey {
+        inline void operator()(Keyed& a, Keyed& b) const
+        {
+            // a key of 0 leaves only the value's 32 bits
+            swapIf(((uint64_t)b > 0xffffffffu) & (b < a), a, b);
+        }
+    };
+
+    // four independent sorts at once, one per lane
+    struct KeyedLanes {
+        rack::simd::float_4 key;
+        rack::simd::float_4 value;
+    };
+
+    /* by key, then by value, ascending, in each lane.  Distinct values (say, channel numbers) make
+       the order total, so a lane can be padded to a longer sort with +INF keys and ascending values
+       and its padding stays put */
+    struct ByKeyLanes {
+        inline void operator()(KeyedLanes& a, KeyedLanes& b) const
+        {
+            const rack::simd::float_4 swap = (b.key < a.key) | ((b.key == a.key) & (b.value < a.value));
+            const KeyedLanes lo = { rack::simd::ifelse(swap, b.key, a.key), rack::simd::ifelse(swap, b.value, a.value) };
+            const KeyedLanes hi = { rack::simd::ifelse(swap, a.key, b.key), rack::simd::ifelse(swap, a.value, b.value) };
+            a = lo;
+            b = hi;
+        }
+    };
+
+} // namespace SortingNetwork
+} // namespace Chinenual
@@ -1,7 +1,7 @@
 #include <osdialog.h>
 
+#include "SortingNetwork.hpp"
 #include "plugin.hpp"
-#include <array>
 
 namespace Chinenual {
 namespace SplitSort {
@@ -69,35 +69,28 @@ namespace SplitSort {
 
             if (params[SORT_PARAM].getValue()) {
                 lights[SORT_LIGHT].setBrightness(1.0f);
-                // sort on our own and populate the LINK array.  Put the voltages in a vector with the LINK
-                // values and sort both together using the first element as the comparison value if sorting without
-                // a link, or the second element if using the link as the sort element.
-                std::array<std::array<float, 2>, 16> sorted;
+                // sort on our own and populate the LINK array.  With a link, sort the voltages paired with
+                // the LINK values, by the LINK value.
+                float sorted[16];
                 for (int ch = 0; ch < 16; ch++) {
-                    sorted[ch][0] = inputs[POLY_INPUT].getVoltage(ch);
-                    if (useLink) {
+                    sorted[ch] = inputs[POLY_INPUT].getVoltage(ch);
+                }
+                if (useLink) {
+                    SortingNetwork::Keyed linked[16];
+                    for (int ch = 0; ch < numChannels; ch++) {
                         // will be 0.0f for unused channels
-                        sorted[ch][1] = inputs[LINK_INPUT].getVoltage(ch);
-                    } else {
-                        sorted[ch][1] = sorted[ch][0];
+                        linked[ch] = SortingNetwork::keyed(inputs[LINK_INPUT].getVoltage(ch), sorted[ch]);
+                    }
+                    // 0.0f might have meant an unused channel on the link input: those stay in place
+                    SortingNetwork::sort(numChannels, linked, SortingNetwork::ByLinkKey());
+                    for (int ch = 0; ch < numChannels; ch++) {
+                        sorted[ch] = SortingNetwork::valueOf(linked[ch]);
                     }
+                } else {
+                    SortingNetwork::sort(numChannels, sorted, SortingNetwork::Ascending());
                 }
-                std::sort(sorted.begin(), sorted.begin() + numChannels,
-                    [useLink](const std::array<float, 2>& a, const std::array<float, 2>& b) {
-                        if (useLink) {
-                            if (a[1] == 0.0f) {
-                                // 0.0f might have meant an unused channel on the link input.
-                                // Treat it as "leave this position in place"
-                                return false;
-                            } else {
-                                return a[1] < b[1];
-                            }
-                        } else {
-                            return a[0] < b[0];
-                        }
-                    });
                 for (int ch = 0; ch < 16; ch++) {
-                    outputs[SPLIT_OUTPUT + ch].setVoltage(sorted[ch][0]);
+                    outputs[SPLIT_OUTPUT + ch].setVoltage(sorted[ch]);
                     if (useLink) {
                         outputs[LINK_OUTPUT].setVoltage(inputs[LINK_INPUT].getVoltage(ch), ch);
                     } else {
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cstring>
+
+#include "TextDisplay.hpp"
+
+namespace Chinenual {
+
+    TextDisplay::TextDisplay(const std::string& fontPath, float fontSize, int align, float maxWidth)
+        : fontPath(fontPath)
+        , fontSize(fontSize)
+        , align(align)
+        , maxWidth(maxWidth)
+    {
+        color = nvgRGB(0xff, 0xff, 0xff);
+        textWidget = new Text;
+        textWidget->display = this;
+        addChild(textWidget);
+    }
+
+    void TextDisplay::setText(const char* newText)
+    {
+        if (text != newText) {
+            text = newText;
+            lines = 1 + std::count(text.begin(), text.end(), '\n');
+            setDirty();
+        }
+    }
+
+    void TextDisplay::setColor(NVGcolor newColor)
+    {
+        if (newColor.r != color.r || newColor.g != color.g || newColor.b != color.b || newColor.a != color.a) {
+            color = newColor;
+            setDirty();
+        }
+    }
+
+    void TextDisplay::setFontSize(float newFontSize)
+    {
+        if (newFontSize != fontSize) {
+            fontSize = newFontSize;
+            setDirty();
+        }
+    }
+
+    void TextDisplay::step()
+    {
+        if (!font) {
+            // loaded once; the window keeps the font for as long as it's open
+            font = APP->window->loadFont(fontPath);
+            if (font) {
+                setDirty();
+            }
+        }
+        // The framebuffer covers its children's bounding box, so size the text widget to where the
+        // text may be drawn (which, right or center aligned, can extend left of this widget)
+        rack::Rect& r = textWidget->box;
+        if (align & NVG_ALIGN_RIGHT) {
+            r.pos.x = textPos.x - maxWidth;
+        } else if (align & NVG_ALIGN_CENTER) {
+            r.pos.x = textPos.x - maxWidth / 2.f;
+        } else {
+            r.pos.x = textPos.x;
+        }
+        // room for ascenders and descenders whatever the vertical alignment
+        r.pos.y = textPos.y - (lines + 0.5f) * fontSize;
+        r.size = rack::Vec(maxWidth, (2 * lines + 1) * fontSize);
+        FramebufferWidget::step();
+    }
+
+    void TextDisplay::draw(const DrawArgs& args)
+    {
+        // nothing on the panel layer: see drawLayer()
+    }
+
+    void TextDisplay::drawLayer(const DrawArgs& args, int layer)
+    {
+        if (layer == 1) {
+            // re-renders the framebuffer first if it's dirty
+            FramebufferWidget::draw(args);
+        }
+    }
+
+    void TextDisplay::Text::draw(const DrawArgs& args)
+    {
+        if (!display->font) {
+            return;
+        }
+        nvgFontSize(args.vg, display->fontSize);
+        nvgFontFaceId(args.vg, display->font->handle);
+        nvgFillColor(args.vg, display->color);
+        nvgTextAlign(args.vg, display->align);
+        const float x = display->textPos.x - box.pos.x;
+        float y = display->textPos.y - box.pos.y;
+        // the first line's position, so that the block is aligned as one line would be
+        if (display->align & NVG_ALIGN_BOTTOM) {
+            y -= (display->lines - 1) * display->fontSize;
+        } else if (display->align & NVG_ALIGN_MIDDLE) {
+            y -= (display->lines - 1) * display->fontSize / 2.f;
+        }
+        const char* line = display->text.c_str();
+        for (;;) {
+            const char* end = std::strchr(line, '\n');
+            nvgText(args.vg, x, y, line, end);
+            if (!end) {
+                break;
+            }
+            line = end + 1;
+            y += display->fontSize;
+        }
+    }
+
+}
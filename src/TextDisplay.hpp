@@ -0,0 +1,46 @@
+#pragma once
+#include <rack.hpp>
+
+namespace Chinenual {
+
+    // A line of text in one of the modules' LED-style displays.
+    //
+    // The text is rendered into a framebuffer, which is redrawn only when the text or its color
+    // changes - every other frame just composites the cached image.  Like the LEDs, it's drawn on
+    // the light layer so it stays readable with the room lights dimmed.
+    //
+    // Subclasses poll their module in step() and call setText() / setColor(); both compare against
+    // what's already shown, so re-setting the same text every frame costs no more than a strcmp.
+    // Text with newlines is drawn as several lines, the block aligned as a whole.
+    struct TextDisplay : rack::FramebufferWidget {
+        struct Text : rack::Widget {
+            TextDisplay* display;
+            void draw(const DrawArgs& args) override;
+        };
+
+        std::string fontPath;
+        std::shared_ptr<rack::Font> font;
+        float fontSize;
+        // NVG_ALIGN_* flags
+        int align;
+        // where the text is anchored (according to align), relative to this widget
+        rack::Vec textPos = rack::Vec(6, 24);
+        // the widest text expected: the framebuffer covers only this much
+        float maxWidth;
+        std::string text;
+        int lines = 1;
+        NVGcolor color;
+        Text* textWidget;
+
+        TextDisplay(const std::string& fontPath, float fontSize, int align, float maxWidth);
+
+        void setText(const char* newText);
+        void setColor(NVGcolor newColor);
+        void setFontSize(float newFontSize);
+
+        void step() override;
+        void draw(const DrawArgs& args) override;
+        void drawLayer(const DrawArgs& args, int layer) override;
+    };
+
+}
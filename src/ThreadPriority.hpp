@@ -0,0 +1,114 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef ARCH_LIN
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Chinenual {
+
+// Scheduling for the plugin's background (non-audio) threads, so that a burst of work there - e.g.
+// copying a large take into the MidiFile or writing it to disk - doesn't compete with the engine
+// threads.  Only implemented on Linux; elsewhere apply() leaves the thread alone.
+
+enum ThreadPolicy {
+    THREAD_POLICY_NORMAL, // SCHED_OTHER
+    THREAD_POLICY_BATCH, // SCHED_BATCH
+    THREAD_POLICY_IDLE, // SCHED_IDLE
+    NUM_THREAD_POLICIES
+};
+static const std::vector<std::string> ThreadPolicyNames = {
+    "Normal",
+    "Batch",
+    "Idle",
+};
+
+// nice values offered in the context menu; setpriority() takes -20..19
+static const int THREAD_NICE_VALUES[] = { 0, 5, 10, 19 };
+static const int THREAD_NICE_MIN = -20;
+static const int THREAD_NICE_MAX = 19;
+static const std::vector<std::string> ThreadNiceNames = {
+    "0 (default)",
+    "5",
+    "10",
+    "19 (lowest)",
+};
+
+struct ThreadPriority {
+    int policy = THREAD_POLICY_NORMAL;
+    int nice = 0;
+    // pin to the last CPU the thread may run on, away from the first CPUs where the engine threads
+    // tend to land
+    bool pinToLastCPU = false;
+
+    bool operator==(const ThreadPriority& other) const
+    {
+        return policy == other.policy && nice == other.nice && pinToLastCPU == other.pinToLastCPU;
+    }
+    bool operator!=(const ThreadPriority& other) const
+    {
+        return !(*this == other);
+    }
+
+    bool isDefault() const
+    {
+        return *this == ThreadPriority();
+    }
+
+    // Called from the thread to be adjusted.  Returns false if any part of the request was refused
+    // by the OS (e.g. lowering the nice value again without CAP_SYS_NICE).
+    bool apply() const
+    {
+#ifdef ARCH_LIN
+        bool ok = true;
+        int sched = SCHED_OTHER;
+        switch (policy) {
+        case THREAD_POLICY_BATCH:
+            sched = SCHED_BATCH;
+            break;
+        case THREAD_POLICY_IDLE:
+            sched = SCHED_IDLE;
+            break;
+        }
+        struct sched_param param;
+        param.sched_priority = 0;
+        if (pthread_setschedparam(pthread_self(), sched, &param) != 0) {
+            ok = false;
+        }
+        // on Linux the nice value is per-thread when addressed by thread id
+        pid_t tid = (pid_t)syscall(SYS_gettid);
+        if (setpriority(PRIO_PROCESS, tid, nice) != 0) {
+            ok = false;
+        }
+        // the affinity is left alone unless pinning: it may have been narrowed on purpose (taskset,
+        // a cpuset cgroup), and the CPUs it allows needn't be the first ones
+        if (pinToLastCPU) {
+            cpu_set_t cpus;
+            if (pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+                return false;
+            }
+            if (CPU_COUNT(&cpus) > 1) {
+                int last = CPU_SETSIZE - 1;
+                while (!CPU_ISSET(last, &cpus)) {
+                    last--;
+                }
+                CPU_ZERO(&cpus);
+                CPU_SET(last, &cpus);
+                if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+                    ok = false;
+                }
+            }
+        }
+        return ok;
+#else
+        return true;
+#endif
+    }
+};
+
+} // namespace Chinenual
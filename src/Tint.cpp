@@ -1,5 +1,7 @@
 #include <osdialog.h>
 
+#include "ChannelCache.hpp"
+#include "MixMap.hpp"
 #include "PitchNote.hpp"
 #include "TintQuantizer.hpp"
 #include "plugin.hpp"
@@ -7,6 +9,12 @@
 namespace Chinenual {
 namespace Tint {
 
+    // arbitrary tuning repeat period choices presented in the context menu (volts):
+    static const float TUNING_PERIODS[] = { 1.f, 1.5849625f /* log2(3) */, 0.5849625f /* log2(3/2) */, 0.f };
+    static const std::vector<std::string> TUNING_PERIOD_NAMES = {
+        "Octave", "Tritave (3:1)", "Fifth (3:2)", "No repeat (chord notes only)"
+    };
+
     struct Tint : Module {
         enum ParamId {
             MODE_PARAM,
@@ -30,6 +38,12 @@ namespace Tint {
 
         dsp::SchmittTrigger gateTrigger;
         TintQuantizer tq;
+        // last harmony computed for each melody channel
+        ChannelCache cache;
+        bool arbitraryTuning;
+        int periodIndex;
+        MixMode mixMode;
+        MixMap mixMap;
 
         Tint()
         {
@@ -49,6 +63,10 @@ namespace Tint {
         {
             gateTrigger.reset();
             tq.reset();
+            cache.reset();
+            arbitraryTuning = false;
+            periodIndex = 0;
+            mixMode = MIX_INTERLEAVED;
         }
 
         json_t* dataToJson() override
@@ -56,6 +74,10 @@ namespace Tint {
             json_t* rootJ = json_object();
             json_object_set_new(rootJ, "octave", json_integer(tq.octave));
             json_object_set_new(rootJ, "mode", json_integer(tq.mode));
+            json_object_set_new(rootJ, "chordToleranceCents", json_real(tq.toleranceCents));
+            json_object_set_new(rootJ, "arbitraryTuning", json_boolean(arbitraryTuning));
+            json_object_set_new(rootJ, "tuningPeriod", json_integer(periodIndex));
+            json_object_set_new(rootJ, "mixMode", json_integer(mixMode));
             return rootJ;
         }
 
@@ -72,44 +94,67 @@ namespace Tint {
             if (octaveJ) {
                 tq.octave = json_integer_value(octaveJ);
             }
+            json_t* toleranceJ = json_object_get(rootJ, "chordToleranceCents");
+            if (toleranceJ) {
+                tq.toleranceCents = json_number_value(toleranceJ);
+            }
+            json_t* arbitraryJ = json_object_get(rootJ, "arbitraryTuning");
+            if (arbitraryJ) {
+                arbitraryTuning = json_boolean_value(arbitraryJ);
+            }
+            json_t* periodJ = json_object_get(rootJ, "tuningPeriod");
+            if (periodJ) {
+                periodIndex = clamp((int)json_integer_value(periodJ), 0, (int)TUNING_PERIOD_NAMES.size() - 1);
+            }
+            json_t* mixModeJ = json_object_get(rootJ, "mixMode");
+            if (mixModeJ) {
+                mixMode = (MixMode)clamp((int)json_integer_value(mixModeJ), 0, (int)MixModeNames.size() - 1);
+            }
         }
 
         void process(const ProcessArgs& args) override
         {
             // if (args.frame % 1) {
-            tq.mode = (TintQuantizer::Mode)(int)params[MODE_PARAM].getValue();
-            tq.octave = (int)params[OCTAVE_PARAM].getValue();
+            TintQuantizer::Mode mode = (TintQuantizer::Mode)(int)params[MODE_PARAM].getValue();
+            int octave = (int)params[OCTAVE_PARAM].getValue();
+            if (mode != tq.mode || octave != tq.octave) {
+                tq.mode = mode;
+                tq.octave = octave;
+                cache.invalidate();
+            }
             if (gateTrigger.process(inputs[GATE_INPUT].getVoltage(), 1.f, 2.f)) {
                 // toggle the direction
                 tq.upDown = !tq.upDown;
+                cache.invalidate();
+            }
+            if (tq.arbitraryTuning != arbitraryTuning || tq.period != TUNING_PERIODS[periodIndex]) {
+                tq.setTuning(arbitraryTuning, TUNING_PERIODS[periodIndex]);
+                cache.invalidate();
             }
 
-            bool chordChange = false;
+            float chord[PORT_MAX_CHANNELS];
             for (int c = 0; c < inputs[CHORD_INPUT].getChannels(); c++) {
                 // we assume inputs are in +/-10V
-                float v = clamp(inputs[CHORD_INPUT].getPolyVoltage(c), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
-                if (v != tq.chordInputVoltageState[c]) {
-                    chordChange = true;
-                }
-                tq.chordInputVoltageState[c] = v;
+                chord[c] = clamp(inputs[CHORD_INPUT].getPolyVoltage(c), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
             }
-            if (chordChange) {
-                tq.prepare(inputs[CHORD_INPUT].getChannels());
+            if (tq.updateChord(chord, inputs[CHORD_INPUT].getChannels())) {
+                cache.invalidate();
             }
-            int tint_c = 0;
-            int mix_c = 0;
-            for (int c = 0; c < inputs[PITCH_INPUT].getChannels(); c++) {
+            const int channels = inputs[PITCH_INPUT].getChannels();
+            float in_v[PORT_MAX_CHANNELS];
+            float tint_v[PORT_MAX_CHANNELS];
+            for (int c = 0; c < channels; c++) {
                 // we assume inputs are in +/-10V
-                float in_v = clamp(inputs[PITCH_INPUT].getPolyVoltage(c), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
-                float tint_v = tq.tintinnabulate(in_v);
-                outputs[TINT_OUTPUT].setVoltage(tint_v, tint_c);
-                outputs[MIX_OUTPUT].setVoltage(in_v, mix_c);
-                outputs[MIX_OUTPUT].setVoltage(tint_v, mix_c + 1);
-                tint_c += 1;
-                mix_c += 2;
+                in_v[c] = clamp(inputs[PITCH_INPUT].getPolyVoltage(c), PITCH_VOCT_MIN, PITCH_VOCT_MAX);
+                if (!cache.lookup(c, in_v[c], tint_v[c])) {
+                    tint_v[c] = tq.tintinnabulate(in_v[c]);
+                    cache.store(c, in_v[c], tint_v[c]);
+                }
+                outputs[TINT_OUTPUT].setVoltage(tint_v[c], c);
             }
-            outputs[TINT_OUTPUT].setChannels(tint_c);
-            outputs[MIX_OUTPUT].setChannels(mix_c);
+            outputs[TINT_OUTPUT].setChannels(channels);
+            mixMap.update(channels, mixMode);
+            mixMap.process(outputs[MIX_OUTPUT], in_v, tint_v);
             //}
         }
     };
@@ -129,6 +174,12 @@ namespace Tint {
 #define LABEL_OFFSET_X_OUT (LABEL_OFFSET_X + 2.0)
 #define LABEL_OFFSET_Y_OUT (LABEL_OFFSET_Y - 0.5) // leave space for the shading under the output jacks
 
+    // chord change threshold choices presented in the context menu:
+    static const float CHORD_TOLERANCE_CENTS[] = { 0.f, 1.f, 2.f, 5.f, 10.f };
+    static const std::vector<std::string> CHORD_TOLERANCE_NAMES = {
+        "Any change", "1 cent", "2 cents", "5 cents", "10 cents"
+    };
+
     struct TintWidget : ModuleWidget {
         TintWidget(Tint* module)
         {
@@ -159,6 +210,54 @@ namespace Tint {
             addOutput(createOutputCentered<PJ301MPort>(
                 mm2px(Vec(FIRST_X_OUT + SPACING_X_OUT + 0 * SPACING_X_OUT, FIRST_Y + SPACING_Y * 7)), module, Tint::MIX_OUTPUT));
         }
+
+        void appendContextMenu(Menu* menu) override
+        {
+            Tint* module = dynamic_cast<Tint*>(this->module);
+
+            menu->addChild(new MenuSeparator);
+
+            menu->addChild(createIndexSubmenuItem(
+                "Chord change threshold", CHORD_TOLERANCE_NAMES,
+                [=]() {
+                    for (size_t i = 0; i < CHORD_TOLERANCE_NAMES.size(); i++) {
+                        if (CHORD_TOLERANCE_CENTS[i] == module->tq.toleranceCents)
+                            return i;
+                    }
+                    return (size_t)0;
+                },
+                [=](int val) {
+                    module->tq.toleranceCents = CHORD_TOLERANCE_CENTS[val];
+                }));
+
+            menu->addChild(createIndexSubmenuItem(
+                "Mix output", MixModeNames,
+                [=]() {
+                    return module->mixMode;
+                },
+                [=](int val) {
+                    module->mixMode = (MixMode)val;
+                }));
+
+            menu->addChild(createIndexSubmenuItem(
+                "Tuning", { "12 pitch classes", "Arbitrary" },
+                [=]() {
+                    return module->arbitraryTuning ? 1 : 0;
+                },
+                [=](int val) {
+                    module->arbitraryTuning = val == 1;
+                }));
+            if (module->arbitraryTuning) {
+                menu->addChild(createIndexSubmenuItem(
+                    "Repeat every", TUNING_PERIOD_NAMES,
+                    [=]() {
+                        return module->periodIndex;
+                    },
+                    [=](int val) {
+                        module->periodIndex = val;
+                    }));
+            }
+        }
     };
 
 } // namespace Tint
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "PitchNote.hpp"
+#include <algorithm>
 
 #define NUM_INPUT_ROWS 6
 #define NUM_INPUT_COLS 2
@@ -20,14 +21,43 @@ namespace Tint {
             MODE_QUANTIZE
         };
 
+        static const int NUM_NOTES = PITCH_NOTE_MAX - PITCH_NOTE_MIN + 1;
+        // the navigation tables also cover the notes just outside the range
+        static const int NUM_TABLE_NOTES = NUM_NOTES + 2;
+
         Mode mode;
         int octave;
         // current note is playing up or down when bidirectional
         bool upDown;
         // MAX_FLOAT for not in chord; otherwise the quantized v/oct value for the note
-        float quantizedNoteVoltages[PITCH_NOTE_MAX - PITCH_NOTE_MIN + 1];
+        float quantizedNoteVoltages[NUM_NOTES];
+        // Navigation tables built by prepare(): for each note, the index into quantizedNoteVoltages
+        // of the first and second chord note strictly above or below it, and of the nearest chord
+        // note at or above it.  -1 if there's no such note.  Index with tableIndex().
+        int16_t up1[NUM_TABLE_NOTES];
+        int16_t up2[NUM_TABLE_NOTES];
+        int16_t down1[NUM_TABLE_NOTES];
+        int16_t down2[NUM_TABLE_NOTES];
+        int16_t atOrUp[NUM_TABLE_NOTES];
         // actual voltage specified for the given entry in the reference chord
         float chordInputVoltageState[rack::PORT_MAX_CHANNELS];
+        int chordNoteCount;
+        // the pitch classes in the chord (bit 0 == C) and the tuning deviation (in semitones) of each
+        int classMask;
+        float classDeviation[12];
+        // updateChord() ignores chord input changes smaller than this
+        float toleranceCents;
+
+        // Arbitrary tuning: rather than 12 pitch classes, the chord is kept as a sorted list of
+        // voltages within one period (0 <= degree < period) that repeats every `period` volts (1V
+        // == an octave).  A period of 0 means no repetition: just the chord notes themselves.
+        // Works for any tuning, including non-octave scales.
+        bool arbitraryTuning;
+        float period;
+        int numDegrees;
+        float degrees[rack::PORT_MAX_CHANNELS];
+        // a melody note this close to a chord note is considered to be that note
+        static constexpr float SAME_NOTE_VOLTS = 1.f / 1200.f;
 
         void reset()
         {
@@ -37,10 +67,129 @@ namespace Tint {
             for (int n = PITCH_NOTE_MIN; n <= PITCH_NOTE_MAX; n++) {
                 quantizedNoteVoltages[n - PITCH_NOTE_MIN] = std::numeric_limits<float>::max();
             }
+            buildTables();
             // INFO("RESET!");
             for (int i = 0; i < rack::PORT_MAX_CHANNELS; i++) {
                 chordInputVoltageState[i] = 0.f;
             }
+            chordNoteCount = 0;
+            classMask = 0;
+            for (int pc = 0; pc < 12; pc++) {
+                classDeviation[pc] = 0.f;
+            }
+            toleranceCents = 1.f;
+            arbitraryTuning = false;
+            period = 1.f;
+            numDegrees = 0;
+        }
+
+        void setTuning(bool arbitrary, float newPeriod)
+        {
+            arbitraryTuning = arbitrary;
+            period = newPeriod;
+            buildDegrees();
+        }
+
+        /* Given chordInputVoltageState[], setup the degrees[] array */
+        void buildDegrees()
+        {
+            numDegrees = 0;
+            for (int c = 0; c < chordNoteCount; c++) {
+                float d = chordInputVoltageState[c];
+                if (period > 0.f) {
+                    d -= std::floor(d / period) * period;
+                    if (d >= period) {
+                        // rounding
+                        d = 0.f;
+                    }
+                }
+                degrees[numDegrees++] = d;
+            }
+            std::sort(degrees, degrees + numDegrees);
+            numDegrees = std::unique(degrees, degrees + numDegrees) - degrees;
+        }
+
+        /* voltage of the j'th degree of the (repeating) tuning; with no repetition, j must be in range */
+        float degreeVoltage(int j)
+        {
+            if (period > 0.f) {
+                int p = j >= 0 ? j / numDegrees : -((numDegrees - 1 - j) / numDegrees);
+                return degrees[j - p * numDegrees] + p * period;
+            }
+            return degrees[j];
+        }
+
+        bool validDegree(int j)
+        {
+            return period > 0.f || (j >= 0 && j < numDegrees);
+        }
+
+        /* index of the first degree above v - or at or above it, if inclusive (the binary search) */
+        int firstDegree(float v, bool inclusive)
+        {
+            int base = 0;
+            if (period > 0.f) {
+                float p = std::floor(v / period);
+                v -= p * period;
+                base = (int)p * numDegrees;
+            }
+            const float* d = inclusive ? std::lower_bound(degrees, degrees + numDegrees, v) : std::upper_bound(degrees, degrees + numDegrees, v);
+            return base + (d - degrees);
+        }
+
+        float arbitraryTintinnabulate(float v)
+        {
+            if (numDegrees == 0) {
+                return v + octave;
+            }
+            // first degree above the melody note, and first below it:
+            const int above = firstDegree(v + SAME_NOTE_VOLTS, false);
+            const int below = firstDegree(v - SAME_NOTE_VOLTS, true) - 1;
+            int found = 0;
+            switch (mode) {
+            case MODE_UP:
+                found = above;
+                break;
+            case MODE_UP2:
+                found = above + 1;
+                break;
+            case MODE_DOWN:
+                found = below;
+                break;
+            case MODE_DOWN2:
+                found = below - 1;
+                break;
+            case MODE_UP_DOWN:
+                found = upDown ? above : below;
+                break;
+            case MODE_UP2_DOWN2:
+                found = upDown ? above + 1 : below - 1;
+                break;
+            case MODE_QUANTIZE: {
+                // nearest by voltage; prefer snapping up when equidistant
+                const int up = firstDegree(v, true);
+                const int down = up - 1;
+                if (!validDegree(up)) {
+                    found = down;
+                } else if (!validDegree(down)) {
+                    found = up;
+                } else {
+                    found = (degreeVoltage(up) - v) <= (v - degreeVoltage(down)) ? up : down;
+                }
+                break;
+            }
+            }
+            if (validDegree(found)) {
+                return degreeVoltage(found) + octave; // octave can be used directly since V/oct is 1 volt per octave
+            }
+            // past either end of a non-repeating chord
+            return v + octave;
+        }
+
+        /* pitch class (0 == C) of a MIDI note value - including negative ones */
+        static int pitchClass(int note)
+        {
+            return ((note % 12) + 12) % 12;
         }
 
         /* note is MIDI note value */
@@ -55,51 +204,48 @@ namespace Tint {
             return quantizedNoteVoltages[note - PITCH_NOTE_MIN];
         }
 
+        /* index into the navigation tables for a MIDI note value */
+        static int tableIndex(int note)
+        {
+            return rack::clamp(note, PITCH_NOTE_MIN - 1, PITCH_NOTE_MAX + 1) - (PITCH_NOTE_MIN - 1);
+        }
+
         float tintinnabulate(float v)
         {
+            if (arbitraryTuning) {
+                return arbitraryTintinnabulate(v);
+            }
             int note = voltageToPitch(v);
+            int i = tableIndex(note);
 
-            int delta = 0; // up or down
-            int count = 0; // (1 = first available note in the chord, 2 = second)
+            int16_t found = -1; // index of the chord note to play
             switch (mode) {
             case MODE_UP:
-                count = 1;
-                delta = 1;
+                found = up1[i];
                 break;
             case MODE_UP2:
-                count = 2;
-                delta = 1;
+                found = up2[i];
                 break;
             case MODE_DOWN:
-                count = 1;
-                delta = -1;
+                found = down1[i];
                 break;
             case MODE_DOWN2:
-                count = 2;
-                delta = -1;
+                found = down2[i];
                 break;
             case MODE_UP_DOWN:
-                count = 1;
-                delta = upDown ? 1 : -1;
+                found = upDown ? up1[i] : down1[i];
                 break;
             case MODE_UP2_DOWN2:
-                count = 2;
-                delta = upDown ? 1 : -1;
+                found = upDown ? up2[i] : down2[i];
                 break;
             case MODE_QUANTIZE:
                 // not really tintinnabulation - we just snap to the nearest note in the chord (nearest by frequency)
                 float down_v = 0.f, up_v = 0.f; // voltages of the nearest note up or down
-                for (int n = note; n <= PITCH_NOTE_MAX; n++) {
-                    if (inChord(n)) {
-                        up_v = chordFreq(n);
-                        break;
-                    }
+                if (atOrUp[i] >= 0) {
+                    up_v = quantizedNoteVoltages[atOrUp[i]];
                 }
-                for (int n = note - 1; n >= PITCH_NOTE_MIN; n--) {
-                    if (inChord(n)) {
-                        down_v = chordFreq(n);
-                        break;
-                    }
+                if (down1[i] >= 0) {
+                    down_v = quantizedNoteVoltages[down1[i]];
                 }
                 // choose the nearest one
                 if ((up_v - v) < (v - down_v)) {
@@ -109,50 +255,127 @@ namespace Tint {
                 }
                 break;
             }
-            if (delta > 0) {
-                // UP
-                int c = 0;
-                for (int n = note + 1; n <= PITCH_NOTE_MAX; n++) {
-                    if (inChord(n)) {
-                        c++;
-                    }
-                    if (c == count) {
-                        return chordFreq(n) + octave; // octave can be used directly since V/oct is 1 volt per octave
-                    }
-                }
-            } else {
-                // DOWN
-                int c = 0;
-                for (int n = note - 1; n >= PITCH_NOTE_MIN; n--) {
-                    if (inChord(n)) {
-                        c++;
-                    }
-                    if (c == count) {
-                        return chordFreq(n) + octave; // octave can be used directly since V/oct is 1 volt per octave
-                    }
-                }
+            if (found >= 0) {
+                return quantizedNoteVoltages[found] + octave; // octave can be used directly since V/oct is 1 volt per octave
             }
             // shouldnt happen, but return something reasonable
             return pitchToVoltage(note) + octave; // octave can be used directly since V/oct is 1 volt per octave
         }
 
-        /* Given chordInputVoltageState[], setup the quantizedNoteVoltages[] array */
-        void prepare(int noteCount)
+        /* Given quantizedNoteVoltages[], setup the navigation tables */
+        void buildTables()
         {
-            for (int n = PITCH_NOTE_MIN; n <= PITCH_NOTE_MAX; n++) {
-                quantizedNoteVoltages[n - PITCH_NOTE_MIN] = std::numeric_limits<float>::max();
+            // a table entry t is the note PITCH_NOTE_MIN - 1 + t; quantizedNoteVoltages index q is
+            // the note PITCH_NOTE_MIN + q, i.e. table entry q + 1
+            int16_t first = -1, second = -1;
+            for (int t = NUM_TABLE_NOTES - 1; t >= 0; t--) {
+                up1[t] = first;
+                up2[t] = second;
+                const int q = t - 1;
+                const bool in = q >= 0 && q < NUM_NOTES && quantizedNoteVoltages[q] < std::numeric_limits<float>::max();
+                if (in) {
+                    second = first;
+                    first = q;
+                }
+                atOrUp[t] = first;
+            }
+            first = second = -1;
+            for (int t = 0; t < NUM_TABLE_NOTES; t++) {
+                down1[t] = first;
+                down2[t] = second;
+                const int q = t - 1;
+                const bool in = q >= 0 && q < NUM_NOTES && quantizedNoteVoltages[q] < std::numeric_limits<float>::max();
+                if (in) {
+                    second = first;
+                    first = q;
+                }
             }
+        }
+
+        /* Given chordInputVoltageState[], compute the pitch class mask and per-class deviations.  When more
+        than one chord note has the same pitch class, the last one wins. */
+        void chordClasses(int noteCount, int& mask, float deviation[12])
+        {
+            mask = 0;
             for (int c = 0; c < noteCount; c++) {
                 // we assume inputs are in +/-10V
                 float v = chordInputVoltageState[c];
-                float deviate = voltageToPitchDeviation(v);
-                int chord_n = voltageToPitch(v);
-                for (int n = PITCH_NOTE_MIN; n <= PITCH_NOTE_MAX; n++) {
-                    if ((n % 12) == (chord_n % 12)) {
-                        quantizedNoteVoltages[n - PITCH_NOTE_MIN] = microPitchToVoltage(deviate + n);
+                int pc = pitchClass(voltageToPitch(v));
+                mask |= 1 << pc;
+                deviation[pc] = voltageToPitchDeviation(v);
+            }
+        }
+
+        /* set every note of the given pitch class in quantizedNoteVoltages[] */
+        void setClass(int pc, bool inChord, float deviate)
+        {
+            for (int n = PITCH_NOTE_MIN + pitchClass(pc - PITCH_NOTE_MIN); n <= PITCH_NOTE_MAX; n += 12) {
+                quantizedNoteVoltages[n - PITCH_NOTE_MIN] = inChord ? microPitchToVoltage(deviate + n) : std::numeric_limits<float>::max();
+            }
+        }
+
+        /* Given chordInputVoltageState[], setup the quantizedNoteVoltages[] array */
+        void prepare(int noteCount)
+        {
+            chordNoteCount = noteCount;
+            chordClasses(noteCount, classMask, classDeviation);
+            for (int pc = 0; pc < 12; pc++) {
+                setClass(pc, classMask & (1 << pc), classDeviation[pc]);
+            }
+            buildTables();
+            buildDegrees();
+        }
+
+        /* Update the chord from new input voltages.  Changes of less than toleranceCents are ignored, and
+        only the pitch classes that actually changed are rebuilt.  Returns true if the chord changed. */
+        bool updateChord(const float* voltages, int noteCount)
+        {
+            bool changed = false;
+            if (noteCount != chordNoteCount) {
+                for (int c = 0; c < noteCount; c++) {
+                    chordInputVoltageState[c] = voltages[c];
+                }
+                chordNoteCount = noteCount;
+                changed = true;
+            } else {
+                const float tolerance = toleranceCents / 1200.f; // in V/oct
+                for (int c = 0; c < noteCount; c++) {
+                    if (std::fabs(voltages[c] - chordInputVoltageState[c]) > tolerance) {
+                        chordInputVoltageState[c] = voltages[c];
+                        changed = true;
+                    }
+                }
+            }
+            if (!changed) {
+                return false;
+            }
+            buildDegrees();
+            int mask;
+            float deviation[12] = {};
+            chordClasses(noteCount, mask, deviation);
+            int dirty = mask ^ classMask;
+            for (int pc = 0; pc < 12; pc++) {
+                if ((mask & (1 << pc)) && deviation[pc] != classDeviation[pc]) {
+                    dirty |= 1 << pc;
+                }
+            }
+            if (!dirty) {
+                // e.g. a note moved by less than a semitone, but within a pitch class that's
+                // already in tune
+                return arbitraryTuning;
+            }
+            for (int pc = 0; pc < 12; pc++) {
+                if (dirty & (1 << pc)) {
+                    const bool in = mask & (1 << pc);
+                    if (in) {
+                        classDeviation[pc] = deviation[pc];
                     }
+                    setClass(pc, in, deviation[pc]);
                 }
             }
+            classMask = mask;
+            buildTables();
+            return true;
         }
     };
 
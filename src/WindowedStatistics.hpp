@@ -0,0 +1,136 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Chinenual {
+
+// Mean, standard deviation, min and max of the last `window` values, each value costing O(1).
+//
+// The values are kept in a ring.  The mean and variance are a sliding Welford update (the new value
+// replaces the oldest one, once the window is full).  The min and max are monotonic deques of ring
+// positions: the min deque holds the values that could still become the minimum - increasing from
+// its front (the current minimum) to its back - so a new value first drops every larger value from
+// the back; the oldest value leaves from the front when it slides out of the window.  Likewise the
+// max deque.  All storage is preallocated, for windows of up to CAPACITY values.
+template <int CAPACITY>
+struct WindowedStatistics {
+    static_assert(CAPACITY <= 65536, "ring positions are 16 bit");
+
+    int window = CAPACITY;
+    float value[CAPACITY];
+    // ring position of the oldest value
+    int head = 0;
+    int count = 0;
+    double mean = 0.0;
+    // sum of squared differences from the mean
+    double m2 = 0.0;
+
+    struct Deque {
+        uint16_t position[CAPACITY];
+        int front = 0;
+        int size = 0;
+    };
+    Deque minimums;
+    Deque maximums;
+
+    WindowedStatistics()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        head = 0;
+        count = 0;
+        mean = 0.0;
+        m2 = 0.0;
+        minimums.front = minimums.size = 0;
+        maximums.front = maximums.size = 0;
+    }
+
+    /* the number of values to keep statistics over; changing it starts over */
+    void setWindow(int newWindow)
+    {
+        newWindow = std::max(1, std::min(newWindow, CAPACITY));
+        if (newWindow != window) {
+            window = newWindow;
+            clear();
+        }
+    }
+
+    void add(float x)
+    {
+        if (std::isnan(x)) {
+            return;
+        }
+        int pos;
+        if (count == window) {
+            // x replaces the oldest value
+            pos = head;
+            head = (head + 1) % window;
+            popExpired(minimums, pos);
+            popExpired(maximums, pos);
+            const double y = value[pos];
+            const double oldMean = mean;
+            mean += (x - y) / count;
+            m2 += (x - y) * (x - mean + y - oldMean);
+            // rounding can take it a hair below 0 when the values are all equal
+            m2 = std::max(m2, 0.0);
+        } else {
+            pos = (head + count) % window;
+            count++;
+            const double d = x - mean;
+            mean += d / count;
+            m2 += d * (x - mean);
+        }
+        value[pos] = x;
+        // drop the values x makes irrelevant from the back, then append x
+        while (minimums.size > 0 && value[back(minimums)] >= x) {
+            minimums.size--;
+        }
+        push(minimums, pos);
+        while (maximums.size > 0 && value[back(maximums)] <= x) {
+            maximums.size--;
+        }
+        push(maximums, pos);
+    }
+
+    float min() const
+    {
+        return count > 0 ? value[minimums.position[minimums.front]] : NAN;
+    }
+
+    float max() const
+    {
+        return count > 0 ? value[maximums.position[maximums.front]] : NAN;
+    }
+
+    /* the sample standard deviation */
+    float standardDeviation() const
+    {
+        return count > 1 ? std::sqrt(m2 / (count - 1)) : 0.f;
+    }
+
+    int back(const Deque& q) const
+    {
+        return q.position[(q.front + q.size - 1) % window];
+    }
+
+    void push(Deque& q, int pos)
+    {
+        q.position[(q.front + q.size) % window] = pos;
+        q.size++;
+    }
+
+    /* the value at pos is leaving the window: it can only be at the front */
+    void popExpired(Deque& q, int pos)
+    {
+        if (q.size > 0 && q.position[q.front] == pos) {
+            q.front = (q.front + 1) % window;
+            q.size--;
+        }
+    }
+};
+
+}
@@ -0,0 +1,109 @@
+#define CATCH_CONFIG_MAIN
+
+#include "AdaptiveSampler.hpp"
+#include <functional>
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace MIDIRecorder;
+using namespace Catch;
+
+static const float SAMPLE_TIME = 1.f / 48000.f;
+
+// run a lane for the given number of seconds; returns the number of values sent and the largest
+// difference seen between the lane and the last value sent
+static int runLane(std::function<float(float)> lane, const float secs, const SamplingConfig& config,
+    const float errorSteps, float& maxError, EventBudget* budget = NULL)
+{
+    AdaptiveSampler sampler;
+    int sent = 0;
+    maxError = 0.f;
+    for (int i = 0; i < secs / SAMPLE_TIME; i++) {
+        float t = i * SAMPLE_TIME;
+        float v = lane(t);
+        if (budget) {
+            budget->process(SAMPLE_TIME, config.budget);
+        }
+        if (sampler.process(SAMPLE_TIME, v, config, errorSteps) && (!budget || budget->take())) {
+            sampler.sent(v);
+            sent++;
+        }
+        maxError = std::max(maxError, std::fabs(v - sampler.lastSent));
+    }
+    return sent;
+}
+
+TEST_CASE("static lane sends once")
+{
+    SamplingConfig config;
+    float maxError;
+    int sent = runLane([](float t) { return 64.f; }, 2.f, config, SAMPLING_ERROR_7BIT, maxError);
+    CHECK(sent == 1);
+    CHECK(maxError == 0.f);
+}
+
+TEST_CASE("fast sweep is sampled faster than the fixed rate")
+{
+    SamplingConfig config;
+    config.maxRate = 1000;
+    float maxError;
+    // full scale in 50ms:
+    int sent = runLane([](float t) { return std::min(127.f, t * 127.f / 0.05f); }, 0.1f, config, SAMPLING_ERROR_7BIT, maxError);
+    // the fixed 200 Hz rate would have sent 10 values in the sweep with an error of 12 steps
+    CHECK(sent > 40);
+    CHECK(maxError < 3.f);
+}
+
+TEST_CASE("slow drift is sampled at the min rate")
+{
+    SamplingConfig config;
+    config.minRate = 10;
+    float maxError;
+    // 14bit lane drifting 50 steps per second:
+    int sent = runLane([](float t) { return 8000.f + t * 50.f; }, 2.f, config, SAMPLING_ERROR_14BIT, maxError);
+    CHECK(sent >= 19);
+    CHECK(sent <= 21);
+    CHECK(maxError <= 6.f);
+}
+
+TEST_CASE("event budget caps the total")
+{
+    SamplingConfig config;
+    config.maxRate = 2000;
+    config.budget = 500;
+    EventBudget budget;
+    float maxError;
+    // a fast oscillation that would like 2000 events/s:
+    int sent = runLane([](float t) { return 64.f + 60.f * std::sin(t * 2 * M_PI * 50.f); }, 1.f, config, SAMPLING_ERROR_7BIT, maxError, &budget);
+    CHECK(sent <= 500 + 1);
+    CHECK(sent > 400);
+}
+
+TEST_CASE("event budget grants whole events and takes back the unused ones")
+{
+    EventBudget budget;
+    // filled to the burst: 0.05 s at 1000 events/s
+    for (int i = 0; i < 4800; i++) {
+        budget.process(1.f / 48000.f, 1000);
+    }
+    CHECK(budget.tokens == Detail::Approx(50.f));
+    // the chain's share
+    int granted = budget.grantAll();
+    CHECK(granted == 50);
+    CHECK(budget.tokens < 1.f);
+    CHECK(!budget.take());
+    EventBudget chain;
+    chain.tokens = granted;
+    for (int i = 0; i < 20; i++) {
+        CHECK(chain.take());
+    }
+    budget.refund(chain.grantAll());
+    budget.process(0.f, 1000);
+    CHECK(budget.tokens == Detail::Approx(30.f));
+    // never beyond the burst
+    budget.refund(100);
+    budget.process(0.f, 1000);
+    CHECK(budget.tokens == Detail::Approx(50.f));
+}
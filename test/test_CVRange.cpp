@@ -72,3 +72,79 @@ TEST_CASE("14bit conversions msb/lsb")
         CHECK(msb == 127);
     }
 }
+
+TEST_CASE("change filter reports only changes")
+{
+    ChangeFilter f;
+    int v = -1;
+    CHECK(f.process(10.2f, v));
+    CHECK(v == 10);
+    CHECK(!f.process(10.2f, v));
+    CHECK(!f.process(9.8f, v));
+    CHECK(f.process(11.f, v));
+    CHECK(v == 11);
+    f.reset();
+    CHECK(f.process(11.f, v));
+    CHECK(v == 11);
+}
+
+TEST_CASE("change filter deadband suppresses flapping")
+{
+    ChangeFilter f;
+    f.deadband = 0.5f;
+    int v = -1;
+    CHECK(f.process(10.f, v));
+    // noise either side of the 10/11 boundary:
+    CHECK(!f.process(10.6f, v));
+    CHECK(!f.process(10.4f, v));
+    CHECK(!f.process(10.9f, v));
+    // past the boundary by more than the deadband:
+    CHECK(f.process(11.1f, v));
+    CHECK(v == 11);
+    CHECK(!f.process(10.4f, v));
+    CHECK(f.process(9.9f, v));
+    CHECK(v == 10);
+}
+
+TEST_CASE("change filter always reports the ends of the range")
+{
+    CVRange r(0.f, 10.f);
+    ChangeFilter f;
+    int v = -1;
+    // 16 steps of deadband; the knob is turned fully up
+    f.deadband = 16.f;
+    CHECK(f.process(r.scale7bit(9.2f), v));
+    CHECK(v == 117);
+    CHECK(f.process(r.scale7bit(10.f), v));
+    CHECK(v == 127);
+    CHECK(!f.process(r.scale7bit(10.f), v));
+    // a single step to the top
+    f.deadband = 1.f;
+    f.reset();
+    CHECK(f.process(126.f, v));
+    CHECK(f.process(126.6f, v));
+    CHECK(v == 127);
+
+    f.max = 16383;
+    f.reset();
+    CHECK(f.process(16382.f, v));
+    CHECK(f.process(r.scale14bit(10.f), v));
+    CHECK(v == 16383);
+}
+
+TEST_CASE("change filter always reports the bottom of the range")
+{
+    CVRange r(0.f, 10.f);
+    ChangeFilter f;
+    int v = -1;
+    f.deadband = 16.f;
+    CHECK(f.process(10.f, v));
+    CHECK(f.process(r.scale7bit(-1.f), v));
+    CHECK(v == 0);
+    CHECK(!f.process(0.2f, v));
+    f.deadband = 1.f;
+    f.reset();
+    CHECK(f.process(1.f, v));
+    CHECK(f.process(0.4f, v));
+    CHECK(v == 0);
+}
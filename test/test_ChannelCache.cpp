@@ -0,0 +1,145 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include "ChannelCache.hpp"
+#include "TintQuantizer.hpp"
+#include <random>
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Tint;
+using namespace Catch;
+
+TEST_CASE("channel cache: hits only on the same input in the same generation")
+{
+    ChannelCache cache;
+    float result = 0.f;
+    CHECK(!cache.lookup(0, 0.f, result));
+    cache.store(0, 1.5f, 2.5f);
+    CHECK(cache.lookup(0, 1.5f, result));
+    CHECK(result == 2.5f);
+    CHECK(!cache.lookup(1, 1.5f, result));
+    CHECK(!cache.lookup(0, 1.5001f, result));
+
+    cache.invalidate();
+    CHECK(!cache.lookup(0, 1.5f, result));
+}
+
+TEST_CASE("channel cache: inputs are compared by bit pattern")
+{
+    ChannelCache cache;
+    float result;
+    cache.store(0, 0.f, 1.f);
+    CHECK(!cache.lookup(0, -0.f, result));
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    cache.store(1, nan, 1.f);
+    CHECK(cache.lookup(1, nan, result));
+}
+
+TEST_CASE("channel cache: wrapping the generation invalidates everything")
+{
+    ChannelCache cache;
+    float result;
+    cache.store(0, 1.f, 1.f);
+    cache.generation = 0xffffffff;
+    cache.store(1, 1.f, 1.f);
+    cache.invalidate();
+    CHECK(!cache.lookup(0, 1.f, result));
+    CHECK(!cache.lookup(1, 1.f, result));
+}
+
+// Drives a TintQuantizer the way Tint::process() does - mostly static inputs with the occasional
+// melody, chord, mode or direction change - and checks that the cached outputs are bit-for-bit the
+// same as recomputing every channel every sample.
+TEST_CASE("channel cache: cached Tint outputs are bit-exact with the uncached path")
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> voltDist(-4.f, 4.f);
+    std::uniform_int_distribution<int> eventDist(0, 999);
+    std::uniform_int_distribution<int> modeDist(TintQuantizer::MODE_UP, TintQuantizer::MODE_QUANTIZE);
+
+    TintQuantizer tq;
+    tq.reset();
+    ChannelCache cache;
+    const int channels = rack::PORT_MAX_CHANNELS;
+    float melody[channels];
+    for (int c = 0; c < channels; c++) {
+        melody[c] = voltDist(rng);
+    }
+    float chord[4] = { 0.f, 4 / 12.f, 7 / 12.f, 10 / 12.f };
+    tq.updateChord(chord, 4);
+
+    int hits = 0;
+    for (int sample = 0; sample < 100000; sample++) {
+        const int event = eventDist(rng);
+        if (event < 5) {
+            melody[event % channels] = voltDist(rng);
+        } else if (event == 5) {
+            chord[eventDist(rng) % 4] = voltDist(rng);
+            if (tq.updateChord(chord, 4)) {
+                cache.invalidate();
+            }
+        } else if (event == 6) {
+            tq.mode = (TintQuantizer::Mode)modeDist(rng);
+            cache.invalidate();
+        } else if (event == 7) {
+            tq.upDown = !tq.upDown;
+            cache.invalidate();
+        } else if (event == 8) {
+            tq.setTuning(!tq.arbitraryTuning, 1.f);
+            cache.invalidate();
+        }
+        for (int c = 0; c < channels; c++) {
+            float cached;
+            if (cache.lookup(c, melody[c], cached)) {
+                hits++;
+            } else {
+                cached = tq.tintinnabulate(melody[c]);
+                cache.store(c, melody[c], cached);
+            }
+            const float uncached = tq.tintinnabulate(melody[c]);
+            REQUIRE(ChannelCache::bits(cached) == ChannelCache::bits(uncached));
+        }
+    }
+    // the inputs were static nearly all the time:
+    CHECK(hits > 100000 * channels * 9 / 10);
+}
+
+TEST_CASE("channel cache: static inputs", "[.][benchmark]")
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> melodyDist(-5.f, 5.f);
+    TintQuantizer tq;
+    tq.reset();
+    float chord[3] = { 0.f, 4 / 12.f, 7 / 12.f };
+    tq.updateChord(chord, 3);
+    tq.mode = TintQuantizer::MODE_UP2_DOWN2;
+    float melody[rack::PORT_MAX_CHANNELS];
+    for (int c = 0; c < rack::PORT_MAX_CHANNELS; c++) {
+        melody[c] = melodyDist(rng);
+    }
+    ChannelCache cache;
+    BENCHMARK("uncached, 16 channels")
+    {
+        float sum = 0.f;
+        for (int c = 0; c < rack::PORT_MAX_CHANNELS; c++) {
+            sum += tq.tintinnabulate(melody[c]);
+        }
+        return sum;
+    };
+    BENCHMARK("cached, 16 channels")
+    {
+        float sum = 0.f;
+        for (int c = 0; c < rack::PORT_MAX_CHANNELS; c++) {
+            float v;
+            if (!cache.lookup(c, melody[c], v)) {
+                v = tq.tintinnabulate(melody[c]);
+                cache.store(c, melody[c], v);
+            }
+            sum += v;
+        }
+        return sum;
+    };
+}
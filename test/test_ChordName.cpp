@@ -0,0 +1,115 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include "ChordName.hpp"
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Catch;
+
+static int pitchClasses(std::initializer_list<int> notes)
+{
+    int mask = 0;
+    for (int n : notes) {
+        mask |= 1 << (((n % 12) + 12) % 12);
+    }
+    return mask;
+}
+
+static std::string name(std::initializer_list<int> notes, NoteAccidental accidental = SHARP)
+{
+    // the first note is the bass
+    char text[CHORD_TEXT_SIZE];
+    chordToText(text, sizeof(text), pitchClasses(notes), ((*notes.begin() % 12) + 12) % 12, accidental);
+    return text;
+}
+
+TEST_CASE("chord names: triads and sevenths")
+{
+    CHECK(name({ 60, 64, 67 }) == "C");
+    CHECK(name({ 57, 60, 64 }) == "Am");
+    CHECK(name({ 59, 62, 65 }) == "Bdim");
+    CHECK(name({ 60, 64, 68 }) == "Caug");
+    CHECK(name({ 60, 65, 67 }) == "Csus4");
+    CHECK(name({ 67, 71, 74, 77 }) == "G7");
+    CHECK(name({ 60, 64, 67, 71 }) == "Cmaj7");
+    CHECK(name({ 62, 65, 69, 72 }) == "Dm7");
+    CHECK(name({ 71, 74, 77, 81 }) == "Bm7b5");
+    CHECK(name({ 60, 63, 66, 69 }) == "Cdim7");
+    CHECK(name({ 60, 63, 67, 71 }) == "Cm(maj7)");
+    CHECK(name({ 60, 62, 64, 67, 70 }) == "C9");
+    CHECK(name({ 60, 64, 70 }) == "C7");
+    CHECK(name({ 60, 67 }) == "C5");
+    CHECK(name({ 61 }) == "C#");
+    CHECK(name({ 61 }, FLAT) == "Db");
+}
+
+TEST_CASE("chord names: inversions and octaves")
+{
+    CHECK(name({ 64, 67, 71, 72 }) == "Cmaj7/E");
+    CHECK(name({ 55, 60, 64 }) == "C/G");
+    CHECK(name({ 36, 64, 67, 72, 76, 79 }) == "C");
+    CHECK(name({ 58, 62, 65, 68 }, FLAT) == "Bb7");
+    CHECK(name({ 56, 60, 63, 66 }, FLAT) == "Ab7");
+    CHECK(name({ 63, 67, 70, 72 }, FLAT) == "Cm7/Eb");
+    // below MIDI note 0:
+    CHECK(name({ -12, -8, -5 }) == "C");
+}
+
+TEST_CASE("chord names: anything else")
+{
+    char text[CHORD_TEXT_SIZE];
+    CHECK(chordToText(text, sizeof(text), 0, 0) == 0);
+    CHECK(std::string(text) == "");
+    // a cluster:
+    CHECK(name({ 60, 61, 62 }) == "?");
+    CHECK(name({ 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71 }) == "?");
+    // truncated to the buffer:
+    char small[4];
+    CHECK(chordToText(small, sizeof(small), pitchClasses({ 61, 65, 68, 72 }), 1) == 3);
+    CHECK(std::string(small) == "C#m");
+    CHECK(chordToText(small, 0, pitchClasses({ 60 }), 0) == 0);
+}
+
+TEST_CASE("chord names: table")
+{
+    const ChordTable& table = chordTable();
+    CHECK(table.chord[0].root == -1);
+    // every named set is its quality transposed to its root:
+    int named = 0;
+    for (int mask = 1; mask < 4096; mask++) {
+        Chord c = table.chord[mask];
+        if (c.root < 0) {
+            continue;
+        }
+        named++;
+        int qualityMask = 0;
+        for (const int8_t* i = CHORD_QUALITIES[c.quality].intervals; *i >= 0; i++) {
+            qualityMask |= 1 << ((c.root + *i) % 12);
+        }
+        REQUIRE(qualityMask == mask);
+    }
+    // every single note, root position triad, etc. has a name
+    CHECK(named > 12 * 20);
+    // the same table, whoever asks first
+    CHECK(&chordTable() == &table);
+}
+
+TEST_CASE("chord names: benchmark", "[.][benchmark]")
+{
+    int masks[64];
+    for (int i = 0; i < 64; i++) {
+        masks[i] = pitchClasses({ i, i + 4, i + 7, i + (i % 3 == 0 ? 10 : 11) });
+    }
+    BENCHMARK("name 64 chords")
+    {
+        char text[CHORD_TEXT_SIZE];
+        int total = 0;
+        for (int i = 0; i < 64; i++) {
+            total += chordToText(text, sizeof(text), masks[i], i % 12);
+        }
+        return total;
+    };
+}
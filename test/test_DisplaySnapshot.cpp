@@ -0,0 +1,67 @@
+#define CATCH_CONFIG_MAIN
+
+#include "DisplaySnapshot.hpp"
+#include <thread>
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Catch;
+
+struct Values {
+    int v[16];
+};
+
+TEST_CASE("snapshot: update() only reports new snapshots")
+{
+    DisplaySnapshot<Values> snapshot;
+    CHECK(!snapshot.update());
+    CHECK(snapshot.read().v[0] == 0);
+
+    snapshot.write().v[0] = 1;
+    snapshot.publish();
+    CHECK(snapshot.update());
+    CHECK(snapshot.read().v[0] == 1);
+    CHECK(!snapshot.update());
+    CHECK(snapshot.read().v[0] == 1);
+
+    // only the latest of several is seen:
+    snapshot.write().v[0] = 2;
+    snapshot.publish();
+    snapshot.write().v[0] = 3;
+    snapshot.publish();
+    CHECK(snapshot.update());
+    CHECK(snapshot.read().v[0] == 3);
+}
+
+TEST_CASE("snapshot: the reader never sees a partly written snapshot")
+{
+    DisplaySnapshot<Values> snapshot;
+    const int count = 200000;
+    std::thread producer([&] {
+        for (int n = 1; n <= count; n++) {
+            Values& values = snapshot.write();
+            for (int i = 0; i < 16; i++) {
+                values.v[i] = n;
+            }
+            snapshot.publish();
+        }
+    });
+    int last = 0;
+    bool torn = false;
+    bool backwards = false;
+    while (last < count) {
+        if (snapshot.update()) {
+            const Values& values = snapshot.read();
+            for (int i = 1; i < 16; i++) {
+                torn = torn || values.v[i] != values.v[0];
+            }
+            backwards = backwards || values.v[0] <= last;
+            last = values.v[0];
+        }
+    }
+    producer.join();
+    CHECK(!torn);
+    CHECK(!backwards);
+}
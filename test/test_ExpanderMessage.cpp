@@ -0,0 +1,39 @@
+#define CATCH_CONFIG_MAIN
+
+#include "MIDIRecorderBase.hpp"
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace MIDIRecorder;
+using namespace Catch;
+
+TEST_CASE("expander message: a long chain drops and counts the messages that don't fit")
+{
+    static const int MAX = ExpanderToMasterMessage::MAX_MSGS;
+    static ExpanderToMasterMessage right, left;
+    right.clear(0);
+    for (int i = 0; i < MAX + 3; i++) {
+        right.addController(0, 1, i & 127);
+    }
+    CHECK(right.numMsgs[0] == MAX);
+    CHECK(right.droppedMsgs[0] == 3);
+
+    left.clear(0);
+    left.addController(0, 2, 64);
+    left.addController(0, 2, 65);
+    left.append(right, 0);
+    // what's already in the block is kept; what doesn't fit after it adds to the far end's count
+    CHECK(left.numMsgs[0] == MAX);
+    CHECK(left.msgs[0][0].cc == 2);
+    CHECK(left.msgs[0][2].cc == 1);
+    CHECK(left.msgs[0][2].value == 0);
+    CHECK(left.droppedMsgs[0] == 3 + 2);
+
+    // other tracks are untouched; clear() starts the count over
+    CHECK(left.droppedMsgs[1] == 0);
+    left.clear(0);
+    CHECK(left.numMsgs[0] == 0);
+    CHECK(left.droppedMsgs[0] == 0);
+}
@@ -0,0 +1,247 @@
+#define CATCH_CONFIG_MAIN
+
+#include "HarpOSC.hpp"
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Harp;
+using namespace Catch;
+
+static void appendString(std::string& packet, const std::string& s)
+{
+    packet += s;
+    packet.append(4 - s.size() % 4, '\0');
+}
+
+static void appendInt(std::string& packet, uint32_t v)
+{
+    packet += (char)(v >> 24);
+    packet += (char)(v >> 16);
+    packet += (char)(v >> 8);
+    packet += (char)v;
+}
+
+static std::string floatMessage(const std::string& address, float value)
+{
+    std::string packet;
+    appendString(packet, address);
+    appendString(packet, ",f");
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendInt(packet, bits);
+    return packet;
+}
+
+struct Parsed {
+    int string;
+    bool gate;
+    float value;
+};
+
+static std::vector<Parsed> parse(const std::string& packet, bool* ok = NULL)
+{
+    std::vector<Parsed> result;
+    bool r = parseOSCPacket(packet.data(), packet.size(), [&](int string, bool gate, float value) {
+        result.push_back(Parsed { string, gate, value });
+    });
+    if (ok) {
+        *ok = r;
+    }
+    return result;
+}
+
+TEST_CASE("osc: TouchOSC fader messages")
+{
+    auto p = parse(floatMessage("/1/fader1", 7.5f));
+    REQUIRE(p.size() == 1);
+    CHECK(p[0].string == 0);
+    CHECK(!p[0].gate);
+    CHECK(p[0].value == 7.5f);
+
+    p = parse(floatMessage("/1/fader2z", 1.f));
+    REQUIRE(p.size() == 1);
+    CHECK(p[0].string == 1);
+    CHECK(p[0].gate);
+    CHECK(p[0].value == 1.f);
+
+    // any page name, up to 16 faders:
+    p = parse(floatMessage("/harp/fader16", 3.f));
+    REQUIRE(p.size() == 1);
+    CHECK(p[0].string == 15);
+
+    // an int argument:
+    std::string packet;
+    appendString(packet, "/1/fader3z");
+    appendString(packet, ",i");
+    appendInt(packet, 1);
+    p = parse(packet);
+    REQUIRE(p.size() == 1);
+    CHECK(p[0].string == 2);
+    CHECK(p[0].value == 1.f);
+}
+
+TEST_CASE("osc: other messages are ignored")
+{
+    bool ok;
+    CHECK(parse(floatMessage("/1/fader17", 1.f), &ok).empty());
+    CHECK(ok);
+    CHECK(parse(floatMessage("/1/fader0", 1.f), &ok).empty());
+    CHECK(parse(floatMessage("/1/fader", 1.f), &ok).empty());
+    CHECK(parse(floatMessage("/1/fader1x", 1.f), &ok).empty());
+    CHECK(parse(floatMessage("/1/toggle1", 1.f), &ok).empty());
+    CHECK(parse(floatMessage("/fader1", 1.f), &ok).empty());
+    CHECK(parse(floatMessage("/1/fader1", NAN), &ok).empty());
+    CHECK(ok);
+}
+
+TEST_CASE("osc: malformed packets")
+{
+    bool ok;
+    std::string packet = floatMessage("/1/fader1", 1.f);
+    // truncated argument:
+    CHECK(parse(packet.substr(0, packet.size() - 2), &ok).empty());
+    CHECK(!ok);
+    // no type tags:
+    CHECK(parse(packet.substr(0, 12), &ok).empty());
+    CHECK(!ok);
+    // unterminated address:
+    CHECK(parse(std::string("/1/fader1"), &ok).empty());
+    CHECK(!ok);
+    CHECK(parse(std::string(), &ok).empty());
+    CHECK(!ok);
+}
+
+TEST_CASE("osc: bundles")
+{
+    std::string bundle;
+    appendString(bundle, "#bundle");
+    appendInt(bundle, 0);
+    appendInt(bundle, 1); // time tag "immediately"
+    for (int n = 1; n <= 3; n++) {
+        std::string m = floatMessage("/1/fader" + std::to_string(n), (float)n);
+        appendInt(bundle, m.size());
+        bundle += m;
+    }
+    bool ok;
+    auto p = parse(bundle, &ok);
+    CHECK(ok);
+    REQUIRE(p.size() == 3);
+    for (int i = 0; i < 3; i++) {
+        CHECK(p[i].string == i);
+        CHECK(p[i].value == (float)(i + 1));
+    }
+
+    // an element claiming to be longer than the packet:
+    std::string bad = bundle.substr(0, 16);
+    appendInt(bad, 1000);
+    bad += floatMessage("/1/fader1", 1.f);
+    CHECK(!parseOSCPacket(bad.data(), bad.size(), [](int, bool, float) {}));
+}
+
+TEST_CASE("osc: queue")
+{
+    SPSCQueue<int, 4> q;
+    int v;
+    CHECK(!q.pop(v));
+    for (int i = 0; i < 4; i++) {
+        CHECK(q.push(i));
+    }
+    CHECK(!q.push(4));
+    CHECK(q.dropped == 1);
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(q.pop(v));
+        CHECK(v == i);
+        CHECK(q.push(10 + i));
+    }
+    q.clear();
+    CHECK(q.front() == NULL);
+}
+
+TEST_CASE("osc: events are applied at their arrival time plus the jitter buffer")
+{
+    HarpOSC osc;
+    const float sampleRate = 1000.f;
+    const float jitter = 0.010f; // 10 frames
+    // three events 5 ms apart, all delivered in one burst:
+    for (int i = 0; i < 3; i++) {
+        osc.queue.push(OSCEvent { 100.0 + i * 0.005, i, false, (float)i });
+    }
+    std::vector<int64_t> applied;
+    for (int64_t frame = 50; frame < 100; frame++) {
+        osc.process(frame, sampleRate, jitter, [&](const OSCEvent& e) {
+            applied.push_back(frame);
+        });
+    }
+    REQUIRE(applied.size() == 3);
+    // the first one lines the clocks up a jitter buffer from when it's seen:
+    CHECK(applied[0] == 60);
+    // the rest keep their spacing:
+    CHECK(applied[1] == 65);
+    CHECK(applied[2] == 70);
+
+    // a late event (e.g. the engine stalled) re-syncs rather than being applied in the past:
+    osc.queue.push(OSCEvent { 100.02, 0, false, 0.f });
+    applied.clear();
+    for (int64_t frame = 200; frame < 250; frame++) {
+        osc.process(frame, sampleRate, jitter, [&](const OSCEvent& e) {
+            applied.push_back(frame);
+        });
+    }
+    REQUIRE(applied.size() == 1);
+    CHECK(applied[0] == 210);
+
+    // no jitter buffer: applied as soon as it's seen
+    osc.queue.push(OSCEvent { 100.03, 0, false, 0.f });
+    applied.clear();
+    osc.process(300, sampleRate, 0.f, [&](const OSCEvent& e) {
+        applied.push_back(300);
+    });
+    CHECK(applied.size() == 1);
+}
+
+TEST_CASE("osc: receive on localhost")
+{
+    HarpOSC osc;
+    const int port = 47123;
+    osc.start(port);
+    if (osc.status != HarpOSC::LISTENING) {
+        WARN("couldn't open port " << port << "; skipped");
+        return;
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    REQUIRE(sock >= 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    for (int n = 1; n <= 4; n++) {
+        std::string m = floatMessage("/1/fader" + std::to_string(n), n * 2.f);
+        sendto(sock, m.data(), m.size(), 0, (sockaddr*)&addr, sizeof(addr));
+    }
+    close(sock);
+
+    std::vector<OSCEvent> received;
+    for (int tries = 0; tries < 100 && received.size() < 4; tries++) {
+        OSCEvent e;
+        while (osc.queue.pop(e)) {
+            received.push_back(e);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    osc.stop();
+    CHECK(osc.status == HarpOSC::STOPPED);
+    REQUIRE(received.size() == 4);
+    for (int i = 0; i < 4; i++) {
+        CHECK(received[i].string == i);
+        CHECK(received[i].value == (i + 1) * 2.f);
+    }
+
+    // a port that's in use:
+    HarpOSC other;
+    osc.start(port);
+    other.start(port);
+    CHECK(other.status == HarpOSC::PORT_ERROR);
+}
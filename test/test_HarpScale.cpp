@@ -0,0 +1,95 @@
+#define CATCH_CONFIG_MAIN
+
+#include "HarpScale.hpp"
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Harp;
+using namespace Catch;
+
+TEST_CASE("harp: chromatic default spans a full octave")
+{
+    HarpScale hs;
+    hs.update(NULL, 0, 25, 0.f, 10.f);
+    // 25 notes over 0..10V: a bucket every 10/24 V
+    const float bucket = 10.f / 24.f;
+    CHECK(hs.process(0.f) == 0);
+    CHECK(hs.noteVoltage[0] == 0.f);
+    CHECK(hs.process(11 * bucket) == 11);
+    CHECK_THAT(hs.noteVoltage[11], WithinAbs(11 / 12.f, 0.0001));
+    // the 13th note is the next octave's C (not C#, as with an 11 note "chromatic" scale):
+    CHECK(hs.process(12 * bucket) == 12);
+    CHECK(hs.noteVoltage[12] == 1.f);
+    CHECK(hs.noteVoltage[24] == 2.f);
+}
+
+TEST_CASE("harp: scale input")
+{
+    float scale[3] = { 0.f, 4 / 12.f, 7 / 12.f };
+    HarpScale hs;
+    hs.update(scale, 3, 7, -5.f, 5.f);
+    CHECK(hs.noteVoltage[0] == 0.f);
+    CHECK(hs.noteVoltage[2] == 7 / 12.f);
+    CHECK(hs.noteVoltage[3] == 1.f);
+    CHECK(hs.noteVoltage[4] == 1.f + 4 / 12.f);
+    CHECK(hs.noteVoltage[6] == 2.f);
+    CHECK(hs.process(-5.f) == 0);
+    CHECK(hs.process(5.f) == 6);
+    // out of range CV stays on the end strings:
+    CHECK(hs.process(-10.f) == 0);
+    CHECK(hs.process(10.f) == 6);
+}
+
+TEST_CASE("harp: table is rebuilt only when something changes")
+{
+    float scale[2] = { 0.f, 0.5f };
+    HarpScale hs;
+    hs.update(scale, 2, 10, 0.f, 10.f);
+    CHECK(hs.matches(scale, 2, 10, 0.f, 10.f));
+    hs.hysteresis = 0.25f;
+    hs.process(5.f);
+    hs.update(scale, 2, 10, 0.f, 10.f);
+    CHECK(hs.bucket[0] >= 0); // not rebuilt
+
+    scale[1] = 0.6f;
+    CHECK(!hs.matches(scale, 2, 10, 0.f, 10.f));
+    hs.update(scale, 2, 10, 0.f, 10.f);
+    CHECK(hs.noteVoltage[1] == 0.6f);
+    CHECK(!hs.matches(scale, 2, 12, 0.f, 10.f));
+    CHECK(!hs.matches(scale, 2, 10, -5.f, 5.f));
+    CHECK(!hs.matches(NULL, 0, 10, 0.f, 10.f));
+}
+
+TEST_CASE("harp: hysteresis holds the bucket near a boundary")
+{
+    HarpScale hs;
+    hs.update(NULL, 0, 11, 0.f, 10.f); // a bucket per volt
+    // a noisy CV sitting on the 2/3 boundary:
+    const float noise[] = { 2.49f, 2.51f, 2.48f, 2.55f, 2.45f, 2.6f };
+
+    int changes = 0;
+    int last = hs.process(2.4f);
+    for (float v : noise) {
+        int b = hs.process(v);
+        changes += b != last;
+        last = b;
+    }
+    CHECK(changes > 2);
+
+    hs.hysteresis = 0.25f;
+    hs.release();
+    changes = 0;
+    last = hs.process(2.4f);
+    for (float v : noise) {
+        int b = hs.process(v);
+        changes += b != last;
+        last = b;
+    }
+    CHECK(changes == 0);
+    // a real move still changes the bucket:
+    CHECK(hs.process(2.8f) == 3);
+    CHECK(hs.process(2.3f) == 3);
+    CHECK(hs.process(2.2f) == 2);
+}
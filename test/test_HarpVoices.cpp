@@ -0,0 +1,227 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include "HarpVoices.hpp"
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Harp;
+using namespace Catch;
+
+static int gatesOpen(const HarpVoices& hv)
+{
+    int n = 0;
+    for (int v = 0; v < HarpVoices::NUM_VOICES; v++) {
+        n += hv.gate[v] > 0.f;
+    }
+    return n;
+}
+
+/* voices with an open gate or about to open one */
+static int voicesSounding(const HarpVoices& hv)
+{
+    int n = 0;
+    for (int v = 0; v < HarpVoices::NUM_VOICES; v++) {
+        n += hv.gate[v] > 0.f || hv.retrigger[v];
+    }
+    return n;
+}
+
+TEST_CASE("harp voices: a single string rotates through the voices")
+{
+    HarpScale hs;
+    hs.update(NULL, 0, 11, 0.f, 10.f); // a bucket per volt
+    HarpVoices hv;
+    float pitch[rack::PORT_MAX_CHANNELS] = {};
+    float gate[rack::PORT_MAX_CHANNELS] = {};
+
+    hv.process(hs, pitch, 1, gate, 0);
+    CHECK(hv.voice[0] == 0);
+    CHECK(hv.gate[0] == 10.f);
+    CHECK(hv.pitch[0] == 0.f);
+
+    // holding the note keeps the voice:
+    hv.process(hs, pitch, 1, gate, 0);
+    CHECK(hv.voice[0] == 0);
+
+    // each new note releases the old voice and takes the next:
+    for (int i = 1; i < 20; i++) {
+        pitch[0] = (float)(i % 2 + 1);
+        hv.process(hs, pitch, 1, gate, 0);
+        CHECK(hv.voice[0] == i % HarpVoices::NUM_VOICES);
+        CHECK(hv.gate[hv.voice[0]] == 10.f);
+        CHECK(hv.pitch[hv.voice[0]] == hs.noteVoltage[i % 2 + 1]);
+        CHECK(gatesOpen(hv) == 1);
+    }
+}
+
+TEST_CASE("harp voices: gate")
+{
+    HarpScale hs;
+    hs.update(NULL, 0, 11, 0.f, 10.f);
+    HarpVoices hv;
+    float pitch[rack::PORT_MAX_CHANNELS] = {};
+    float gate[rack::PORT_MAX_CHANNELS] = {};
+    pitch[0] = 3.f;
+
+    hv.process(hs, pitch, 1, gate, 1);
+    CHECK(hv.voice[0] == -1);
+    CHECK(gatesOpen(hv) == 0);
+
+    gate[0] = 10.f;
+    hv.process(hs, pitch, 1, gate, 1);
+    const int v = hv.voice[0];
+    CHECK(v >= 0);
+    CHECK(hv.pitch[v] == hs.noteVoltage[3]);
+
+    gate[0] = 0.f;
+    hv.process(hs, pitch, 1, gate, 1);
+    CHECK(hv.voice[0] == -1);
+    CHECK(hv.gate[v] == 0.f);
+    // the pitch stays put while the voice rings out:
+    CHECK(hv.pitch[v] == hs.noteVoltage[3]);
+    // the hysteresis state is forgotten on release:
+    CHECK(hs.bucket[0] == -1.f);
+}
+
+TEST_CASE("harp voices: polyphonic strings")
+{
+    HarpScale hs;
+    hs.update(NULL, 0, 11, 0.f, 10.f);
+    HarpVoices hv;
+    float pitch[rack::PORT_MAX_CHANNELS] = {};
+    float gate[rack::PORT_MAX_CHANNELS] = {};
+    for (int c = 0; c < 16; c++) {
+        pitch[c] = (float)(c % 11);
+        gate[c] = 10.f;
+    }
+
+    hv.process(hs, pitch, 16, gate, 16);
+    CHECK(gatesOpen(hv) == 16);
+    for (int c = 0; c < 16; c++) {
+        REQUIRE(hv.voice[c] >= 0);
+        CHECK(hv.pitch[hv.voice[c]] == hs.noteVoltage[c % 11]);
+    }
+
+    // release some strings, move others; every playing string still has its own voice:
+    gate[3] = 0.f;
+    gate[9] = 0.f;
+    pitch[5] = 9.f;
+    pitch[15] = 1.f;
+    hv.process(hs, pitch, 16, gate, 16);
+    // (the moved strings took the voices just released: their gates open next sample)
+    CHECK(voicesSounding(hv) == 14);
+    CHECK(hv.voice[3] == -1);
+    CHECK(hv.voice[9] == -1);
+    bool used[HarpVoices::NUM_VOICES] = {};
+    for (int c = 0; c < 16; c++) {
+        if (gate[c] > 0.f) {
+            REQUIRE(hv.voice[c] >= 0);
+            CHECK(!used[hv.voice[c]]);
+            used[hv.voice[c]] = true;
+            CHECK(hv.pitch[hv.voice[c]] == hs.noteVoltage[(int)pitch[c]]);
+        }
+    }
+
+    // a mono gate gates every string:
+    hv.process(hs, pitch, 16, gate, 1);
+    CHECK(gatesOpen(hv) == 16);
+
+    // dropping channels releases their strings:
+    hv.process(hs, pitch, 5, gate, 5);
+    CHECK(gatesOpen(hv) == 4); // string 3 is still gated off
+    CHECK(hv.voice[5] == -1);
+    CHECK(hs.bucket[5] == -1.f);
+}
+
+TEST_CASE("harp voices: a new note retriggers even with every string sounding")
+{
+    HarpScale hs;
+    hs.update(NULL, 0, 11, 0.f, 10.f);
+    HarpVoices hv;
+    float pitch[rack::PORT_MAX_CHANNELS] = {};
+    float gate[rack::PORT_MAX_CHANNELS] = {};
+    for (int c = 0; c < 16; c++) {
+        pitch[c] = (float)(c % 11);
+        gate[c] = 10.f;
+    }
+    hv.process(hs, pitch, 16, gate, 16);
+    hv.process(hs, pitch, 16, gate, 16);
+    CHECK(gatesOpen(hv) == 16);
+    REQUIRE(hv.freeCount == 0);
+
+    // string 7 plucks a new note: the only free voice is the one it just released
+    pitch[7] = 10.f;
+    hv.process(hs, pitch, 16, gate, 16);
+    const int v = hv.voice[7];
+    REQUIRE(v >= 0);
+    CHECK(hv.pitch[v] == hs.noteVoltage[10]);
+    // low for a sample...
+    CHECK(hv.gate[v] == 0.f);
+    CHECK(gatesOpen(hv) == 15);
+    // ...then high again
+    hv.process(hs, pitch, 16, gate, 16);
+    CHECK(hv.voice[7] == v);
+    CHECK(hv.gate[v] == 10.f);
+    CHECK(gatesOpen(hv) == 16);
+}
+
+TEST_CASE("harp voices: strings never run out of voices")
+{
+    HarpScale hs;
+    hs.update(NULL, 0, 48, 0.f, 10.f);
+    HarpVoices hv;
+    float pitch[rack::PORT_MAX_CHANNELS] = {};
+    float gate[rack::PORT_MAX_CHANNELS] = {};
+    uint32_t seed = 1;
+    for (int i = 0; i < 10000; i++) {
+        for (int c = 0; c < 16; c++) {
+            seed = seed * 1664525 + 1013904223;
+            pitch[c] = (seed >> 8) * (10.f / (1 << 24));
+            gate[c] = (seed & 7) ? 10.f : 0.f;
+        }
+        hv.process(hs, pitch, 1 + (i / 7) % 16, gate, 16);
+        // every voice is either free or sounding:
+        const bool accounted = hv.freeCount + voicesSounding(hv) == HarpVoices::NUM_VOICES;
+        REQUIRE(accounted);
+    }
+}
+
+TEST_CASE("harp voices", "[.][benchmark]")
+{
+    HarpScale hs;
+    hs.update(NULL, 0, 48, 0.f, 10.f);
+    HarpVoices hv;
+    float gate[rack::PORT_MAX_CHANNELS] = {};
+    for (int c = 0; c < 16; c++) {
+        gate[c] = 10.f;
+    }
+    // strings strumming across the strip at different speeds
+    static const int FRAMES = 4096;
+    static float frames[FRAMES][rack::PORT_MAX_CHANNELS];
+    for (int f = 0; f < FRAMES; f++) {
+        for (int c = 0; c < 16; c++) {
+            frames[f][c] = 5.f + 5.f * std::sin(f * 0.002f * (c + 1));
+        }
+    }
+    int f = 0;
+    auto strum = [&](int strings) {
+        f = (f + 1) % FRAMES;
+        hv.process(hs, frames[f], strings, gate, strings);
+        return hv.gate[0];
+    };
+    BENCHMARK("1 string")
+    {
+        return strum(1);
+    };
+    BENCHMARK("4 strings")
+    {
+        return strum(4);
+    };
+    BENCHMARK("16 strings")
+    {
+        return strum(16);
+    };
+}
@@ -85,3 +85,118 @@ TEST_CASE("inverter: chromatic")
     REQUIRE_THAT(C4 + 24 + 10, WithinAbs(voltageToMicroPitch(inv.invert(pitchToVoltage(C4 + 12), pitchToVoltage(C4 - 10))), epsilon));
     REQUIRE_THAT(C4 + 24 + 11, WithinAbs(voltageToMicroPitch(inv.invert(pitchToVoltage(C4 + 12), pitchToVoltage(C4 - 11))), epsilon));
 }
+
+#define C_MAJOR ((1 << 0) | (1 << 2) | (1 << 4) | (1 << 5) | (1 << 7) | (1 << 9) | (1 << 11))
+
+static float diatonic(PitchInverter& inv, int pivot, int note)
+{
+    return voltageToMicroPitch(inv.invert(pitchToVoltage(pivot), pitchToVoltage(note)));
+}
+
+TEST_CASE("inverter: diatonic")
+{
+    PitchInverter inv;
+    inv.reset();
+    inv.mode = PitchInverter::MODE_DIATONIC;
+    inv.setScale(C_MAJOR);
+
+    float epsilon = 0.0001f;
+
+    // around E4: a diatonic step up is mirrored as a diatonic step down
+    REQUIRE_THAT(E4, WithinAbs(diatonic(inv, E4, E4), epsilon));
+    REQUIRE_THAT(F4, WithinAbs(diatonic(inv, E4, D4), epsilon));
+    REQUIRE_THAT(D4, WithinAbs(diatonic(inv, E4, F4), epsilon));
+    REQUIRE_THAT(G4, WithinAbs(diatonic(inv, E4, C4), epsilon));
+    REQUIRE_THAT(A4, WithinAbs(diatonic(inv, E4, B3), epsilon));
+    REQUIRE_THAT(C3, WithinAbs(diatonic(inv, E4, G4 + 12), epsilon));
+    // in the next octaves
+    REQUIRE_THAT(G4 + 24, WithinAbs(diatonic(inv, E4 + 12, C4), epsilon));
+    REQUIRE_THAT(F4 - 24, WithinAbs(diatonic(inv, E4 - 24, D4 - 24), epsilon));
+
+    // notes out of the scale snap (up, when equidistant) to the scale first: pivot C#4 == D4
+    REQUIRE_THAT(F4, WithinAbs(diatonic(inv, C4 + 1, B3), epsilon));
+    REQUIRE_THAT(A3, WithinAbs(diatonic(inv, D4, F4 + 1), epsilon));
+}
+
+TEST_CASE("inverter: diatonic with no scale is chromatic")
+{
+    PitchInverter inv;
+    inv.reset();
+    inv.mode = PitchInverter::MODE_DIATONIC;
+
+    float epsilon = 0.0001f;
+
+    for (int note = C3; note <= C4 + 24; note++) {
+        REQUIRE_THAT(2 * E4 - note, WithinAbs(diatonic(inv, E4, note), epsilon));
+    }
+}
+
+// straightforward scale degree arithmetic, to check the reflection table against
+static int referenceDiatonic(const std::vector<int>& scale, int pivot, int note)
+{
+    // index (counting across octaves from C-1) of the scale note nearest to n, snapping up when equidistant
+    auto degree = [&](int n) {
+        int best = 0;
+        int bestDistance = 1000;
+        for (int octave = -1; octave < 12; octave++) {
+            for (size_t i = 0; i < scale.size(); i++) {
+                int s = 12 * octave + scale[i];
+                int distance = std::abs(s - n);
+                if (distance < bestDistance || (distance == bestDistance && s > n)) {
+                    best = (octave + 1) * scale.size() + i;
+                    bestDistance = distance;
+                }
+            }
+        }
+        return best;
+    };
+    int d = 2 * degree(pivot) - degree(note);
+    int octave = d / scale.size();
+    return 12 * (octave - 1) + scale[d % scale.size()];
+}
+
+TEST_CASE("inverter: diatonic matches scale degree arithmetic")
+{
+    std::vector<std::vector<int>> scales = {
+        { 0, 2, 4, 5, 7, 9, 11 }, // major
+        { 0, 3, 5, 7, 10 }, // minor pentatonic
+        { 1, 6 }, // sparse
+        { 4 }, // a single note
+    };
+    PitchInverter inv;
+    inv.reset();
+    inv.mode = PitchInverter::MODE_DIATONIC;
+    for (auto& scale : scales) {
+        int mask = 0;
+        for (int pc : scale) {
+            mask |= 1 << pc;
+        }
+        inv.setScale(mask);
+        for (int pivot = C4 - 12; pivot <= C4 + 12; pivot++) {
+            for (int note = C4 - 18; note <= C4 + 18; note++) {
+                // MIDI notes from C-1, as referenceDiatonic() counts:
+                REQUIRE(referenceDiatonic(scale, pivot + 12, note + 12) - 12 == (int)std::round(diatonic(inv, pivot, note)));
+            }
+        }
+    }
+}
+
+TEST_CASE("inverter: each lane has its own pivot")
+{
+    PitchInverter inv;
+    inv.reset();
+    inv.mode = PitchInverter::MODE_DIATONIC;
+    inv.setScale(C_MAJOR);
+
+    float_4 pivot(pitchToVoltage(C4), pitchToVoltage(E4), pitchToVoltage(G4), pitchToVoltage(C4 + 12));
+    float_4 note(pitchToVoltage(D4), pitchToVoltage(D4), pitchToVoltage(D4), pitchToVoltage(D4));
+    float_4 result = inv.invert(pivot, note);
+    for (int i = 0; i < 4; i++) {
+        CHECK(result[i] == inv.invert(pivot[i], note[i]));
+    }
+    float epsilon = 0.0001f;
+    REQUIRE_THAT(B3, WithinAbs(voltageToMicroPitch(result[0]), epsilon));
+    REQUIRE_THAT(F4, WithinAbs(voltageToMicroPitch(result[1]), epsilon));
+    REQUIRE_THAT(C4 + 12, WithinAbs(voltageToMicroPitch(result[2]), epsilon));
+    REQUIRE_THAT(B4 + 12, WithinAbs(voltageToMicroPitch(result[3]), epsilon));
+}
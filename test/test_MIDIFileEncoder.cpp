@@ -0,0 +1,108 @@
+#define CATCH_CONFIG_MAIN
+
+#include "MIDIFileEncoder.hpp"
+#include <sstream>
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace MIDIRecorder;
+using namespace Catch;
+
+static void addController(smf::MidiFile& midiFile, int tick, int cc, int value)
+{
+    midiFile.addController(0, tick, 0, cc, value);
+}
+
+static smf::MidiFile roundTrip(smf::MidiFile& midiFile, MIDIFileEncoder& encoder, size_t& size)
+{
+    std::stringstream out;
+    REQUIRE(encoder.write(midiFile, out));
+    size = out.str().size();
+    smf::MidiFile result;
+    std::stringstream in(out.str());
+    REQUIRE(result.read(in));
+    return result;
+}
+
+TEST_CASE("running status round trips")
+{
+    smf::MidiFile midiFile;
+    midiFile.setTPQ(960);
+    midiFile.addTempo(0, 0, 120.0);
+    for (int i = 0; i < 100; i++) {
+        addController(midiFile, i * 10, 2, i);
+    }
+    midiFile.addNoteOn(0, 1000, 0, 60, 100);
+    midiFile.addNoteOff(0, 1010, 0, 60);
+
+    std::stringstream plain;
+    midiFile.write(plain);
+
+    MIDIFileEncoder encoder;
+    size_t size;
+    smf::MidiFile result = roundTrip(midiFile, encoder, size);
+
+    CHECK(encoder.droppedEvents == 0);
+    // one status byte saved per controller after the first, and one for the note off (written by
+    // MidiFile as a 0x90 with zero velocity):
+    CHECK(size == plain.str().size() - 100);
+    REQUIRE(result.getNumTracks() == 1);
+    REQUIRE(result[0].size() == midiFile[0].size() + 1); // plus the end of track
+    for (int i = 0; i < midiFile[0].size(); i++) {
+        CHECK(result[0][i].tick == midiFile[0][i].tick);
+        CHECK((std::vector<smf::uchar>)result[0][i] == (std::vector<smf::uchar>)midiFile[0][i]);
+    }
+}
+
+TEST_CASE("identical controllers on the same tick are dropped")
+{
+    smf::MidiFile midiFile;
+    addController(midiFile, 0, 1, 64);
+    addController(midiFile, 0, 33, 10);
+    addController(midiFile, 0, 1, 64); // dropped
+    addController(midiFile, 0, 33, 10); // dropped
+    addController(midiFile, 5, 1, 64); // different tick - kept
+
+    MIDIFileEncoder encoder;
+    size_t size;
+    smf::MidiFile result = roundTrip(midiFile, encoder, size);
+
+    CHECK(encoder.droppedEvents == 2);
+    REQUIRE(result[0].size() == 4);
+    CHECK(result[0][2].tick == 5);
+    CHECK(result[0][2].getControllerNumber() == 1);
+}
+
+TEST_CASE("a new MSB forces the LSB to be resent")
+{
+    smf::MidiFile midiFile;
+    addController(midiFile, 0, 1, 64);
+    addController(midiFile, 0, 33, 10);
+    addController(midiFile, 0, 1, 65);
+    addController(midiFile, 0, 33, 10); // same LSB, but after a new MSB - kept
+
+    MIDIFileEncoder encoder;
+    size_t size;
+    smf::MidiFile result = roundTrip(midiFile, encoder, size);
+
+    CHECK(encoder.droppedEvents == 0);
+    CHECK(result[0].size() == 5);
+}
+
+TEST_CASE("meta events cancel running status")
+{
+    smf::MidiFile midiFile;
+    addController(midiFile, 0, 2, 1);
+    midiFile.addTempo(0, 0, 100.0);
+    addController(midiFile, 0, 2, 2);
+
+    MIDIFileEncoder encoder;
+    size_t size;
+    smf::MidiFile result = roundTrip(midiFile, encoder, size);
+
+    REQUIRE(result[0].size() == 4);
+    CHECK(result[0][2].isController());
+    CHECK(result[0][2].getControllerValue() == 2);
+}
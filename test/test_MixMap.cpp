@@ -0,0 +1,72 @@
+#define CATCH_CONFIG_MAIN
+
+#include "MixMap.hpp"
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Catch;
+
+static void voices(float* melody_v, float* harmony_v)
+{
+    for (int c = 0; c < rack::PORT_MAX_CHANNELS; c++) {
+        melody_v[c] = c;
+        harmony_v[c] = 100 + c;
+    }
+}
+
+TEST_CASE("mix: interleaved")
+{
+    float melody_v[rack::PORT_MAX_CHANNELS], harmony_v[rack::PORT_MAX_CHANNELS];
+    voices(melody_v, harmony_v);
+    MixMap mixMap;
+    rack::engine::Output output;
+
+    mixMap.update(3, MIX_INTERLEAVED);
+    mixMap.process(output, melody_v, harmony_v);
+    REQUIRE(output.getChannels() == 6);
+    CHECK(output.getVoltage(0) == 0);
+    CHECK(output.getVoltage(1) == 100);
+    CHECK(output.getVoltage(4) == 2);
+    CHECK(output.getVoltage(5) == 102);
+}
+
+TEST_CASE("mix: more than 8 voices never exceeds the channel limit")
+{
+    float melody_v[rack::PORT_MAX_CHANNELS], harmony_v[rack::PORT_MAX_CHANNELS];
+    voices(melody_v, harmony_v);
+    MixMap mixMap;
+    rack::engine::Output output;
+
+    for (int channels = 9; channels <= rack::PORT_MAX_CHANNELS; channels++) {
+        mixMap.update(channels, MIX_INTERLEAVED);
+        REQUIRE(mixMap.numChannels == rack::PORT_MAX_CHANNELS);
+        for (int m = 0; m < mixMap.numChannels; m++) {
+            CHECK(mixMap.voice[m] < 8);
+        }
+
+        mixMap.update(channels, MIX_CONCATENATED);
+        REQUIRE(mixMap.numChannels == rack::PORT_MAX_CHANNELS);
+        mixMap.process(output, melody_v, harmony_v);
+        REQUIRE(output.getChannels() == rack::PORT_MAX_CHANNELS);
+        // all the melody, then as many of the harmony voices as fit:
+        for (int m = 0; m < rack::PORT_MAX_CHANNELS; m++) {
+            CHECK(output.getVoltage(m) == (m < channels ? m : 100 + m - channels));
+        }
+    }
+}
+
+TEST_CASE("mix: mapping follows the channel count and mode")
+{
+    MixMap mixMap;
+    mixMap.update(4, MIX_CONCATENATED);
+    CHECK(mixMap.numChannels == 8);
+    CHECK(mixMap.voice[4] == 0);
+    CHECK(mixMap.harmony[4]);
+    mixMap.update(4, MIX_INTERLEAVED);
+    CHECK(mixMap.voice[4] == 2);
+    CHECK(!mixMap.harmony[4]);
+    mixMap.update(0, MIX_INTERLEAVED);
+    CHECK(mixMap.numChannels == 0);
+}
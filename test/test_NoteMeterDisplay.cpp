@@ -0,0 +1,204 @@
+#define CATCH_CONFIG_MAIN
+
+#include "NoteMeterDisplay.hpp"
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace NoteMeter;
+using namespace Catch;
+
+static std::string format(const NoteMeterDisplay& d, int i)
+{
+    char text[LABEL_TEXT_SIZE];
+    d.formatLabel(text, sizeof(text), i);
+    return text;
+}
+
+TEST_CASE("note meter: equal keys always format as equal text")
+{
+    NoteMeterDisplay d;
+    uint32_t seed = 1;
+    for (int mode = VOLTAGE_MODE_NOTENAME; mode <= VOLTAGE_MODE_VOCT_FREQUENCY; mode++) {
+        for (int decimals = 0; decimals <= 8; decimals++) {
+            d.setFormat(mode, decimals, 0);
+            // slowly drifting voltages, in steps a bit smaller and a bit larger than the display resolution
+            for (float step : { 1e-7f, 3e-5f, 1e-3f }) {
+                float v = -11.f + (seed % 1000) * 1e-3f;
+                d.setLabel(0, true, v);
+                std::string text = format(d, 0);
+                int64_t key = d.key[0];
+                for (int i = 0; i < 2000; i++) {
+                    seed = seed * 1664525 + 1013904223;
+                    v += step * ((seed >> 16) % 3);
+                    d.setLabel(0, true, v);
+                    std::string newText = format(d, 0);
+                    if (d.key[0] == key) {
+                        REQUIRE(newText == text);
+                    }
+                    text = newText;
+                    key = d.key[0];
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("note meter: a label changes only when its text does")
+{
+    NoteMeterDisplay d;
+    CHECK(d.setFormat(VOLTAGE_MODE_VOLTAGE, 2, 0));
+    CHECK(!d.setFormat(VOLTAGE_MODE_VOLTAGE, 2, 0));
+
+    CHECK(d.setLabel(0, true, 1.f));
+    CHECK(!d.setLabel(0, true, 1.f));
+    // below the display resolution:
+    CHECK(!d.setLabel(0, true, 1.001f));
+    CHECK(!d.setLabel(0, true, 1.004f));
+    CHECK(d.setLabel(0, true, 1.006f));
+    CHECK(format(d, 0) == " 1.01");
+    // -0.00 and 0.00 are different text:
+    CHECK(d.setLabel(0, true, 0.001f));
+    CHECK(d.setLabel(0, true, -0.001f));
+    CHECK(format(d, 0) == "-0.00");
+
+    CHECK(d.setLabel(0, false, 0.f));
+    CHECK(!d.setLabel(0, false, 0.f));
+    CHECK(format(d, 0) == "");
+
+    // note names: whole cents
+    d.setFormat(VOLTAGE_MODE_NOTENAME, 2, 0);
+    CHECK(d.setLabel(1, true, 0.f));
+    CHECK(format(d, 1) == "C4");
+    CHECK(!d.setLabel(1, true, 0.005f / 12));
+    CHECK(d.setLabel(1, true, 0.02f / 12));
+    CHECK(format(d, 1) == "C4 +2c");
+    // the accidental changes the text of every label:
+    CHECK(d.setFormat(VOLTAGE_MODE_NOTENAME, 2, 1));
+}
+
+TEST_CASE("note meter: changed labels")
+{
+    NoteMeterDisplay engine;
+    NoteMeterDisplay rendered;
+    engine.setFormat(VOLTAGE_MODE_VOLTAGE, 3, 0);
+    for (int i = 0; i < NUM_LABELS; i++) {
+        engine.setLabel(i, i < 8, i * 0.5f);
+    }
+    // nothing rendered yet, so everything:
+    CHECK(engine.changedLabels(rendered) == 0xffff);
+    rendered = engine;
+    CHECK(engine.changedLabels(rendered) == 0);
+
+    engine.setLabel(2, true, 1.0001f); // below the resolution
+    engine.setLabel(3, true, 5.f);
+    engine.setLabel(7, false, 0.f);
+    engine.setLabel(9, true, 1.f);
+    CHECK(engine.changedLabels(rendered) == ((1 << 3) | (1 << 7) | (1 << 9)));
+    rendered = engine;
+
+    engine.setFormat(VOLTAGE_MODE_VOLTAGE, 4, 0);
+    CHECK(engine.changedLabels(rendered) == 0xffff);
+}
+
+TEST_CASE("note meter: out of range values")
+{
+    NoteMeterDisplay d;
+    d.setFormat(VOLTAGE_MODE_VOLTAGE, 8, 0);
+    CHECK(d.setLabel(0, true, 1e12f));
+    CHECK(d.setLabel(0, true, 1.0000001e12f));
+    CHECK(d.setLabel(0, true, INFINITY));
+    CHECK(d.setLabel(0, true, NAN));
+    CHECK(!d.setLabel(0, true, NAN));
+    d.setFormat(VOLTAGE_MODE_VOCT_FREQUENCY, 8, 0);
+    CHECK(d.setLabel(0, true, 200.f));
+    CHECK(format(d, 0) == " inf");
+}
+
+TEST_CASE("note meter: chord mode")
+{
+    NoteMeterDisplay d;
+    char text[CHORD_TEXT_SIZE];
+    d.setFormat(VOLTAGE_MODE_CHORD, 2, 0);
+    // E3 G3 B3 C4: Cmaj7 over E
+    const float notes[] = { -8.f / 12, -5.f / 12, -1.f / 12, 0.f };
+    for (int i = 0; i < 4; i++) {
+        d.setLabel(i, true, notes[i]);
+    }
+    CHECK(d.updateChord());
+    CHECK(!d.updateChord());
+    d.formatChord(text, sizeof(text));
+    CHECK(std::string(text) == "Cmaj7/E");
+    // labels still show the notes:
+    CHECK(format(d, 0) == "E3");
+
+    // a few cents out doesn't change the chord:
+    d.setLabel(2, true, -1.f / 12 + 0.1f / 12);
+    CHECK(!d.updateChord());
+    // nor does the order of the inputs:
+    d.setLabel(0, true, 0.f);
+    d.setLabel(3, true, -8.f / 12);
+    CHECK(!d.updateChord());
+
+    // without the C:
+    d.setLabel(0, false, 0.f);
+    CHECK(d.updateChord());
+    d.formatChord(text, sizeof(text));
+    CHECK(std::string(text) == "Em");
+
+    for (int i = 0; i < NUM_LABELS; i++) {
+        d.setLabel(i, false, 0.f);
+    }
+    CHECK(d.updateChord());
+    d.formatChord(text, sizeof(text));
+    CHECK(std::string(text) == "");
+
+    // no chord outside chord mode:
+    d.setLabel(0, true, 0.f);
+    d.setFormat(VOLTAGE_MODE_NOTENAME, 2, 0);
+    d.updateChord();
+    CHECK(d.chord == -1);
+    d.formatChord(text, sizeof(text));
+    CHECK(std::string(text) == "");
+}
+
+TEST_CASE("note meter: tuner mode")
+{
+    NoteMeterDisplay d;
+    d.setFormat(VOLTAGE_MODE_TUNER, 2, 0);
+    // a detected pitch: A4 a few cents sharp
+    CHECK(d.setLabel(0, true, std::log2(441.f / 261.625565f)));
+    CHECK(format(d, 0) == "A4 +3c");
+    // no pitch detected
+    CHECK(d.setLabel(0, true, NAN));
+    CHECK(!d.setLabel(0, true, NAN));
+    CHECK(format(d, 0) == "-");
+    CHECK(d.setLabel(0, true, std::log2(441.f / 261.625565f)));
+}
+
+TEST_CASE("note meter: statistics mode")
+{
+    NoteMeterDisplay d;
+    NoteMeterDisplay rendered;
+    d.setFormat(VOLTAGE_MODE_STATISTICS, 2, 0);
+    // around A4 (69): mean 3.14 cents sharp, min 1.2 cents flat, max 6 cents sharp
+    CHECK(d.setStatistics(0, true, 69.0314f, 0.0042f, 68.988f, 69.06f));
+    CHECK(format(d, 0) == "A4 +3.1c \xc2\xb1"
+                          "0.4\n-1.2 .. +6.0c");
+    rendered = d;
+    // below the display resolution:
+    CHECK(!d.setStatistics(0, true, 69.03141f, 0.0042f, 68.988f, 69.06f));
+    CHECK(d.changedLabels(rendered) == 0);
+    CHECK(d.setStatistics(0, true, 69.0314f, 0.0052f, 68.988f, 69.06f));
+    CHECK(d.changedLabels(rendered) == 1);
+
+    // the nearest note to the mean; flats
+    d.setFormat(VOLTAGE_MODE_STATISTICS, 2, 1);
+    d.setStatistics(1, true, 69.6f, 0.f, 69.6f, 69.6f);
+    CHECK(format(d, 1) == "Bb4 -40.0c \xc2\xb1"
+                          "0.0\n-40.0 .. -40.0c");
+
+    CHECK(d.setStatistics(1, false, 0.f, 0.f, 0.f, 0.f));
+    CHECK(format(d, 1) == "");
+}
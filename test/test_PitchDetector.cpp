@@ -0,0 +1,151 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include "PitchDetector.hpp"
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Catch;
+
+static float cents(float frequency, float expected)
+{
+    return 1200.f * std::log2(frequency / expected);
+}
+
+// a band limited sawtooth, +/-5V
+static float saw(double phase, float frequency, float sampleRate)
+{
+    float v = 0.f;
+    for (int h = 1; h * frequency < sampleRate / 2; h++) {
+        v += std::sin(2 * M_PI * h * phase) / h;
+    }
+    return 5.f * 2.f / M_PI * v;
+}
+
+/* run the detector for the given number of seconds, each channel's sample from f(channel, time) */
+template <typename F>
+static void run(PitchDetector& d, float seconds, F f)
+{
+    float in[PitchDetector::CHANNELS];
+    const int frames = seconds * d.sampleRate;
+    for (int i = 0; i < frames; i++) {
+        const double t = i / (double)d.sampleRate;
+        for (int c = 0; c < PitchDetector::CHANNELS; c++) {
+            in[c] = f(c, t);
+        }
+        d.process(in);
+    }
+}
+
+TEST_CASE("pitch detector: sine waves")
+{
+    for (float sampleRate : { 44100.f, 48000.f, 96000.f }) {
+        PitchDetector d;
+        d.setSampleRate(sampleRate);
+        d.active[0] = true;
+        for (float f : { 30.f, 55.f, 110.f, 261.63f, 440.f, 1000.f, 1760.f }) {
+            run(d, 0.3f, [&](int c, double t) { return 5.f * std::sin(2 * M_PI * f * t); });
+            INFO(sampleRate << " Hz: " << f << " Hz detected as " << d.frequency[0]);
+            REQUIRE(d.frequency[0] > 0.f);
+            CHECK_THAT(cents(d.frequency[0], f), WithinAbs(0.f, f < 1000.f ? 1.f : 3.f));
+            CHECK(d.clarity[0] > 0.9f);
+        }
+    }
+}
+
+TEST_CASE("pitch detector: harmonics don't confuse it")
+{
+    PitchDetector d;
+    d.setSampleRate(48000.f);
+    d.active[0] = true;
+    for (float f : { 41.2f, 82.4f, 220.f, 659.3f }) {
+        run(d, 0.3f, [&](int c, double t) { return saw(t * f, f, 48000.f); });
+        INFO(f << " Hz detected as " << d.frequency[0]);
+        REQUIRE(d.frequency[0] > 0.f);
+        CHECK_THAT(cents(d.frequency[0], f), WithinAbs(0.f, 2.f));
+    }
+    // a square-ish wave with a weak fundamental:
+    run(d, 0.3f, [&](int c, double t) {
+        return std::sin(2 * M_PI * 110 * t) + 3.f * std::sin(2 * M_PI * 220 * t) + 2.f * std::sin(2 * M_PI * 330 * t);
+    });
+    CHECK_THAT(cents(d.frequency[0], 110.f), WithinAbs(0.f, 2.f));
+}
+
+TEST_CASE("pitch detector: 16 channels at once")
+{
+    PitchDetector d;
+    d.setSampleRate(48000.f);
+    for (int c = 0; c < PitchDetector::CHANNELS; c++) {
+        d.active[c] = true;
+    }
+    // a chromatic scale up from A2, one note per channel
+    auto pitch = [](int c) { return 110.f * std::pow(2.f, c / 12.f); };
+    run(d, 0.5f, [&](int c, double t) { return 5.f * std::sin(2 * M_PI * pitch(c) * t); });
+    for (int c = 0; c < PitchDetector::CHANNELS; c++) {
+        INFO("channel " << c);
+        CHECK_THAT(cents(d.frequency[c], pitch(c)), WithinAbs(0.f, 1.f));
+        // as V/oct:
+        CHECK_THAT(d.pitchVoltage(c), WithinAbs((c - 3) / 12.f - 1.f, 0.001f));
+    }
+}
+
+TEST_CASE("pitch detector: no pitch")
+{
+    PitchDetector d;
+    d.setSampleRate(48000.f);
+    d.active[0] = true;
+    d.active[1] = true;
+    d.active[2] = true;
+    uint32_t seed = 1;
+    run(d, 0.5f, [&](int c, double t) {
+        switch (c) {
+        case 0:
+            return 0.f;
+        case 1:
+            // white noise
+            seed = seed * 1664525 + 1013904223;
+            return 5.f * ((seed >> 8) / (float)(1 << 24) - 0.5f);
+        case 2:
+            // a DC offset is silence too
+            return 3.f;
+        default:
+            return 5.f * (float)std::sin(2 * M_PI * 440 * t);
+        }
+    });
+    CHECK(d.frequency[0] == 0.f);
+    CHECK(std::isnan(d.pitchVoltage(0)));
+    CHECK(d.frequency[1] == 0.f);
+    CHECK(d.frequency[2] == 0.f);
+    // inactive channels aren't analysed:
+    CHECK(d.frequency[3] == 0.f);
+
+    // a pitch comes and goes:
+    run(d, 0.3f, [&](int c, double t) { return 5.f * (float)std::sin(2 * M_PI * 440 * t); });
+    CHECK(d.frequency[0] > 0.f);
+    run(d, 0.3f, [&](int c, double t) { return 0.f; });
+    CHECK(d.frequency[0] == 0.f);
+}
+
+TEST_CASE("pitch detector: benchmark", "[.][benchmark]")
+{
+    PitchDetector d;
+    d.setSampleRate(48000.f);
+    for (int c = 0; c < PitchDetector::CHANNELS; c++) {
+        d.active[c] = true;
+    }
+    std::vector<float> audio(48000 * PitchDetector::CHANNELS);
+    for (int i = 0; i < 48000; i++) {
+        for (int c = 0; c < PitchDetector::CHANNELS; c++) {
+            audio[i * PitchDetector::CHANNELS + c] = 5.f * std::sin(2 * M_PI * (100 + 20 * c) * i / 48000.0);
+        }
+    }
+    BENCHMARK("16 channels, 1 second at 48 kHz")
+    {
+        for (int i = 0; i < 48000; i++) {
+            d.process(&audio[i * PitchDetector::CHANNELS]);
+        }
+        return d.frequency[0];
+    };
+}
@@ -1,4 +1,5 @@
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 
 #include "PitchNote.hpp"
 #undef WARN
@@ -217,3 +218,117 @@ TEST_CASE("pitch string octaves - w/ deviations")
     pitchToText(str, voltageToPitch(10.f), 0.4f);
     CHECK("C14 +40c" == str);
 }
+
+TEST_CASE("pitch string flats")
+{
+    std::string str;
+    pitchToText(str, 61, 0.f, FLAT);
+    CHECK("Db4" == str);
+    pitchToText(str, 70, 0.2f, FLAT);
+    CHECK("Bb4 +20c" == str);
+    pitchToText(str, 66, 0.f, SHARP);
+    CHECK("F#4" == str);
+}
+
+TEST_CASE("pitch string negative octaves")
+{
+    std::string str;
+    pitchToText(str, PITCH_NOTE_MIN + 1, 0.f); // one semitone above C-6
+    CHECK("C#-6" == str);
+    pitchToText(str, PITCH_NOTE_MIN - 1, 0.f);
+    CHECK("B-7" == str);
+    pitchToText(str, 11, -0.3f);
+    CHECK("B-1 -30c" == str);
+}
+
+TEST_CASE("pitch string into a fixed buffer")
+{
+    char buff[PITCH_TEXT_SIZE];
+    CHECK(pitchToText(buff, sizeof(buff), 61, 0.49f) == 8);
+    CHECK(std::string("C#4 +49c") == buff);
+    CHECK(pitchToText(buff, sizeof(buff), 60, 0.f, FLAT) == 2);
+    CHECK(std::string("C4") == buff);
+    // truncated to fit:
+    CHECK(pitchToText(buff, 4, 61, 0.49f) == 3);
+    CHECK(std::string("C#4") == buff);
+    CHECK(pitchToText(buff, 0, 61, 0.49f) == 0);
+}
+
+// the original implementation, for comparison: builds the name table and formats through
+// rack::string::f on every call
+static void stringPitchToText(std::string& text, int note, float noteDeviation, NoteAccidental accidentalMode)
+{
+    int n = std::round(note + noteDeviation);
+    float nDeviation = noteDeviation - (n - note);
+    std::vector<std::string> noteNames;
+    if (accidentalMode == SHARP) {
+        noteNames = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+    } else {
+        noteNames = { "C", "Db", "D", "Eb", "E", "F", "Gb", "G", "Ab", "A", "Bb", "B" };
+    }
+    int nameIndex = (1200 + n) % 12;
+    int octave = (n / 12) - 1;
+    auto absDeviation = std::abs(nDeviation);
+    if (absDeviation >= 0.01f) {
+        text = rack::string::f("%s%d %s%dc", noteNames[nameIndex].c_str(), octave,
+            (nDeviation > 0 ? "+" : "-"),
+            (int)(absDeviation * 100));
+    } else {
+        text = rack::string::f("%s%d", noteNames[nameIndex].c_str(), octave);
+    }
+}
+
+TEST_CASE("pitch string matches the original formatting")
+{
+    std::string expected, str;
+    for (int note = 0; note <= PITCH_NOTE_MAX; note++) {
+        for (float deviation = -0.45f; deviation < 0.5f; deviation += 0.15f) {
+            stringPitchToText(expected, note, deviation, SHARP);
+            pitchToText(str, note, deviation, SHARP);
+            REQUIRE(expected == str);
+            stringPitchToText(expected, note, deviation, FLAT);
+            pitchToText(str, note, deviation, FLAT);
+            REQUIRE(expected == str);
+        }
+    }
+}
+
+TEST_CASE("pitch string formatting", "[.][benchmark]")
+{
+    // a NoteMeter's worth of labels
+    int notes[16];
+    float deviations[16];
+    for (int i = 0; i < 16; i++) {
+        notes[i] = 40 + 3 * i;
+        deviations[i] = (i % 3) * 0.17f;
+    }
+    BENCHMARK("original (allocating), 16 labels")
+    {
+        std::string text;
+        size_t total = 0;
+        for (int i = 0; i < 16; i++) {
+            stringPitchToText(text, notes[i], deviations[i], SHARP);
+            total += text.size();
+        }
+        return total;
+    };
+    BENCHMARK("std::string, 16 labels")
+    {
+        std::string text;
+        size_t total = 0;
+        for (int i = 0; i < 16; i++) {
+            pitchToText(text, notes[i], deviations[i], SHARP);
+            total += text.size();
+        }
+        return total;
+    };
+    BENCHMARK("char buffer, 16 labels")
+    {
+        char text[16][PITCH_TEXT_SIZE];
+        size_t total = 0;
+        for (int i = 0; i < 16; i++) {
+            total += pitchToText(text[i], PITCH_TEXT_SIZE, notes[i], deviations[i], SHARP);
+        }
+        return total;
+    };
+}
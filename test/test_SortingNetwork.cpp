@@ -0,0 +1,257 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include "SortingNetwork.hpp"
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Catch;
+
+TEST_CASE("sorting network: every network sorts every input of 0s and 1s")
+{
+    // by the 0-1 principle, that means it sorts anything
+    for (int n = 0; n <= SortingNetwork::MAX_CHANNELS; n++) {
+        INFO("n = " << n);
+        for (int c = 0; c <= SortingNetwork::OFFSET[n + 1] - SortingNetwork::OFFSET[n] - 1; c++) {
+            const uint8_t* pair = SortingNetwork::PAIRS[SortingNetwork::OFFSET[n] + c];
+            REQUIRE(pair[0] < pair[1]);
+            REQUIRE(pair[1] < n);
+            if (c > 0) {
+                // a repeated compare-exchange does nothing
+                const uint8_t* previous = SortingNetwork::PAIRS[SortingNetwork::OFFSET[n] + c - 1];
+                REQUIRE((pair[0] != previous[0] || pair[1] != previous[1]));
+            }
+        }
+        bool sorted = true;
+        for (uint32_t bits = 0; bits < (1u << n); bits++) {
+            float v[SortingNetwork::MAX_CHANNELS];
+            for (int i = 0; i < n; i++) {
+                v[i] = (bits >> i) & 1;
+            }
+            SortingNetwork::sort(n, v, SortingNetwork::Ascending());
+            for (int i = 1; i < n; i++) {
+                sorted = sorted && v[i - 1] <= v[i];
+            }
+        }
+        CHECK(sorted);
+    }
+}
+
+TEST_CASE("sorting network: same as std::sort")
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> voltage(-10.f, 10.f);
+    for (int n = 0; n <= SortingNetwork::MAX_CHANNELS; n++) {
+        for (int t = 0; t < 100; t++) {
+            SortingNetwork::Keyed v[SortingNetwork::MAX_CHANNELS];
+            float plain[SortingNetwork::MAX_CHANNELS];
+            std::vector<std::pair<float, float>> expected;
+            for (int i = 0; i < n; i++) {
+                plain[i] = voltage(random);
+                v[i] = SortingNetwork::keyed(plain[i], i);
+                expected.push_back(std::make_pair(plain[i], (float)i));
+            }
+            std::sort(expected.begin(), expected.end());
+            SortingNetwork::sort(n, v, SortingNetwork::ByKey());
+            SortingNetwork::sort(n, plain, SortingNetwork::Ascending());
+            for (int i = 0; i < n; i++) {
+                // the values go with their keys
+                REQUIRE(SortingNetwork::keyOf(v[i]) == expected[i].first);
+                REQUIRE(SortingNetwork::valueOf(v[i]) == expected[i].second);
+                REQUIRE(plain[i] == expected[i].first);
+            }
+        }
+    }
+}
+
+TEST_CASE("sorting network: link keys of 0 stay in place")
+{
+    SortingNetwork::Keyed v[8];
+    const float keys[] = { 3.f, 0.f, 1.f, 0.f, 2.f, 0.f, 0.f, 0.f };
+    for (int i = 0; i < 8; i++) {
+        v[i] = SortingNetwork::keyed(keys[i], i);
+    }
+    SortingNetwork::sort(8, v, SortingNetwork::ByLinkKey());
+    // every value is still there once
+    bool seen[8] = {};
+    for (int i = 0; i < 8; i++) {
+        const float value = SortingNetwork::valueOf(v[i]);
+        REQUIRE(value >= 0.f);
+        REQUIRE(value < 8.f);
+        CHECK(!seen[(int)value]);
+        seen[(int)value] = true;
+    }
+    // the linked channels, in order
+    std::vector<float> linked;
+    for (int i = 0; i < 8; i++) {
+        if (SortingNetwork::keyOf(v[i]) != 0.f) {
+            linked.push_back(SortingNetwork::keyOf(v[i]));
+        }
+    }
+    CHECK(linked == std::vector<float>({ 1.f, 2.f, 3.f }));
+
+    // with no 0 keys, a plain sort
+    const float moreKeys[] = { 3.f, -1.f, 1.f, 4.f, 2.f };
+    for (int i = 0; i < 5; i++) {
+        v[i] = SortingNetwork::keyed(moreKeys[i], i);
+    }
+    SortingNetwork::sort(5, v, SortingNetwork::ByLinkKey());
+    const float expected[] = { -1.f, 1.f, 2.f, 3.f, 4.f };
+    for (int i = 0; i < 5; i++) {
+        CHECK(SortingNetwork::keyOf(v[i]) == expected[i]);
+    }
+}
+
+TEST_CASE("sorting network: keyed values order as their keys")
+{
+    const float keys[] = { -INFINITY, -10.f, -1.f, -1e-30f, 0.f, 1e-30f, 1.f, 10.f, INFINITY };
+    for (int i = 0; i < 9; i++) {
+        const SortingNetwork::Keyed k = SortingNetwork::keyed(keys[i], -2.5f);
+        CHECK(SortingNetwork::keyOf(k) == keys[i]);
+        CHECK(SortingNetwork::valueOf(k) == -2.5f);
+        if (i > 0) {
+            // whatever the values
+            CHECK(SortingNetwork::keyed(keys[i - 1], 1.f) < SortingNetwork::keyed(keys[i], -1.f));
+        }
+    }
+    // -0 is 0
+    CHECK(SortingNetwork::keyed(-0.f, 1.f) == SortingNetwork::keyed(0.f, 1.f));
+}
+
+TEST_CASE("sorting network: four sorts at once")
+{
+    std::mt19937 random(2);
+    std::uniform_int_distribution<int> voltage(-3, 3);
+    for (int t = 0; t < 1000; t++) {
+        // each lane's channel count; the rest padded with +INF
+        const int channels[4] = { 16, 5, 0, 11 };
+        float key[4][16];
+        SortingNetwork::KeyedLanes v[16];
+        for (int ch = 0; ch < 16; ch++) {
+            for (int lane = 0; lane < 4; lane++) {
+                // few distinct values, so plenty of ties
+                key[lane][ch] = ch < channels[lane] ? (float)voltage(random) : INFINITY;
+                v[ch].key[lane] = key[lane][ch];
+            }
+            v[ch].value = ch;
+        }
+        SortingNetwork::sort(16, v, SortingNetwork::ByKeyLanes());
+        for (int lane = 0; lane < 4; lane++) {
+            // by key, then channel: a stable sort
+            std::array<int, 16> expected;
+            for (int ch = 0; ch < 16; ch++) {
+                expected[ch] = ch;
+            }
+            std::stable_sort(expected.begin(), expected.end(), [&](int a, int b) {
+                return key[lane][a] < key[lane][b];
+            });
+            for (int ch = 0; ch < 16; ch++) {
+                REQUIRE(v[ch].key[lane] == key[lane][expected[ch]]);
+                REQUIRE(v[ch].value[lane] == expected[ch]);
+            }
+        }
+    }
+}
+
+TEST_CASE("sorting network: benchmark", "[.][benchmark]")
+{
+    // a different input each run, so std::sort can't learn its branches - from enough of them that
+    // the branch predictor can't learn the whole sequence either (64 inputs, it does)
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> voltage(-10.f, 10.f);
+    std::vector<std::array<std::array<float, 2>, 16>> inputs(1024);
+    for (auto& input : inputs) {
+        for (int ch = 0; ch < 16; ch++) {
+            input[ch][0] = voltage(random);
+            input[ch][1] = voltage(random);
+        }
+    }
+    int next = 0;
+
+    for (int n : { 4, 16 }) {
+        for (bool useLink : { false, true }) {
+            const std::string name = std::to_string(n) + " channels" + (useLink ? ", linked" : "");
+            // as SplitSort / MergeSort sorted before
+            BENCHMARK("std::sort, " + name)
+            {
+                std::array<std::array<float, 2>, 16> sorted = inputs[next++ & 1023];
+                std::sort(sorted.begin(), sorted.begin() + n,
+                    [useLink](const std::array<float, 2>& a, const std::array<float, 2>& b) {
+                        if (useLink) {
+                            if (a[1] == 0.0f) {
+                                return false;
+                            } else {
+                                return a[1] < b[1];
+                            }
+                        } else {
+                            return a[0] < b[0];
+                        }
+                    });
+                return sorted[0][0];
+            };
+            BENCHMARK("sorting network, " + name)
+            {
+                const std::array<std::array<float, 2>, 16>& input = inputs[next++ & 1023];
+                if (useLink) {
+                    SortingNetwork::Keyed sorted[16];
+                    for (int ch = 0; ch < n; ch++) {
+                        sorted[ch] = SortingNetwork::keyed(input[ch][1], input[ch][0]);
+                    }
+                    SortingNetwork::sort(n, sorted, SortingNetwork::ByLinkKey());
+                    return SortingNetwork::valueOf(sorted[0]);
+                } else {
+                    float sorted[16];
+                    for (int ch = 0; ch < 16; ch++) {
+                        sorted[ch] = input[ch][0];
+                    }
+                    SortingNetwork::sort(n, sorted, SortingNetwork::Ascending());
+                    return sorted[0];
+                }
+            };
+        }
+    }
+
+    // as PolySort sorts four unlinked inputs of 16 channels
+    BENCHMARK("std::sort, 4 inputs of 16 channels")
+    {
+        const std::array<std::array<float, 2>, 16>& input = inputs[next++ & 1023];
+        float sum = 0.f;
+        for (int i = 0; i < 4; i++) {
+            std::array<std::pair<float, int>, 16> sorted;
+            for (int ch = 0; ch < 16; ch++) {
+                sorted[ch] = std::make_pair(input[ch][i & 1] + i, ch);
+            }
+            std::sort(sorted.begin(), sorted.end(),
+                [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+                    return a.first < b.first;
+                });
+            sum += sorted[0].second;
+        }
+        return sum;
+    };
+    BENCHMARK("sorting network, 4 inputs of 16 channels")
+    {
+        const std::array<std::array<float, 2>, 16>& input = inputs[next++ & 1023];
+        SortingNetwork::KeyedLanes sorted[16];
+        for (int ch = 0; ch < 16; ch++) {
+            float key[4];
+            for (int i = 0; i < 4; i++) {
+                key[i] = input[ch][i & 1] + i;
+            }
+            sorted[ch].key = rack::simd::float_4::load(key);
+            sorted[ch].value = ch;
+        }
+        SortingNetwork::sort(16, sorted, SortingNetwork::ByKeyLanes());
+        float sum = 0.f;
+        for (int i = 0; i < 4; i++) {
+            sum += sorted[0].value[i];
+        }
+        return sum;
+    };
+}
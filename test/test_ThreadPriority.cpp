@@ -0,0 +1,170 @@
+#define CATCH_CONFIG_MAIN
+
+#include "MidiFile.h"
+#include "ThreadPriority.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#undef WARN
+
+#include "catch.hpp"
+
+using namespace Chinenual;
+using namespace Catch;
+
+TEST_CASE("default priority can always be applied")
+{
+    bool ok = false;
+    std::thread t([&] {
+        ok = ThreadPriority().apply();
+    });
+    t.join();
+    CHECK(ok);
+}
+
+#ifdef ARCH_LIN
+TEST_CASE("policy and nice are applied to the calling thread only")
+{
+    ThreadPriority p;
+    p.policy = THREAD_POLICY_IDLE;
+    p.nice = 10;
+    bool ok = false;
+    int sched = -1;
+    int nice = -1;
+    std::thread t([&] {
+        ok = p.apply();
+        sched = sched_getscheduler(0);
+        nice = getpriority(PRIO_PROCESS, (pid_t)syscall(SYS_gettid));
+    });
+    t.join();
+    CHECK(ok);
+    CHECK(sched == SCHED_IDLE);
+    CHECK(nice == 10);
+    // the test's own thread is untouched:
+    CHECK(sched_getscheduler(0) == SCHED_OTHER);
+}
+
+TEST_CASE("the affinity is only changed when pinning, and only within the allowed CPUs")
+{
+    cpu_set_t allowed;
+    REQUIRE(pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed) == 0);
+    // as if run under taskset: every allowed CPU but the last
+    cpu_set_t narrowed = allowed;
+    int last = CPU_SETSIZE - 1;
+    while (!CPU_ISSET(last, &allowed)) {
+        last--;
+    }
+    if (CPU_COUNT(&allowed) > 1) {
+        CPU_CLR(last, &narrowed);
+    }
+    int expectedPinned = CPU_SETSIZE - 1;
+    while (!CPU_ISSET(expectedPinned, &narrowed)) {
+        expectedPinned--;
+    }
+
+    for (bool pin : { false, true }) {
+        ThreadPriority p;
+        p.policy = THREAD_POLICY_BATCH;
+        p.nice = 5;
+        p.pinToLastCPU = pin;
+        bool ok = false;
+        cpu_set_t after;
+        std::thread t([&] {
+            pthread_setaffinity_np(pthread_self(), sizeof(narrowed), &narrowed);
+            ok = p.apply();
+            pthread_getaffinity_np(pthread_self(), sizeof(after), &after);
+        });
+        t.join();
+        CHECK(ok);
+        if (pin) {
+            CHECK(CPU_COUNT(&after) == 1);
+            CHECK(CPU_ISSET(expectedPinned, &after));
+        } else {
+            CHECK(CPU_EQUAL(&after, &narrowed));
+        }
+    }
+}
+#endif
+
+// Simulates an engine thread processing 1ms blocks while every other core is busy flushing a large
+// take into a MidiFile (the work done by the MIDIBuffer worker and the file writer).  Reports how
+// late the engine thread wakes for each block.  Hidden by default: run with "[benchmark]".
+
+struct Jitter {
+    double p99;
+    double max;
+};
+
+static void flushLargeTake(const std::atomic<bool>& done)
+{
+    while (!done) {
+        smf::MidiFile midiFile;
+        midiFile.addTracks(16);
+        for (int i = 0; i < 200000 && !done; i++) {
+            midiFile.addNoteOn(i % 16, i, 0, 60 + (i % 12), 100);
+            midiFile.addNoteOff(i % 16, i + 10, 0, 60 + (i % 12));
+        }
+        midiFile.sortTracks();
+    }
+}
+
+static Jitter measureJitter(const ThreadPriority& background)
+{
+    const int numBlocks = 2000;
+    const auto period = std::chrono::microseconds(1000);
+    std::atomic<bool> done(false);
+    std::vector<std::thread> flushers;
+    int numCPUs = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < numCPUs; i++) {
+        flushers.push_back(std::thread([&] {
+            background.apply();
+            flushLargeTake(done);
+        }));
+    }
+
+    std::vector<double> lateness;
+    lateness.reserve(numBlocks);
+    auto deadline = std::chrono::steady_clock::now();
+    volatile float sink = 0.f;
+    for (int b = 0; b < numBlocks; b++) {
+        // a block of "DSP":
+        for (int i = 0; i < 20000; i++) {
+            sink = sink + i * 0.5f;
+        }
+        deadline += period;
+        std::this_thread::sleep_until(deadline);
+        auto late = std::chrono::steady_clock::now() - deadline;
+        lateness.push_back(std::chrono::duration<double, std::micro>(late).count());
+    }
+    done = true;
+    for (auto& t : flushers) {
+        t.join();
+    }
+    std::sort(lateness.begin(), lateness.end());
+    Jitter j;
+    j.p99 = lateness[numBlocks * 99 / 100];
+    j.max = lateness.back();
+    return j;
+}
+
+TEST_CASE("engine thread jitter while a large take is flushed", "[.][benchmark]")
+{
+    ThreadPriority normal;
+    ThreadPriority idle;
+    idle.policy = THREAD_POLICY_IDLE;
+    idle.nice = 19;
+    ThreadPriority pinned = idle;
+    pinned.pinToLastCPU = true;
+
+    Jitter n = measureJitter(normal);
+    Jitter i = measureJitter(idle);
+    Jitter p = measureJitter(pinned);
+    printf("engine block lateness (usec)   p99      max\n");
+    printf("  background normal         %7.1f  %7.1f\n", n.p99, n.max);
+    printf("  background idle, nice 19  %7.1f  %7.1f\n", i.p99, i.max);
+    printf("  ... and on last CPU       %7.1f  %7.1f\n", p.p99, p.max);
+    SUCCEED();
+}
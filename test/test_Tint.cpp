@@ -1,6 +1,8 @@
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 
 #include "TintQuantizer.hpp"
+#include <random>
 #undef WARN
 
 #include "catch.hpp"
@@ -387,3 +389,339 @@ TEST_CASE("tintinabulator: quantization with non-12-TET melody - check distance
     REQUIRE_THAT(E4, WithinAbs(voltageToMicroPitch(tq.tintinnabulate(pitchToVoltage(D4 + 0.01f))), epsilon));
     REQUIRE_THAT(E4, WithinAbs(voltageToMicroPitch(tq.tintinnabulate(pitchToVoltage(D4 + 0.1f))), epsilon));
 }
+
+// -----------------------------------------------
+// The original scanning implementation of tintinnabulate(), kept as a reference for the table driven
+// one.
+
+static float scanTintinnabulate(TintQuantizer& tq, float v)
+{
+    int note = voltageToPitch(v);
+
+    int delta = 0; // up or down
+    int count = 0; // (1 = first available note in the chord, 2 = second)
+    switch (tq.mode) {
+    case TintQuantizer::MODE_UP:
+        count = 1;
+        delta = 1;
+        break;
+    case TintQuantizer::MODE_UP2:
+        count = 2;
+        delta = 1;
+        break;
+    case TintQuantizer::MODE_DOWN:
+        count = 1;
+        delta = -1;
+        break;
+    case TintQuantizer::MODE_DOWN2:
+        count = 2;
+        delta = -1;
+        break;
+    case TintQuantizer::MODE_UP_DOWN:
+        count = 1;
+        delta = tq.upDown ? 1 : -1;
+        break;
+    case TintQuantizer::MODE_UP2_DOWN2:
+        count = 2;
+        delta = tq.upDown ? 1 : -1;
+        break;
+    case TintQuantizer::MODE_QUANTIZE:
+        float down_v = 0.f, up_v = 0.f;
+        for (int n = note; n <= PITCH_NOTE_MAX; n++) {
+            if (tq.inChord(n)) {
+                up_v = tq.chordFreq(n);
+                break;
+            }
+        }
+        for (int n = note - 1; n >= PITCH_NOTE_MIN; n--) {
+            if (tq.inChord(n)) {
+                down_v = tq.chordFreq(n);
+                break;
+            }
+        }
+        if ((up_v - v) < (v - down_v)) {
+            return up_v + tq.octave;
+        } else {
+            return down_v + tq.octave;
+        }
+        break;
+    }
+    if (delta > 0) {
+        int c = 0;
+        for (int n = note + 1; n <= PITCH_NOTE_MAX; n++) {
+            if (tq.inChord(n)) {
+                c++;
+            }
+            if (c == count) {
+                return tq.chordFreq(n) + tq.octave;
+            }
+        }
+    } else {
+        int c = 0;
+        for (int n = note - 1; n >= PITCH_NOTE_MIN; n--) {
+            if (tq.inChord(n)) {
+                c++;
+            }
+            if (c == count) {
+                return tq.chordFreq(n) + tq.octave;
+            }
+        }
+    }
+    return pitchToVoltage(note) + tq.octave;
+}
+
+static void randomChord(TintQuantizer& tq, std::mt19937& rng, int& noteCount)
+{
+    std::uniform_int_distribution<int> countDist(1, 16);
+    std::uniform_real_distribution<float> chordDist(-2.f, 2.f);
+    noteCount = countDist(rng);
+    for (int c = 0; c < noteCount; c++) {
+        tq.chordInputVoltageState[c] = chordDist(rng);
+    }
+    tq.prepare(noteCount);
+}
+
+TEST_CASE("tintinabulator: lookup tables match the scanning implementation")
+{
+    std::mt19937 rng(1234);
+    // stay clear of the ends of the note range, where the scan reads outside the array
+    std::uniform_real_distribution<float> melodyDist(-9.5f, 9.5f);
+    TintQuantizer tq;
+    tq.reset();
+    for (int chord = 0; chord < 200; chord++) {
+        int noteCount;
+        randomChord(tq, rng, noteCount);
+        for (int mode = TintQuantizer::MODE_UP; mode <= TintQuantizer::MODE_QUANTIZE; mode++) {
+            tq.mode = (TintQuantizer::Mode)mode;
+            tq.octave = (chord % 5) - 2;
+            for (int i = 0; i < 100; i++) {
+                tq.upDown = (i % 2) == 0;
+                float v = melodyDist(rng);
+                float expected = scanTintinnabulate(tq, v);
+                float actual = tq.tintinnabulate(v);
+                if (expected != actual) {
+                    // only report the interesting cases
+                    INFO("mode " << mode << " notes " << noteCount << " v " << v);
+                    CHECK(expected == actual);
+                }
+            }
+        }
+    }
+    // and the extreme notes where a chord note has no neighbour above or below:
+    tq.chordInputVoltageState[0] = pitchToVoltage(PITCH_NOTE_MIN + 0);
+    tq.prepare(1);
+    for (int mode = TintQuantizer::MODE_UP; mode <= TintQuantizer::MODE_QUANTIZE; mode++) {
+        tq.mode = (TintQuantizer::Mode)mode;
+        for (int n = PITCH_NOTE_MIN + 1; n < PITCH_NOTE_MAX; n++) {
+            float v = pitchToVoltage(n);
+            CHECK(scanTintinnabulate(tq, v) == tq.tintinnabulate(v));
+        }
+    }
+}
+
+TEST_CASE("tintinabulator: incremental chord updates match a full prepare")
+{
+    std::mt19937 rng(5678);
+    std::uniform_int_distribution<int> countDist(1, 8);
+    std::uniform_int_distribution<int> channelDist(0, 7);
+    std::uniform_real_distribution<float> chordDist(-2.f, 2.f);
+    TintQuantizer incremental;
+    incremental.reset();
+    incremental.toleranceCents = 0.f;
+    TintQuantizer full;
+    full.reset();
+
+    float chord[rack::PORT_MAX_CHANNELS] = {};
+    int noteCount = 3;
+    for (int step = 0; step < 2000; step++) {
+        // mostly move one note at a time, sometimes change the number of notes
+        if (step % 10 == 0) {
+            noteCount = countDist(rng);
+        }
+        chord[channelDist(rng) % noteCount] = chordDist(rng);
+
+        incremental.updateChord(chord, noteCount);
+        for (int c = 0; c < noteCount; c++) {
+            full.chordInputVoltageState[c] = chord[c];
+        }
+        full.prepare(noteCount);
+
+        bool same = true;
+        for (int i = 0; i < TintQuantizer::NUM_NOTES; i++) {
+            same = same && incremental.quantizedNoteVoltages[i] == full.quantizedNoteVoltages[i];
+        }
+        for (int i = 0; i < TintQuantizer::NUM_TABLE_NOTES; i++) {
+            same = same && incremental.up1[i] == full.up1[i] && incremental.down2[i] == full.down2[i];
+        }
+        INFO("step " << step);
+        REQUIRE(same);
+    }
+}
+
+TEST_CASE("tintinabulator: chord changes within the tolerance are ignored")
+{
+    TintQuantizer tq;
+    tq.reset();
+    tq.toleranceCents = 5.f;
+    float chord[3] = { pitchToVoltage(C4), pitchToVoltage(E4), pitchToVoltage(G4) };
+    CHECK(tq.updateChord(chord, 3));
+    CHECK(!tq.updateChord(chord, 3));
+
+    // 3 cents of noise:
+    chord[1] += 3.f / 1200.f;
+    CHECK(!tq.updateChord(chord, 3));
+    chord[1] -= 6.f / 1200.f;
+    CHECK(!tq.updateChord(chord, 3));
+    CHECK(tq.chordFreq(E4) == microPitchToVoltage(E4));
+
+    // 10 cents sharp:
+    chord[1] = microPitchToVoltage(E4 + 0.1f);
+    CHECK(tq.updateChord(chord, 3));
+    CHECK(tq.classMask == ((1 << 0) | (1 << 4) | (1 << 7)));
+    CHECK(tq.chordFreq(E4 - 24) == microPitchToVoltage(E4 - 24 + 0.1f));
+    // other classes untouched:
+    CHECK(tq.chordFreq(G4) == microPitchToVoltage(G4));
+
+    // a new note count is always a change:
+    CHECK(tq.updateChord(chord, 2));
+    CHECK(!tq.inChord(G4));
+}
+
+TEST_CASE("tintinabulator: chord applies to negative MIDI notes")
+{
+    TintQuantizer tq;
+    tq.reset();
+    tq.chordInputVoltageState[0] = pitchToVoltage(E4);
+    tq.prepare(1);
+    CHECK(tq.inChord(E4 - 72));
+    CHECK(!tq.inChord(E4 - 71));
+}
+
+static const float VOLTS_EPSILON = 0.0001f;
+
+static void setArbitraryChord(TintQuantizer& tq, std::vector<float> chord, float period)
+{
+    tq.reset();
+    for (size_t i = 0; i < chord.size(); i++) {
+        tq.chordInputVoltageState[i] = chord[i];
+    }
+    tq.prepare(chord.size());
+    tq.setTuning(true, period);
+}
+
+TEST_CASE("tintinabulator: arbitrary tuning, 19-EDO chord")
+{
+    TintQuantizer tq;
+    const float step = 1.f / 19.f;
+    // degrees 0, 6 and 11 of 19-EDO, given in different octaves:
+    setArbitraryChord(tq, { 0.f, 1.f + 6 * step, -1.f + 11 * step }, 1.f);
+    REQUIRE(tq.numDegrees == 3);
+    CHECK_THAT(tq.degrees[0], WithinAbs(0.f, VOLTS_EPSILON));
+    CHECK_THAT(tq.degrees[1], WithinAbs(6 * step, VOLTS_EPSILON));
+    CHECK_THAT(tq.degrees[2], WithinAbs(11 * step, VOLTS_EPSILON));
+
+    tq.mode = TintQuantizer::MODE_UP;
+    CHECK_THAT(tq.tintinnabulate(0.f), WithinAbs(6 * step, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(3 * step), WithinAbs(6 * step, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(12 * step), WithinAbs(1.f, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(-2.f + 7 * step), WithinAbs(-2.f + 11 * step, VOLTS_EPSILON));
+    tq.mode = TintQuantizer::MODE_UP2;
+    CHECK_THAT(tq.tintinnabulate(6 * step), WithinAbs(1.f, VOLTS_EPSILON));
+    tq.mode = TintQuantizer::MODE_DOWN;
+    CHECK_THAT(tq.tintinnabulate(0.f), WithinAbs(-1.f + 11 * step, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(11 * step), WithinAbs(6 * step, VOLTS_EPSILON));
+    tq.mode = TintQuantizer::MODE_DOWN2;
+    CHECK_THAT(tq.tintinnabulate(3.f + 7 * step), WithinAbs(3.f, VOLTS_EPSILON));
+    tq.mode = TintQuantizer::MODE_QUANTIZE;
+    CHECK_THAT(tq.tintinnabulate(2 * step), WithinAbs(0.f, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(4 * step), WithinAbs(6 * step, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(6 * step), WithinAbs(6 * step, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(1.f - 2 * step), WithinAbs(1.f, VOLTS_EPSILON));
+    tq.octave = 1;
+    CHECK_THAT(tq.tintinnabulate(4 * step), WithinAbs(1.f + 6 * step, VOLTS_EPSILON));
+}
+
+TEST_CASE("tintinabulator: arbitrary tuning, tritave")
+{
+    TintQuantizer tq;
+    const float tritave = std::log2(3.f);
+    // Bohlen-Pierce steps 0, 4 and 7 (of 13 per tritave):
+    setArbitraryChord(tq, { 0.f, tritave * 4 / 13, tritave * 7 / 13 }, tritave);
+    tq.mode = TintQuantizer::MODE_UP;
+    CHECK_THAT(tq.tintinnabulate(tritave * 8 / 13), WithinAbs(tritave, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(tritave + 0.01f), WithinAbs(tritave * 17 / 13, VOLTS_EPSILON));
+    tq.mode = TintQuantizer::MODE_DOWN;
+    CHECK_THAT(tq.tintinnabulate(-tritave + 0.01f), WithinAbs(-tritave, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(-tritave), WithinAbs(-tritave * 19 / 13, VOLTS_EPSILON));
+}
+
+TEST_CASE("tintinabulator: arbitrary tuning, no repeat")
+{
+    TintQuantizer tq;
+    setArbitraryChord(tq, { 0.1f, 0.5f, 1.3f }, 0.f);
+    REQUIRE(tq.numDegrees == 3);
+    tq.mode = TintQuantizer::MODE_UP;
+    CHECK_THAT(tq.tintinnabulate(0.f), WithinAbs(0.1f, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(0.5f), WithinAbs(1.3f, VOLTS_EPSILON));
+    // nothing above - the melody passes through
+    CHECK_THAT(tq.tintinnabulate(1.3f), WithinAbs(1.3f, VOLTS_EPSILON));
+    tq.mode = TintQuantizer::MODE_DOWN2;
+    CHECK_THAT(tq.tintinnabulate(1.3f), WithinAbs(0.1f, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(0.5f), WithinAbs(0.5f, VOLTS_EPSILON));
+    tq.mode = TintQuantizer::MODE_QUANTIZE;
+    CHECK_THAT(tq.tintinnabulate(-3.f), WithinAbs(0.1f, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(0.3f), WithinAbs(0.5f, VOLTS_EPSILON)); // equidistant: up
+    CHECK_THAT(tq.tintinnabulate(5.f), WithinAbs(1.3f, VOLTS_EPSILON));
+}
+
+TEST_CASE("tintinabulator: arbitrary tuning follows chord updates")
+{
+    TintQuantizer tq;
+    setArbitraryChord(tq, { 0.f, 0.25f }, 1.f);
+    tq.mode = TintQuantizer::MODE_UP;
+    CHECK_THAT(tq.tintinnabulate(0.1f), WithinAbs(0.25f, VOLTS_EPSILON));
+    // a change within one pitch class still moves the degree:
+    float chord[2] = { 0.f, 0.26f };
+    CHECK(tq.updateChord(chord, 2));
+    CHECK_THAT(tq.tintinnabulate(0.1f), WithinAbs(0.26f, VOLTS_EPSILON));
+    // back to 12 pitch classes - the same chord, as the (12 cents sharp) D#:
+    tq.setTuning(false, 1.f);
+    CHECK_THAT(tq.tintinnabulate(0.1f), WithinAbs(0.26f, VOLTS_EPSILON));
+    CHECK_THAT(tq.tintinnabulate(1.1f), WithinAbs(1.26f, VOLTS_EPSILON));
+}
+
+TEST_CASE("tintinabulator: throughput", "[.][benchmark]")
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> melodyDist(-5.f, 5.f);
+    TintQuantizer tq;
+    tq.reset();
+    // a triad - the sparser the chord, the further the scan has to go
+    tq.chordInputVoltageState[0] = pitchToVoltage(C4);
+    tq.chordInputVoltageState[1] = pitchToVoltage(E4);
+    tq.chordInputVoltageState[2] = pitchToVoltage(G4);
+    tq.prepare(3);
+    float melody[rack::PORT_MAX_CHANNELS];
+    for (int c = 0; c < rack::PORT_MAX_CHANNELS; c++) {
+        melody[c] = melodyDist(rng);
+    }
+    for (int mode = TintQuantizer::MODE_UP; mode <= TintQuantizer::MODE_QUANTIZE; mode += 3) {
+        tq.mode = (TintQuantizer::Mode)mode;
+        BENCHMARK("scan, 16 channels, mode " + std::to_string(mode))
+        {
+            float sum = 0.f;
+            for (int c = 0; c < rack::PORT_MAX_CHANNELS; c++) {
+                sum += scanTintinnabulate(tq, melody[c]);
+            }
+            return sum;
+        };
+        BENCHMARK("tables, 16 channels, mode " + std::to_string(mode))
+        {
+            float sum = 0.f;
+            for (int c = 0; c < rack::PORT_MAX_CHANNELS; c++) {
+                sum += tq.tintinnabulate(melody[c]);
+            }
+            return sum;
+        };
+    }
+}
@@ -0,0 +1,111 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include "WindowedStatistics.hpp"
+#undef WARN
+
+#include "catch.hpp"
+
+#include <deque>
+#include <vector>
+
+using namespace Chinenual;
+using namespace Catch;
+
+TEST_CASE("windowed statistics: basics")
+{
+    WindowedStatistics<8> s;
+    s.setWindow(4);
+    CHECK(s.count == 0);
+    CHECK(std::isnan(s.min()));
+    CHECK(s.standardDeviation() == 0.f);
+
+    s.add(2.f);
+    CHECK(s.min() == 2.f);
+    CHECK(s.max() == 2.f);
+    CHECK(s.mean == 2.0);
+    CHECK(s.standardDeviation() == 0.f);
+
+    s.add(4.f);
+    s.add(4.f);
+    s.add(6.f);
+    CHECK(s.min() == 2.f);
+    CHECK(s.max() == 6.f);
+    CHECK_THAT(s.mean, WithinAbs(4.0, 1e-9));
+    CHECK_THAT(s.standardDeviation(), WithinAbs(std::sqrt(8.0 / 3.0), 1e-6));
+
+    // the 2 slides out:
+    s.add(5.f);
+    CHECK(s.count == 4);
+    CHECK(s.min() == 4.f);
+    CHECK(s.max() == 6.f);
+    CHECK_THAT(s.mean, WithinAbs(19.0 / 4.0, 1e-9));
+
+    // NaN is ignored:
+    s.add(NAN);
+    CHECK(s.count == 4);
+    CHECK(s.min() == 4.f);
+
+    // a new window starts over:
+    s.setWindow(2);
+    CHECK(s.count == 0);
+    s.setWindow(1000);
+    CHECK(s.window == 8);
+}
+
+TEST_CASE("windowed statistics: matches a brute force window")
+{
+    WindowedStatistics<1000> s;
+    for (int window : { 1, 2, 7, 100, 1000 }) {
+        s.setWindow(window);
+        std::deque<float> values;
+        uint32_t seed = window;
+        for (int i = 0; i < 5000; i++) {
+            seed = seed * 1664525 + 1013904223;
+            // a drifting pitch with jitter, and the odd repeated value
+            float x = (i % 17 == 0 && !values.empty()) ? values.back() : 60.f + 0.001f * i + ((seed >> 8) / (float)(1 << 24) - 0.5f) * 0.1f;
+            s.add(x);
+            values.push_back(x);
+            if ((int)values.size() > window) {
+                values.pop_front();
+            }
+            if (i % 97 == 0 || i > 4990) {
+                REQUIRE(s.count == (int)values.size());
+                double mean = 0.0;
+                for (float v : values) {
+                    mean += v;
+                }
+                mean /= values.size();
+                double m2 = 0.0;
+                for (float v : values) {
+                    m2 += (v - mean) * (v - mean);
+                }
+                const double sd = values.size() > 1 ? std::sqrt(m2 / (values.size() - 1)) : 0.0;
+                REQUIRE(s.min() == *std::min_element(values.begin(), values.end()));
+                REQUIRE(s.max() == *std::max_element(values.begin(), values.end()));
+                REQUIRE_THAT(s.mean, WithinAbs(mean, 1e-6));
+                REQUIRE_THAT(s.standardDeviation(), WithinAbs(sd, 1e-5));
+            }
+        }
+    }
+}
+
+TEST_CASE("windowed statistics: benchmark", "[.][benchmark]")
+{
+    static WindowedStatistics<3000> s[16];
+    std::vector<float> values(4096);
+    uint32_t seed = 1;
+    for (float& v : values) {
+        seed = seed * 1664525 + 1013904223;
+        v = 60.f + ((seed >> 8) / (float)(1 << 24) - 0.5f) * 0.1f;
+    }
+    BENCHMARK("16 channels, 4096 values each")
+    {
+        for (int i = 0; i < 4096; i++) {
+            for (int c = 0; c < 16; c++) {
+                s[c].add(values[(i + c) & 4095]);
+            }
+        }
+        return s[0].mean;
+    };
+}